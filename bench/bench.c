@@ -0,0 +1,127 @@
+#include "bench.h"
+#include "mach.h"
+#include "event.h"
+#include <stdarg.h>
+
+extern int SLSMainConnectionID(void);
+
+int g_connection;
+CFTypeRef g_transaction;
+int g_space_management_mode;
+
+struct bar_manager g_bar_manager;
+struct mach_server g_mach_server;
+void *g_workspace_context;
+
+char g_name[256] = "sketchybar_bench";
+char g_config_file[4096];
+char g_lock_file[MAXLEN];
+bool g_volume_events;
+bool g_brightness_events;
+int64_t g_disable_capture = 0;
+pid_t g_pid = 0;
+
+static struct bench g_benches[] = {
+  { "refresh",   bench_refresh   },
+  { "layout",    bench_layout    },
+  { "hit_index", bench_hit_index },
+  { "image",     bench_image     },
+  { "rotator",   bench_rotator   },
+  { "graph",     bench_graph     },
+  { "channel",   bench_channel   },
+  { "load",      bench_load      },
+  { "reorder",   bench_reorder   },
+};
+
+#define BENCH_COUNT (sizeof(g_benches) / sizeof(struct bench))
+
+static FILE* g_bench_rsp;
+static bool g_bench_failed = false;
+
+uint64_t bench_now(void) {
+  return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+void bench_report(const char* name, uint32_t iterations, uint64_t start) {
+  uint64_t elapsed = bench_now() - start;
+  printf("%-40s %12.3f us/op  (%u ops)\n", name,
+                                           elapsed / 1e3 / iterations,
+                                           iterations                 );
+}
+
+// Marks the run as failed, the benchmarks continue and the process exits
+// with a non-zero status.
+void bench_fail(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  printf("FAIL: ");
+  vprintf(format, args);
+  printf("\n");
+  va_end(args);
+  g_bench_failed = true;
+}
+
+// Handles a space separated command line like a message of the client
+void bench_command(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  char* line = NULL;
+  int length = vasprintf(&line, format, args);
+  va_end(args);
+  if (length < 0) return;
+
+  char* message = malloc(length + 2);
+  for (int i = 0; i < length; i++)
+    message[i] = line[i] == ' ' ? '\0' : line[i];
+  message[length] = '\0';
+  message[length + 1] = '\0';
+
+  handle_message(message, g_bench_rsp);
+  free(message);
+  free(line);
+}
+
+void bench_reset_items(uint32_t count) {
+  while (g_bar_manager.bar_item_count > 0) {
+    bar_manager_remove_item(&g_bar_manager, g_bar_manager.bar_items[0]);
+  }
+
+  for (uint32_t i = 0; i < count; i++)
+    bench_command("--add item bench.%u left", i);
+}
+
+struct bar* bench_bar_create(uint32_t adid) {
+  struct bar* bar = malloc(sizeof(struct bar));
+  memset(bar, 0, sizeof(struct bar));
+  bar->shown = true;
+  bar->adid = adid;
+  bar->sid = 1;
+  bar->window.frame.size = (CGSize){ 1512, 32 };
+  return bar;
+}
+
+void bench_bar_destroy(struct bar* bar) {
+  if (bar->layout) free(bar->layout);
+  free(bar);
+}
+
+int main(int argc, char** argv) {
+  g_bench_rsp = fopen("/dev/null", "w");
+  g_connection = SLSMainConnectionID();
+  struct event init = { NULL, INIT_MUTEX };
+  event_post(&init);
+  bar_manager_init(&g_bar_manager);
+
+  for (uint32_t i = 0; i < BENCH_COUNT; i++) {
+    bool selected = argc < 2;
+    for (int j = 1; j < argc && !selected; j++)
+      selected = string_equals(argv[j], g_benches[i].name);
+
+    if (!selected) continue;
+    printf("%s\n", g_benches[i].name);
+    g_benches[i].run();
+  }
+
+  fclose(g_bench_rsp);
+  return g_bench_failed ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "bar_manager.h"
+#include "message.h"
+
+#define BENCH_ITEMS 1000
+
+// Benchmarks run headless against the global bar manager: there are no
+// displays and no config process. Bars are only created where a benchmark
+// needs them and never get a window, item windows stay off screen.
+struct bench {
+  const char* name;
+  void (*run)(void);
+};
+
+uint64_t bench_now(void);
+void bench_report(const char* name, uint32_t iterations, uint64_t start);
+void bench_fail(const char* format, ...);
+void bench_command(const char* format, ...);
+void bench_reset_items(uint32_t count);
+struct bar* bench_bar_create(uint32_t adid);
+void bench_bar_destroy(struct bar* bar);
+
+void bench_refresh(void);
+void bench_layout(void);
+void bench_hit_index(void);
+void bench_image(void);
+void bench_rotator(void);
+void bench_graph(void);
+void bench_channel(void);
+void bench_load(void);
+void bench_reorder(void);
@@ -0,0 +1,155 @@
+#include "bench.h"
+#include "event.h"
+#include <pthread.h>
+
+#define CHANNEL_SAMPLES 1000000
+#define CHANNEL_RATE    10000
+#define CHANNEL_FRAME   16666667
+#define CHANNEL_SECONDS 2
+
+struct channel_bench_feed {
+  struct ring_header* ring;
+  uint64_t* written;
+  uint32_t count;
+};
+
+static void* channel_bench_producer(void* context) {
+  struct ring_header* ring = context;
+  for (uint32_t i = 0; i < CHANNEL_SAMPLES; i++) {
+    float value = i;
+    while (!ring_write_values(ring, &value, 1));
+  }
+  return NULL;
+}
+
+// A producer thread writes one value per sample into the ring while the
+// consumer drains it as channel_drain does, without applying the samples.
+static void bench_channel_ring(void) {
+  struct ring_header* ring = malloc(ring_size(RING_CAPACITY));
+  ring_init(ring, RING_CAPACITY);
+
+  pthread_t producer;
+  uint64_t start = bench_now();
+  pthread_create(&producer, NULL, channel_bench_producer, ring);
+
+  uint64_t drained = 0;
+  uint64_t drains = 0;
+  volatile float sink = 0;
+  while (drained < CHANNEL_SAMPLES) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = ring->tail;
+    if (head == tail) continue;
+
+    for (uint64_t i = tail; i < head; i++)
+      sink += ring->samples[i % RING_CAPACITY].values[0];
+    __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+    drained += head - tail;
+    drains++;
+  }
+  pthread_join(producer, NULL);
+  bench_report("ring producer/consumer sample", CHANNEL_SAMPLES, start);
+
+  printf("%-40s %12.1f samples/drain  (%llu writes to a full ring)\n",
+         "ring drain batch",
+         (double)drained / drains,
+         __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED));
+  free(ring);
+}
+
+// Writes one sample every 1 / CHANNEL_RATE seconds on a fixed schedule, a
+// late sample does not push back the ones after it.
+static void* channel_bench_feed(void* context) {
+  struct channel_bench_feed* feed = context;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < feed->count; i++) {
+    uint64_t due = start + (uint64_t)i * 1000000000ull / CHANNEL_RATE;
+    uint64_t now = bench_now();
+    if (due > now) {
+      struct timespec wait = { 0, (long)(due - now) };
+      nanosleep(&wait, NULL);
+    }
+
+    float value = (i % 100) / 100.f;
+    feed->written[i] = bench_now();
+    while (!ring_write_values(feed->ring, &value, 1));
+  }
+  return NULL;
+}
+
+static int channel_bench_compare(const void* a, const void* b) {
+  uint64_t x = *(uint64_t*)a;
+  uint64_t y = *(uint64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+// Feeds a graph item through its channel at CHANNEL_RATE samples per second
+// and posts CHANNEL_REFRESH once per 60 Hz frame, as the display link does.
+// The latency of a sample runs from its write until the refresh that drained
+// and applied it has returned.
+static void bench_channel_latency(void) {
+  bench_reset_items(0);
+  bench_command("--add graph bench.channel left 200");
+  bench_command("--channel bench.channel on");
+
+  struct channel_manager* manager = &g_bar_manager.channel_manager;
+  if (manager->channel_count == 0) {
+    printf("%-40s\n", "channel not available, skipped");
+    return;
+  }
+
+  // The bench posts the frames itself
+  if (manager->display_link) CVDisplayLinkStop(manager->display_link);
+
+  struct ring_header* ring = manager->channels[0]->ring;
+  uint32_t count = CHANNEL_RATE * CHANNEL_SECONDS;
+  struct channel_bench_feed feed = { ring,
+                                     malloc(sizeof(uint64_t) * count),
+                                     count                            };
+  uint64_t* latencies = malloc(sizeof(uint64_t) * count);
+  uint32_t applied = 0;
+  uint32_t frames = 0;
+
+  pthread_t producer;
+  pthread_create(&producer, NULL, channel_bench_feed, &feed);
+
+  uint64_t start = bench_now();
+  while (applied < count) {
+    uint64_t due = start + (uint64_t)++frames * CHANNEL_FRAME;
+    uint64_t now = bench_now();
+    if (due > now) {
+      struct timespec wait = { 0, (long)(due - now) };
+      nanosleep(&wait, NULL);
+    }
+
+    struct event event = { NULL, CHANNEL_REFRESH };
+    event_post(&event);
+    uint64_t done = bench_now();
+
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    for (; applied < tail && applied < count; applied++)
+      latencies[applied] = done - feed.written[applied];
+  }
+  pthread_join(producer, NULL);
+
+  qsort(latencies, count, sizeof(uint64_t), channel_bench_compare);
+  printf("%-40s %12.3f us p50  %.3f us p90  %.3f us p99  %.3f us max\n",
+         "channel drain-to-apply, 10k/s",
+         latencies[count / 2] / 1e3,
+         latencies[count * 9 / 10] / 1e3,
+         latencies[count * 99 / 100] / 1e3,
+         latencies[count - 1] / 1e3                                      );
+  printf("%-40s %12u frames (%llu dropped)\n",
+         "channel frames",
+         frames,
+         __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED));
+
+  bench_command("--channel bench.channel off");
+  bench_reset_items(0);
+  free(latencies);
+  free(feed.written);
+}
+
+void bench_channel(void) {
+  bench_channel_ring();
+  bench_channel_latency();
+}
@@ -0,0 +1,166 @@
+#include "bench.h"
+#include <math.h>
+
+#define GRAPH_SAMPLES 200
+#define GRAPH_HEIGHT  20
+#define GRAPH_SCALE   2
+
+static CGContextRef graph_bench_context(void) {
+  CGColorSpaceRef color_space = CGColorSpaceCreateDeviceRGB();
+  CGContextRef context = CGBitmapContextCreate(NULL,
+                                               GRAPH_SAMPLES * GRAPH_SCALE,
+                                               GRAPH_HEIGHT * GRAPH_SCALE,
+                                               8,
+                                               GRAPH_SAMPLES
+                                               * GRAPH_SCALE * 4,
+                                               color_space,
+                                               kCGImageAlphaPremultipliedFirst
+                                               | kCGBitmapByteOrder32Little  );
+  CGColorSpaceRelease(color_space);
+  CGContextScaleCTM(context, GRAPH_SCALE, GRAPH_SCALE);
+  return context;
+}
+
+static void graph_bench_setup(struct graph* graph, bool rtl) {
+  graph_init(graph);
+  graph_setup(graph, GRAPH_SAMPLES);
+  graph->rtl = rtl;
+  graph->incremental = true;
+  graph->line_width = 1.5;
+  graph_calculate_bounds(graph, 0, GRAPH_HEIGHT / 2, GRAPH_HEIGHT);
+  graph->bounds.origin.y = 0;
+}
+
+static void graph_bench_push(struct graph* graph, uint32_t i) {
+  graph_push_back(graph, 0.5f + 0.45f * sinf(i * 0.21f) * cosf(i * 0.033f));
+}
+
+// Compares the shifted bitmap of an incremental graph with a full render of
+// the same samples after every push, any pixel that differs fails the run.
+static void graph_bench_verify(bool rtl) {
+  CGContextRef context = graph_bench_context();
+  struct graph incremental, full;
+  graph_bench_setup(&incremental, rtl);
+  graph_bench_setup(&full, rtl);
+
+  uint32_t differing = 0;
+  uint32_t max_delta = 0;
+  for (uint32_t i = 0; i < 3 * GRAPH_SAMPLES; i++) {
+    uint32_t pushes = i % 7 == 0 ? 3 : 1;
+    for (uint32_t j = 0; j < pushes; j++) {
+      graph_bench_push(&incremental, i * 8 + j);
+      graph_bench_push(&full, i * 8 + j);
+    }
+
+    full.bitmap.style = 0;
+    graph_draw(&incremental, context);
+    graph_draw(&full, context);
+
+    CGContextRef a = incremental.bitmap.context;
+    CGContextRef b = full.bitmap.context;
+    if (!a || !b) break;
+    unsigned char* pixels_a = CGBitmapContextGetData(a);
+    unsigned char* pixels_b = CGBitmapContextGetData(b);
+    size_t bytes = CGBitmapContextGetBytesPerRow(a)
+                   * CGBitmapContextGetHeight(a);
+    for (size_t k = 0; k < bytes; k += 4) {
+      uint32_t delta = 0;
+      for (size_t c = 0; c < 4; c++)
+        delta = max(delta, (uint32_t)abs(pixels_a[k + c] - pixels_b[k + c]));
+      if (delta > 0) differing++;
+      max_delta = max(max_delta, delta);
+    }
+  }
+
+  printf("%-40s %12u px    (max delta %u)\n",
+         rtl ? "graph shift mismatch, rtl" : "graph shift mismatch, ltr",
+         differing,
+         max_delta                                                     );
+  if (differing > 0) {
+    bench_fail("incremental graph differs from full render in %u px (%s)",
+               differing,
+               rtl ? "rtl" : "ltr"                                        );
+  }
+
+  graph_destroy(&incremental);
+  graph_destroy(&full);
+  CGContextRelease(context);
+}
+
+// Pushes and decimation of four series of 1000 samples down to 200
+// columns, as one quantized graph and as four separate float graphs.
+static void graph_bench_storage(void) {
+  uint32_t samples = BENCH_ITEMS;
+  uint32_t columns = GRAPH_SAMPLES;
+  float low[columns];
+  float high[columns];
+
+  struct graph shared;
+  graph_init(&shared);
+  graph_set_layout(&shared, 4, GRAPH_STORAGE_UINT8);
+  graph_setup(&shared, samples);
+
+  struct graph separate[4];
+  for (uint32_t i = 0; i < 4; i++) {
+    graph_init(&separate[i]);
+    graph_setup(&separate[i], samples);
+  }
+
+  uint32_t iterations = 1000;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    float values[4] = { i % 100 / 100.f, 0.25f, 0.5f, i % 7 / 7.f };
+    graph_push_back_series(&shared, values, 4);
+    for (uint32_t j = 0; j < 4; j++)
+      graph_decimate(&shared, j, columns, 0, columns, low, high);
+  }
+  bench_report("graph push+decimate, 4 series uint8", iterations, start);
+
+  start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    float values[4] = { i % 100 / 100.f, 0.25f, 0.5f, i % 7 / 7.f };
+    for (uint32_t j = 0; j < 4; j++) {
+      graph_push_back(&separate[j], values[j]);
+      graph_decimate(&separate[j], 0, columns, 0, columns, low, high);
+    }
+  }
+  bench_report("graph push+decimate, 4 float graphs", iterations, start);
+
+  printf("%-40s %12zu B     (4 float graphs: %zu B)\n",
+         "graph samples, 4 series uint8",
+         (size_t)samples * 4 * sizeof(uint8_t),
+         (size_t)samples * 4 * sizeof(float)   );
+
+  graph_destroy(&shared);
+  for (uint32_t i = 0; i < 4; i++) graph_destroy(&separate[i]);
+}
+
+// Draws of a graph that receives one sample per draw, with the shifted
+// bitmap and with the full path rendered on every draw.
+void bench_graph(void) {
+  graph_bench_verify(false);
+  graph_bench_verify(true);
+  graph_bench_storage();
+
+  CGContextRef context = graph_bench_context();
+  struct graph graph;
+  graph_bench_setup(&graph, false);
+  uint32_t iterations = 10000;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    graph_bench_push(&graph, i);
+    graph_draw(&graph, context);
+  }
+  bench_report("graph draw, incremental", iterations, start);
+
+  graph.incremental = false;
+  start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    graph_bench_push(&graph, i);
+    graph_draw(&graph, context);
+  }
+  bench_report("graph draw, full path", iterations, start);
+
+  graph_destroy(&graph);
+  CGContextRelease(context);
+}
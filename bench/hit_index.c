@@ -0,0 +1,97 @@
+#include "bench.h"
+
+// The walk over every window of every item which the index replaced
+static struct bar_item* bench_item_by_point_linear(CGPoint point) {
+  for (int i = 0; i < g_bar_manager.bar_item_count; i++) {
+    struct bar_item* bar_item = g_bar_manager.bar_items[i];
+    if (!bar_item->drawing) continue;
+
+    for (int adid = 1; adid <= bar_item->num_windows; adid++) {
+      struct window* window = bar_item->windows[adid - 1];
+      if (!window) continue;
+
+      CGRect frame = window->frame;
+      frame.origin = window->origin;
+      if (cgrect_contains_point(&frame, &point)) return bar_item;
+    }
+  }
+  return NULL;
+}
+
+void bench_hit_index(void) {
+  bench_reset_items(BENCH_ITEMS);
+  for (uint32_t i = 0; i < BENCH_ITEMS; i++)
+    bench_command("--set bench.%u label=item.%u", i, i);
+
+  struct bar* bar = bench_bar_create(1);
+  bar->window.frame.size.width = 200 * BENCH_ITEMS;
+  bar_calculate_bounds(bar);
+  bar_manager_clear_needs_update(&g_bar_manager);
+
+  uint32_t point_count = 10000;
+  CGPoint* points = malloc(sizeof(CGPoint) * point_count);
+  srand(1);
+  for (uint32_t i = 0; i < point_count; i++) {
+    points[i] = (CGPoint){ rand() % (uint32_t)bar->window.frame.size.width,
+                           bar->window.frame.size.height / 2               };
+  }
+
+  uint32_t iterations = 100;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    hit_index_build(&g_bar_manager.hit_index,
+                    g_bar_manager.bar_items,
+                    g_bar_manager.bar_item_count,
+                    false,
+                    g_window_generation,
+                    g_window_moves               );
+  }
+  bench_report("hit_index_build", iterations, start);
+
+  uint32_t mismatches = 0;
+  for (uint32_t i = 0; i < point_count; i++) {
+    struct bar_item* bar_item = bar_manager_get_item_by_point(&g_bar_manager,
+                                                              points[i],
+                                                              NULL        );
+    mismatches += bar_item != bench_item_by_point_linear(points[i]);
+  }
+  printf("%-40s %12u\n", "mismatches against linear scan", mismatches);
+
+  start = bench_now();
+  volatile uintptr_t sink = 0;
+  for (uint32_t i = 0; i < point_count; i++) {
+    sink += (uintptr_t)hit_index_item_at_point(&g_bar_manager.hit_index,
+                                               points[i],
+                                               NULL                     );
+  }
+  bench_report("item at point, hit index", point_count, start);
+
+  start = bench_now();
+  for (uint32_t i = 0; i < point_count; i++)
+    sink += (uintptr_t)bench_item_by_point_linear(points[i]);
+  bench_report("item at point, linear scan", point_count, start);
+
+  // An animation moves a window between lookups, the index refreshes the
+  // frames in place instead of being rebuilt.
+  struct window* moving = NULL;
+  for (int i = 0; i < g_bar_manager.bar_item_count && !moving; i++)
+    moving = g_bar_manager.bar_items[i]->num_windows > 0
+             ? g_bar_manager.bar_items[i]->windows[0]
+             : NULL;
+
+  if (moving) {
+    CGRect frame = { moving->origin, moving->frame.size };
+    start = bench_now();
+    for (uint32_t i = 0; i < point_count; i++) {
+      frame.origin.x += i % 2 ? -1 : 1;
+      window_set_frame(moving, frame);
+      sink += (uintptr_t)bar_manager_get_item_by_point(&g_bar_manager,
+                                                       points[i],
+                                                       NULL        );
+    }
+    bench_report("item at point, window moving", point_count, start);
+  }
+
+  free(points);
+  bench_bar_destroy(bar);
+}
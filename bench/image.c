@@ -0,0 +1,56 @@
+#include "bench.h"
+
+// The comparison image_set_image did before content hashes: a copy of the
+// pixels of both images and a memcmp of the two.
+static bool image_copy_equals(CGImageRef a, CGImageRef b) {
+  CFDataRef a_data = CGDataProviderCopyData(CGImageGetDataProvider(a));
+  CFDataRef b_data = CGDataProviderCopyData(CGImageGetDataProvider(b));
+  bool equal = a_data && b_data
+               && CFDataGetLength(a_data) == CFDataGetLength(b_data)
+               && memcmp(CFDataGetBytePtr(a_data),
+                         CFDataGetBytePtr(b_data),
+                         CFDataGetLength(a_data)  ) == 0;
+  if (a_data) CFRelease(a_data);
+  if (b_data) CFRelease(b_data);
+  return equal;
+}
+
+// Setting a cached image reuses the content hash taken at decode, an uncached
+// image of the same size is hashed from its pixels. The copy and memcmp of
+// the old comparison is timed as the baseline.
+void bench_image(void) {
+  FILE* rsp = fopen("/dev/null", "w");
+  struct image image;
+  image_init(&image);
+  if (!image_load(&image, "app.Finder", rsp) || !image.image_ref) {
+    printf("%-40s\n", "app.Finder icon not available, skipped");
+    fclose(rsp);
+    return;
+  }
+
+  uint32_t iterations = 1000;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++)
+    image_load(&image, "app.Finder", rsp);
+  bench_report("image_load, cached hash", iterations, start);
+
+  CGImageRef image_ref = CGImageRetain(image.image_ref);
+  CGRect bounds = { CGPointZero, image.size };
+  start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++)
+    image_set_image(&image, CGImageRetain(image_ref), bounds, true);
+  bench_report("image_set_image, pixel hash", iterations, start);
+
+  uint32_t equal = 0;
+  start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++)
+    equal += image_copy_equals(image_ref, image.image_ref);
+  bench_report("copy and memcmp, baseline", iterations, start);
+  if (equal != iterations) printf("  %u of %u compared unequal\n",
+                                  iterations - equal,
+                                  iterations         );
+
+  CGImageRelease(image_ref);
+  image_destroy(&image);
+  fclose(rsp);
+}
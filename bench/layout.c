@@ -0,0 +1,38 @@
+#include "bench.h"
+
+// Changes the label width of one item in the middle of the bar and lays out
+// the bar again. With the association check set, every item is measured as
+// in the single pass layout before the measure cache.
+static void bench_calculate_bounds(const char* name, bool association_check) {
+  struct bar* bar = bench_bar_create(1);
+  bar_calculate_bounds(bar);
+  bar_manager_clear_needs_update(&g_bar_manager);
+
+  struct bar_item* changed = g_bar_manager.bar_items[BENCH_ITEMS / 2];
+  uint32_t iterations = 1000;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    text_set_string(&changed->label,
+                    string_copy(i & 1 ? "changed" : "changed label"),
+                    false                                           );
+    bar_item_needs_update(changed);
+
+    bar->needs_association_check = association_check;
+    bar_calculate_bounds(bar);
+    bar_manager_clear_needs_update(&g_bar_manager);
+  }
+  bench_report(name, iterations, start);
+
+  bench_bar_destroy(bar);
+}
+
+void bench_layout(void) {
+  bench_reset_items(BENCH_ITEMS);
+  for (uint32_t i = 0; i < BENCH_ITEMS; i++) {
+    bench_command("--set bench.%u icon=%u label=item.%u position=%s",
+                  i, i % 10, i, i % 3 == 0 ? "right" : "left"     );
+  }
+
+  bench_calculate_bounds("calculate_bounds, measure cache", false);
+  bench_calculate_bounds("calculate_bounds, full measure", true);
+}
@@ -0,0 +1,43 @@
+#include "bench.h"
+
+extern char g_name[256];
+
+#define LOAD_COMMANDS 500
+
+// The same 500 commands, sent one message per command as a config of client
+// calls does, and applied from a single file with --load, which handles them
+// as one transaction with one refresh.
+void bench_load(void) {
+  bench_reset_items(LOAD_COMMANDS);
+
+  char directory[MAXLEN];
+  if (!get_user_temp_dir(directory, sizeof(directory))) return;
+
+  char path[MAXLEN];
+  snprintf(path, MAXLEN, "%s%s.load", directory, g_name);
+  int fd = create_private_file(path, O_WRONLY);
+  if (fd < 0) return;
+
+  FILE* file = fdopen(fd, "w");
+  for (uint32_t i = 0; i < LOAD_COMMANDS; i++) {
+    fprintf(file, "--set bench.%u label=\"load %u\" icon.padding_left=%u\n",
+                  i, i, i % 8                                          );
+  }
+  fclose(file);
+
+  uint32_t iterations = 20;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    for (uint32_t j = 0; j < LOAD_COMMANDS; j++) {
+      bench_command("--set bench.%u label=message_%u icon.padding_left=%u",
+                    j, j, (i + j) % 8                                      );
+    }
+  }
+  bench_report("500 commands, one message each", iterations, start);
+
+  start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) bench_command("--load %s", path);
+  bench_report("500 commands, one --load", iterations, start);
+
+  unlink(path);
+}
@@ -0,0 +1,32 @@
+#include "bench.h"
+
+// One changed item at the end of the item list, checked on two bars. With
+// the association check set, every item is visited as on each refresh
+// before the dirty set.
+static void bench_needs_redraw(const char* name, bool association_check) {
+  struct bar* bars[2] = { bench_bar_create(1), bench_bar_create(2) };
+  struct bar_item* changed
+                 = g_bar_manager.bar_items[g_bar_manager.bar_item_count - 1];
+
+  uint32_t iterations = 10000;
+  volatile uint32_t redraws = 0;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    bar_item_needs_update(changed);
+    for (uint32_t j = 0; j < 2; j++) {
+      bars[j]->needs_association_check = association_check;
+      redraws += bar_manager_bar_needs_redraw(&g_bar_manager, bars[j]);
+    }
+    bar_manager_clear_needs_update(&g_bar_manager);
+  }
+  bench_report(name, iterations, start);
+
+  bench_bar_destroy(bars[0]);
+  bench_bar_destroy(bars[1]);
+}
+
+void bench_refresh(void) {
+  bench_reset_items(BENCH_ITEMS);
+  bench_needs_redraw("needs_redraw, dirty set", false);
+  bench_needs_redraw("needs_redraw, full scan", true);
+}
@@ -0,0 +1,57 @@
+#include "bench.h"
+
+// Reverses the order of all items, directly through bar_manager_sort and
+// through --reorder, which resolves every name first. Every iteration flips
+// the order, such that each sort moves all items.
+static void bench_sort(void) {
+  uint32_t count = g_bar_manager.bar_item_count;
+  struct bar_item** ordering = malloc(sizeof(struct bar_item*) * count);
+
+  uint32_t iterations = 1000;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    for (uint32_t j = 0; j < count; j++)
+      ordering[j] = g_bar_manager.bar_items[count - j - 1];
+    bar_manager_sort(&g_bar_manager, ordering, count);
+  }
+  bench_report("bar_manager_sort, reverse 1000", iterations, start);
+  free(ordering);
+}
+
+static void bench_reorder_command(void) {
+  uint32_t count = g_bar_manager.bar_item_count;
+  char* names[2] = { malloc(count * 16 + 1), malloc(count * 16 + 1) };
+  uint32_t lengths[2] = { 0, 0 };
+  for (uint32_t i = 0; i < count; i++) {
+    lengths[0] += sprintf(names[0] + lengths[0], " bench.%u", i);
+    lengths[1] += sprintf(names[1] + lengths[1], " bench.%u", count - i - 1);
+  }
+
+  uint32_t iterations = 100;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++)
+    bench_command("--reorder%s", names[i & 1]);
+  bench_report("--reorder, reverse 1000", iterations, start);
+
+  free(names[0]);
+  free(names[1]);
+}
+
+// Moves the first item to the end of the bar and back
+static void bench_move(void) {
+  uint32_t count = g_bar_manager.bar_item_count;
+  uint32_t iterations = 1000;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    bench_command("--move bench.0 after bench.%u", count - 1);
+    bench_command("--move bench.0 before bench.1");
+  }
+  bench_report("--move, across 1000", iterations * 2, start);
+}
+
+void bench_reorder(void) {
+  bench_reset_items(BENCH_ITEMS);
+  bench_sort();
+  bench_reorder_command();
+  bench_move();
+}
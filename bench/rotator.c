@@ -0,0 +1,50 @@
+#include "bench.h"
+#include <math.h>
+
+// Draws of a rotating icon at 3 degrees per frame, through the frame cache
+// and with a rotation rendered on every draw as before the cache.
+void bench_rotator(void) {
+  uint32_t iterations = 1000000;
+  volatile uint32_t sink = 0;
+  uint64_t start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++)
+    sink += rotator_frame_index(i * 0.37, ROTATOR_FRAME_COUNT);
+  bench_report("rotator_frame_index", iterations, start);
+
+  FILE* rsp = fopen("/dev/null", "w");
+  struct image image;
+  image_init(&image);
+  if (!image_load(&image, "app.Finder", rsp) || !image.image_ref) {
+    printf("%-40s\n", "app.Finder icon not available, skipped");
+    fclose(rsp);
+    return;
+  }
+
+  CGImageRef source = image.image_ref;
+  // The frame is the square around the rotated image, as in image_draw
+  CGFloat frame_size = hypot(CGImageGetWidth(source),
+                             CGImageGetHeight(source));
+  uint64_t frame_bytes = (uint64_t)(frame_size * frame_size)
+                         * CGImageGetBitsPerComponent(source) / 2;
+
+  struct rotator* rotator = rotator_create(&image, 0, 180, NULL);
+  iterations = 1000;
+  start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    rotator->current_rotation = i * 3.0;
+    CGImageRelease(rotator_get_frame(rotator,
+                                     source,
+                                     frame_bytes,
+                                     create_rotated_image));
+  }
+  bench_report("rotated frame, frame cache", iterations, start);
+
+  start = bench_now();
+  for (uint32_t i = 0; i < iterations; i++)
+    CGImageRelease(create_rotated_image(source, i * 3.0));
+  bench_report("rotated frame, rendered per draw", iterations, start);
+
+  rotator_destroy(&g_bar_manager.rotator_manager, rotator);
+  image_destroy(&image);
+  fclose(rsp);
+}
@@ -269,6 +269,26 @@ void alias_calculate_bounds(struct alias* alias, uint32_t x, uint32_t y) {
   image_calculate_bounds(&alias->image, x, y);
 }
 
+void alias_serialize(struct alias* alias, char* indent, FILE* rsp) {
+  fprintf(rsp, "%s\"owner\": \"%s\",\n"
+               "%s\"name\": \"%s\",\n"
+               "%s\"update_freq\": %u,\n"
+               "%s\"color\": \"0x%x\",\n"
+               "%s\"scale\": %f,\n"
+               "%s\"shadow\": {\n",
+               indent, alias->owner ? alias->owner : "",
+               indent, alias->name ? alias->name : "",
+               indent, alias->update_frequency,
+               indent, alias->color.hex,
+               indent, alias->image.scale,
+               indent                                   );
+
+  char deeper_indent[strlen(indent) + 2];
+  snprintf(deeper_indent, strlen(indent) + 2, "%s\t", indent);
+  shadow_serialize(&alias->image.shadow, deeper_indent, rsp);
+  fprintf(rsp, "\n%s}", indent);
+}
+
 bool alias_parse_sub_domain(struct alias* alias, FILE* rsp, struct token property, char* message) {
   struct key_value_pair key_value_pair = get_key_value_pair(property.text,'.');
   if (key_value_pair.key && key_value_pair.value) {
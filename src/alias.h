@@ -34,5 +34,6 @@ bool alias_update(struct alias* alias, bool forced);
 void alias_destroy(struct alias* alias);
 
 void print_all_menu_items(FILE* rsp);
+void alias_serialize(struct alias* alias, char* indent, FILE* rsp);
 
 bool alias_parse_sub_domain(struct alias* alias, FILE* rsp, struct token property, char* message);
@@ -30,6 +30,8 @@ void animation_setup(struct animation* animation, void* target, animator_functio
   animation->final_value = final_value;
   animation->update_function = update_function;
   animation->target = target;
+  animation->item = item_store_handle_for_address(&g_bar_manager.item_store,
+                                                  target                   );
   animation->separate_bytes = false;
   animation->as_float = false;
 
@@ -48,6 +50,15 @@ void animation_setup(struct animation* animation, void* target, animator_functio
   }
 }
 
+static void animation_finish(struct animation* animation) {
+  animation->finished = true;
+  if (animation->next) {
+    animation->next->previous = NULL;
+    animation->next->waiting = false;
+    animation->next = NULL;
+  }
+}
+
 static bool animation_update(struct animation* animation, uint64_t time, uint64_t clock) {
   if (!animation->target
       || !animation->update_function
@@ -55,6 +66,14 @@ static bool animation_update(struct animation* animation, uint64_t time, uint64_
     return false;
   }
 
+  // The item owning the target has been removed since the animation started
+  struct bar_item* bar_item = item_store_get(&g_bar_manager.item_store,
+                                             animation->item          );
+  if (animation->item && !bar_item) {
+    animation_finish(animation);
+    return false;
+  }
+
   if (!animation->initial_time) animation->initial_time = time;
   double t = animation->duration > 0
              ? ((double)(time - animation->initial_time)
@@ -94,26 +113,12 @@ static bool animation_update(struct animation* animation, uint64_t time, uint64_
     needs_update = animation->update_function(animation->target, value);
   }
 
-  bool found_item = false;
-  for (int i = 0; i < g_bar_manager.bar_item_count; i++) {
-    if (needs_update
-        && (animation->target >= (void*)g_bar_manager.bar_items[i])
-        && (animation->target < ((void*)g_bar_manager.bar_items[i]
-                                 + sizeof(struct bar_item)         ))) {
-
-      bar_item_needs_update(g_bar_manager.bar_items[i]);
-      found_item = true;
-    }
+  if (needs_update) {
+    if (bar_item) bar_item_needs_update(bar_item);
+    else g_bar_manager.bar_needs_update = true;
   }
 
-  if (!found_item && needs_update) g_bar_manager.bar_needs_update = true;
-
-  animation->finished = final_frame;
-  if (animation->finished && animation->next) {
-    animation->next->previous = NULL;
-    animation->next->waiting = false;
-    animation->next = NULL;
-  }
+  if (final_frame) animation_finish(animation);
   return needs_update;
 }
 
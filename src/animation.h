@@ -1,6 +1,7 @@
 #pragma once
 #include <CoreVideo/CoreVideo.h>
 #include "misc/helpers.h"
+#include "item_store.h"
 
 extern struct bar_manager g_bar_manager;
 
@@ -96,6 +97,7 @@ struct animation {
   animation_function* interp_function;
 
   void* target;
+  item_handle item;
   animator_function* update_function;
 
   struct animation* next;
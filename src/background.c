@@ -5,6 +5,53 @@
 #include "animation.h"
 #include "bar_manager.h"
 
+static struct background_style g_background_default_style = { 0 };
+static uint32_t g_background_style_count = 1;
+static uint32_t g_background_style_references = 0;
+
+static struct background_style* background_style_retain(struct background_style* style) {
+  style->refcount++;
+  g_background_style_references++;
+  return style;
+}
+
+static void background_style_release(struct background_style* style) {
+  if (!style) return;
+  g_background_style_references--;
+  if (--style->refcount > 0) return;
+  free(style);
+  g_background_style_count--;
+}
+
+static struct background_style* background_default_style() {
+  struct background_style* style = &g_background_default_style;
+  if (style->refcount == 0) {
+    // The static reference keeps the default style alive
+    style->refcount = 1;
+    color_init(&style->color, 0x00000000);
+    color_init(&style->border_color, 0x00000000);
+    shadow_init(&style->shadow);
+  }
+  return background_style_retain(style);
+}
+
+// Returns the style of the background for writing, it is copied first if it
+// is shared with other backgrounds.
+struct background_style* background_style_mut(struct background* background) {
+  struct background_style* style = background->style;
+  if (style->refcount == 1) return style;
+
+  struct background_style* copy = malloc(sizeof(struct background_style));
+  memcpy(copy, style, sizeof(struct background_style));
+  copy->refcount = 1;
+  g_background_style_count++;
+  g_background_style_references++;
+
+  background_style_release(style);
+  background->style = copy;
+  return copy;
+}
+
 void background_init(struct background* background) {
   background->enabled = false;
   background->clip = 0.f;
@@ -14,18 +61,18 @@ void background_init(struct background* background) {
 
   background->bounds.size.height = 0;
   background->bounds.size.width = 0;
-  background->border_width = 0;
-  background->padding_left = 0;
-  background->padding_right = 0;
-  background->corner_radius = 0;
-  background->y_offset = 0;
-
-  color_init(&background->color, 0x00000000);
-  color_init(&background->border_color, 0x00000000);
-  shadow_init(&background->shadow);
+
+  background->style = background_default_style();
   image_init(&background->image);
 }
 
+// Completes a shallow copy of the source background, the style is shared
+// until either of them is modified.
+void background_copy(struct background* background, struct background* source) {
+  background->style = background_style_retain(source->style);
+  image_copy(&background->image, source->image.image_ref);
+}
+
 bool background_set_height(struct background* background, uint32_t height) {
   if (background->bounds.size.height == height) return false;
   background->bounds.size.height = height;
@@ -33,9 +80,15 @@ bool background_set_height(struct background* background, uint32_t height) {
   return true;
 }
 
+static void background_free_clip(struct background* clip) {
+  if (!clip) return;
+  background_style_release(clip->style);
+  free(clip);
+}
+
 static void background_reset_clip(struct background* background) {
   for (uint32_t i = 0; i < background->num_clips; i++)
-    free(background->clips[i]);
+    background_free_clip(background->clips[i]);
 
   if (background->clips) free(background->clips);
   background->clips = NULL;
@@ -57,7 +110,9 @@ bool background_set_enabled(struct background* background, bool enabled) {
 
 bool background_set_color(struct background* background, uint32_t color) {
   bool changed = background_set_enabled(background, true);
-  return color_set_hex(&background->color, color) || changed;
+  if (background->style->color.hex == color) return changed;
+  return color_set_hex(&background_style_mut(background)->color, color)
+         || changed;
 }
 
 static bool background_set_clip(struct background* background, float clip) {
@@ -70,51 +125,187 @@ static bool background_set_clip(struct background* background, float clip) {
 }
 
 static bool background_set_border_color(struct background* background, uint32_t color) {
-  return color_set_hex(&background->border_color, color);
+  if (background->style->border_color.hex == color) return false;
+  return color_set_hex(&background_style_mut(background)->border_color, color);
 }
 
 static bool background_set_border_width(struct background* background, uint32_t border_width) {
-  if (background->border_width == border_width) return false;
-  background->border_width = border_width;
+  if (background->style->border_width == border_width) return false;
+  background_style_mut(background)->border_width = border_width;
   return true;
 }
 
 static bool background_set_corner_radius(struct background* background, uint32_t corner_radius) {
-  if (background->corner_radius == corner_radius) return false;
-  background->corner_radius = corner_radius;
+  if (background->style->corner_radius == corner_radius) return false;
+  background_style_mut(background)->corner_radius = corner_radius;
   return true;
 }
 
 static bool background_set_yoffset(struct background* background, int offset) {
-  if (background->y_offset == offset) return false;
-  background->y_offset = offset;
+  if (background->style->y_offset == offset) return false;
+  background_style_mut(background)->y_offset = offset;
   return true;
 }
 
 bool background_set_padding_left(struct background* background, uint32_t pad) {
-  if (background->padding_left == pad) return false;
-  background->padding_left = pad;
+  if (background->style->padding_left == pad) return false;
+  background_style_mut(background)->padding_left = pad;
   return true;
 }
 
 bool background_set_padding_right(struct background* background, uint32_t pad) {
-  if (background->padding_right == pad) return false;
-  background->padding_right = pad;
+  if (background->style->padding_right == pad) return false;
+  background_style_mut(background)->padding_right = pad;
   return true;
 }
 
+// The setters below reach into the style block on every call, an animation
+// holds the background and thus never outlives a copy-on-write split.
+#define BACKGROUND_STYLE_SETTER(name, setter, member, type) \
+static bool name(struct background* background, type value) { \
+  return setter(&background_style_mut(background)->member, value); \
+}
+
+BACKGROUND_STYLE_SETTER(background_set_color_alpha, color_set_alpha, color, float)
+BACKGROUND_STYLE_SETTER(background_set_color_r, color_set_r, color, float)
+BACKGROUND_STYLE_SETTER(background_set_color_g, color_set_g, color, float)
+BACKGROUND_STYLE_SETTER(background_set_color_b, color_set_b, color, float)
+
+BACKGROUND_STYLE_SETTER(background_set_border_color_alpha, color_set_alpha, border_color, float)
+BACKGROUND_STYLE_SETTER(background_set_border_color_r, color_set_r, border_color, float)
+BACKGROUND_STYLE_SETTER(background_set_border_color_g, color_set_g, border_color, float)
+BACKGROUND_STYLE_SETTER(background_set_border_color_b, color_set_b, border_color, float)
+
+BACKGROUND_STYLE_SETTER(background_set_shadow_enabled, shadow_set_enabled, shadow, bool)
+BACKGROUND_STYLE_SETTER(background_set_shadow_angle, shadow_set_angle, shadow, uint32_t)
+BACKGROUND_STYLE_SETTER(background_set_shadow_distance, shadow_set_distance, shadow, uint32_t)
+BACKGROUND_STYLE_SETTER(background_set_shadow_color, shadow_set_color, shadow, uint32_t)
+BACKGROUND_STYLE_SETTER(background_set_shadow_color_alpha, color_set_alpha, shadow.color, float)
+BACKGROUND_STYLE_SETTER(background_set_shadow_color_r, color_set_r, shadow.color, float)
+BACKGROUND_STYLE_SETTER(background_set_shadow_color_g, color_set_g, shadow.color, float)
+BACKGROUND_STYLE_SETTER(background_set_shadow_color_b, color_set_b, shadow.color, float)
+
+// Mirrors color_parse_sub_domain for a color inside the style block.
+#define BACKGROUND_COLOR_PARSER(name, member, set_hex, set_alpha, set_r, set_g, set_b) \
+static bool name(struct background* background, FILE* rsp, struct token property, char* message) { \
+  bool needs_refresh = false; \
+  struct color* color = &background->style->member; \
+  if (token_equals(property, PROPERTY_COLOR_HEX)) { \
+    ANIMATE_BYTES(set_hex, background, color->hex, \
+                  token_to_int(get_token(&message))); \
+  } \
+  else if (token_equals(property, PROPERTY_COLOR_ALPHA)) { \
+    ANIMATE_FLOAT(set_alpha, background, color->a, \
+                  token_to_float(get_token(&message))); \
+  } \
+  else if (token_equals(property, PROPERTY_COLOR_RED)) { \
+    ANIMATE_FLOAT(set_r, background, color->r, \
+                  token_to_float(get_token(&message))); \
+  } \
+  else if (token_equals(property, PROPERTY_COLOR_GREEN)) { \
+    ANIMATE_FLOAT(set_g, background, color->g, \
+                  token_to_float(get_token(&message))); \
+  } \
+  else if (token_equals(property, PROPERTY_COLOR_BLUE)) { \
+    ANIMATE_FLOAT(set_b, background, color->b, \
+                  token_to_float(get_token(&message))); \
+  } \
+  else { \
+    respond(rsp, "[?] Color: Invalid property '%s'\n", property.text); \
+  } \
+  return needs_refresh; \
+}
+
+BACKGROUND_COLOR_PARSER(background_parse_color_sub_domain,
+                        color,
+                        background_set_color,
+                        background_set_color_alpha,
+                        background_set_color_r,
+                        background_set_color_g,
+                        background_set_color_b                  )
+
+BACKGROUND_COLOR_PARSER(background_parse_border_color_sub_domain,
+                        border_color,
+                        background_set_border_color,
+                        background_set_border_color_alpha,
+                        background_set_border_color_r,
+                        background_set_border_color_g,
+                        background_set_border_color_b            )
+
+BACKGROUND_COLOR_PARSER(background_parse_shadow_color_sub_domain,
+                        shadow.color,
+                        background_set_shadow_color,
+                        background_set_shadow_color_alpha,
+                        background_set_shadow_color_r,
+                        background_set_shadow_color_g,
+                        background_set_shadow_color_b            )
+
+static bool background_parse_shadow_sub_domain(struct background* background, FILE* rsp, struct token property, char* message) {
+  bool needs_refresh = false;
+  struct shadow* shadow = &background->style->shadow;
+  if (token_equals(property, PROPERTY_DRAWING)) {
+    needs_refresh = background_set_shadow_enabled(background,
+                                       evaluate_boolean_state(get_token(&message),
+                                                              shadow->enabled     ));
+  }
+  else if (token_equals(property, PROPERTY_DISTANCE)) {
+    struct token token = get_token(&message);
+    ANIMATE(background_set_shadow_distance,
+            background,
+            shadow->distance,
+            token_to_int(token)           );
+  }
+  else if (token_equals(property, PROPERTY_ANGLE)) {
+    struct token token = get_token(&message);
+    ANIMATE(background_set_shadow_angle,
+            background,
+            shadow->angle,
+            token_to_int(token)        );
+  }
+  else if (token_equals(property, PROPERTY_COLOR)) {
+    struct token token = get_token(&message);
+    ANIMATE_BYTES(background_set_shadow_color,
+                  background,
+                  shadow->color.hex,
+                  token_to_int(token)        );
+  }
+  else {
+    struct key_value_pair key_value_pair = get_key_value_pair(property.text,
+                                                              '.'           );
+    if (key_value_pair.key && key_value_pair.value) {
+      struct token subdom = {key_value_pair.key,strlen(key_value_pair.key)};
+      struct token entry = {key_value_pair.value,strlen(key_value_pair.value)};
+      if (token_equals(subdom, SUB_DOMAIN_COLOR)) {
+        return background_parse_shadow_color_sub_domain(background,
+                                                        rsp,
+                                                        entry,
+                                                        message   );
+      }
+      else {
+        respond(rsp, "[!] Shadow: Invalid subdomain '%s'\n", subdom.text);
+      }
+    } else {
+      respond(rsp, "[!] Shadow: Invalid property '%s'\n", property.text);
+    }
+  }
+
+  return needs_refresh;
+}
+
 bool background_clip_needs_update(struct background* background, struct bar* bar) {
   if (background->clip == 0.f || !background->enabled) return false;
   struct background* clip = background_get_clip(background, bar->adid);
   if (!CGRectEqualToRect(background->bounds, clip->bounds)) return true;
-  if (background->corner_radius != clip->corner_radius) return true;
-  if (background->y_offset != clip->y_offset) return true;
+  if (background->style->corner_radius != clip->style->corner_radius) return true;
+  if (background->style->y_offset != clip->style->y_offset) return true;
   return false;
 }
 
 static void background_update_clip(struct background* background, struct background* clip) {
+  background_style_release(clip->style);
   memcpy(clip, background, sizeof(struct background));
   background_clear_pointers(clip);
+  clip->style = background_style_retain(background->style);
 }
 
 struct background* background_get_clip(struct background* background, uint32_t adid) {
@@ -152,12 +343,12 @@ void background_clip_bar(struct background* background, int offset, struct bar*
 
   CGRect background_bounds = background->bounds;
   background_bounds.origin.x += offset;
-  background_bounds.origin.y += background->y_offset;
+  background_bounds.origin.y += background->style->y_offset;
 
   clip_rect(bar->window.context,
             background_bounds,
             background->clip,
-            background->corner_radius);
+            background->style->corner_radius);
 }
 
 void background_calculate_bounds(struct background* background, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
@@ -185,41 +376,51 @@ static void draw_rect(CGContextRef context, CGRect region, struct color* fill_co
   CFRelease(path);
 }
 
-void background_draw(struct background* background, CGContextRef context) {
+static void background_draw_internal(struct background* background, CGContextRef context, bool shadow) {
   if (!background->enabled) return;
+  struct background_style* style = background->style;
+  shadow &= style->shadow.enabled;
 
-  if ((background->border_color.a == 0 || background->border_width == 0)
-      && (background->color.a == 0)
-      && !background->shadow.enabled
-      && !background->image.enabled                                      ) {
+  if ((style->border_color.a == 0 || style->border_width == 0)
+      && (style->color.a == 0)
+      && !shadow
+      && !background->image.enabled                          ) {
     // The background is enabled but has no content.
     return;
   }
 
   CGRect background_bounds = background->bounds;
-  background_bounds.origin.y += background->y_offset;
-  if (background->shadow.enabled) {
-    CGRect bounds = shadow_get_bounds(&background->shadow, background_bounds);
+  background_bounds.origin.y += style->y_offset;
+  if (shadow) {
+    CGRect bounds = shadow_get_bounds(&style->shadow, background_bounds);
     draw_rect(context,
               bounds,
-              &background->shadow.color,
-              background->corner_radius,
-              background->border_width,
-              &background->shadow.color);
+              &style->shadow.color,
+              style->corner_radius,
+              style->border_width,
+              &style->shadow.color);
   }
 
   draw_rect(context,
             background_bounds,
-            &background->color,
-            background->corner_radius,
-            background->border_width,
-            &background->border_color);
+            &style->color,
+            style->corner_radius,
+            style->border_width,
+            &style->border_color);
 
   if (background->image.enabled)
     image_draw(&background->image, context);
 
 }
 
+void background_draw(struct background* background, CGContextRef context) {
+  background_draw_internal(background, context, true);
+}
+
+void background_draw_without_shadow(struct background* background, CGContextRef context) {
+  background_draw_internal(background, context, false);
+}
+
 void background_clear_pointers(struct background* background) {
   background->clips = NULL;
   background->num_clips = 0;
@@ -228,14 +429,39 @@ void background_clear_pointers(struct background* background) {
 
 void background_destroy(struct background* background) {
   for (uint32_t i = 0; i < background->num_clips; i++)
-    free(background->clips[i]);
+    background_free_clip(background->clips[i]);
 
   if (background->clips) free(background->clips);
 
   image_destroy(&background->image);
+  background_style_release(background->style);
+  background->style = NULL;
   background_clear_pointers(background);
 }
 
+// Compares the resident bytes per item against a layout in which every
+// background keeps its own copy of the style fields.
+void background_styles_serialize(char* indent, FILE* rsp, uint32_t item_count, size_t item_size, uint32_t styles_per_item) {
+  size_t inline_size = sizeof(struct background_style) - sizeof(uint32_t);
+  size_t unshared = item_size
+                    + styles_per_item * (inline_size
+                                         - sizeof(struct background_style*));
+  size_t shared = item_size + g_background_style_count
+                              * sizeof(struct background_style)
+                              / max(item_count, 1);
+
+  fprintf(rsp, "%s\"blocks\": %u,\n"
+               "%s\"references\": %u,\n"
+               "%s\"block_bytes\": %zu,\n"
+               "%s\"item_bytes_unshared\": %zu,\n"
+               "%s\"item_bytes_shared\": %zu",
+               indent, g_background_style_count,
+               indent, g_background_style_references,
+               indent, sizeof(struct background_style),
+               indent, unshared,
+               indent, shared                          );
+}
+
 void background_serialize(struct background* background, char* indent, FILE* rsp, bool detailed) {
   fprintf(rsp, "%s\"drawing\": \"%s\",\n"
                "%s\"color\": \"0x%x\",\n"
@@ -248,14 +474,14 @@ void background_serialize(struct background* background, char* indent, FILE* rsp
                "%s\"y_offset\": %d,\n"
                "%s\"clip\": %f,\n",
                indent, format_bool(background->enabled),
-               indent, background->color.hex,
-               indent, background->border_color.hex,
-               indent, background->border_width,
+               indent, background->style->color.hex,
+               indent, background->style->border_color.hex,
+               indent, background->style->border_width,
                indent, background->overrides_height ? (int)background->bounds.size.height : 0,
-               indent, background->corner_radius,
-               indent, background->padding_left,
-               indent, background->padding_right,
-               indent, background->y_offset,
+               indent, background->style->corner_radius,
+               indent, background->style->padding_left,
+               indent, background->style->padding_right,
+               indent, background->style->y_offset,
                indent, background->clip                                                       );
 
   char deeper_indent[strlen(indent) + 2];
@@ -268,7 +494,7 @@ void background_serialize(struct background* background, char* indent, FILE* rsp
   if (!detailed) return;
 
   fprintf(rsp, ",\n%s\"shadow\": {\n", indent);
-  shadow_serialize(&background->shadow, deeper_indent, rsp);
+  shadow_serialize(&background->style->shadow, deeper_indent, rsp);
   fprintf(rsp, "\n%s}", indent);
 }
 
@@ -295,49 +521,49 @@ bool background_parse_sub_domain(struct background* background, FILE* rsp, struc
     struct token token = get_token(&message);
     ANIMATE(background_set_corner_radius,
             background,
-            background->corner_radius,
+            background->style->corner_radius,
             token_to_int(token)          );
   }
   else if (token_equals(property, PROPERTY_BORDER_WIDTH)) {
     struct token token = get_token(&message);
     ANIMATE(background_set_border_width,
             background,
-            background->border_width,
+            background->style->border_width,
             token_to_int(token)         );
   }
   else if (token_equals(property, PROPERTY_COLOR)) {
     struct token token = get_token(&message);
     ANIMATE_BYTES(background_set_color,
                   background,
-                  background->color.hex,
+                  background->style->color.hex,
                   token_to_int(token)   );
   }
   else if (token_equals(property, PROPERTY_BORDER_COLOR)) {
     struct token token = get_token(&message);
     ANIMATE_BYTES(background_set_border_color,
                   background,
-                  background->border_color.hex,
+                  background->style->border_color.hex,
                   token_to_int(token)          );
   }
   else if (token_equals(property, PROPERTY_PADDING_LEFT)) {
     struct token token = get_token(&message);
     ANIMATE(background_set_padding_left,
             background,
-            background->padding_left,
+            background->style->padding_left,
             token_to_int(token)         );
   }
   else if (token_equals(property, PROPERTY_PADDING_RIGHT)) {
     struct token token = get_token(&message);
     ANIMATE(background_set_padding_right,
             background,
-            background->padding_right,
+            background->style->padding_right,
             token_to_int(token)         );
   }
   else if (token_equals(property, PROPERTY_YOFFSET)) {
     struct token token = get_token(&message);
     ANIMATE(background_set_yoffset,
             background,
-            background->y_offset,
+            background->style->y_offset,
             token_to_int(token)    );
   }
   else if (token_equals(property, SUB_DOMAIN_IMAGE)) {
@@ -352,21 +578,24 @@ bool background_parse_sub_domain(struct background* background, FILE* rsp, struc
       struct token subdom = {key_value_pair.key,strlen(key_value_pair.key)};
       struct token entry = {key_value_pair.value,strlen(key_value_pair.value)};
       if (token_equals(subdom, SUB_DOMAIN_SHADOW))
-        return shadow_parse_sub_domain(&background->shadow,
-                                       rsp,
-                                       entry,
-                                       message             );
+        return background_parse_shadow_sub_domain(background,
+                                                  rsp,
+                                                  entry,
+                                                  message   );
       else if (token_equals(subdom, SUB_DOMAIN_IMAGE)) {
         return image_parse_sub_domain(&background->image, rsp, entry, message);
       }
       else if (token_equals(subdom, SUB_DOMAIN_COLOR)) {
-        return color_parse_sub_domain(&background->color, rsp, entry, message);
+        return background_parse_color_sub_domain(background,
+                                                 rsp,
+                                                 entry,
+                                                 message   );
       }
       else if (token_equals(subdom, SUB_DOMAIN_BORDER_COLOR)) {
-        return color_parse_sub_domain(&background->border_color,
-                                      rsp,
-                                      entry,
-                                      message                   );
+        return background_parse_border_color_sub_domain(background,
+                                                        rsp,
+                                                        entry,
+                                                        message   );
       }
       else {
         respond(rsp, "[!] Background: Invalid subdomain '%s'\n", subdom.text);
@@ -1,10 +1,11 @@
 #pragma once
 #include "image.h"
 
-struct background {
-  bool enabled;
-  float clip;
-  bool overrides_height;
+// The look of a background is immutable and shared by all backgrounds that
+// have not overridden any of its fields since they were copied, e.g. all
+// items inheriting it from the defaults. The first write copies it.
+struct background_style {
+  uint32_t refcount;
 
   int padding_left;
   int padding_right;
@@ -12,11 +13,19 @@ struct background {
   uint32_t border_width;
   uint32_t corner_radius;
 
-  CGRect bounds;
-  struct image image;
   struct shadow shadow;
   struct color color;
   struct color border_color;
+};
+
+struct background {
+  bool enabled;
+  float clip;
+  bool overrides_height;
+
+  CGRect bounds;
+  struct image image;
+  struct background_style* style;
 
   struct background** clips;
   uint32_t num_clips;
@@ -25,6 +34,8 @@ struct background {
 struct bar;
 
 void background_init(struct background* background);
+void background_copy(struct background* background, struct background* source);
+struct background_style* background_style_mut(struct background* background);
 void background_calculate_bounds(struct background* background, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
 
 bool background_set_enabled(struct background* background, bool enabled);
@@ -34,6 +45,7 @@ bool background_set_padding_left(struct background* background, uint32_t pad);
 bool background_set_padding_right(struct background* background, uint32_t pad);
 
 void background_draw(struct background* background, CGContextRef context);
+void background_draw_without_shadow(struct background* background, CGContextRef context);
 
 struct background* background_get_clip(struct background* background, uint32_t adid);
 void background_clip_bar(struct background* background, int offset, struct bar* bar);
@@ -43,5 +55,6 @@ bool background_clips_bar(struct background* background);
 void background_clear_pointers(struct background* background);
 void background_destroy(struct background* background);
 
+void background_styles_serialize(char* indent, FILE* rsp, uint32_t item_count, size_t item_size, uint32_t styles_per_item);
 void background_serialize(struct background* background, char* indent, FILE* rsp, bool detailed);
 bool background_parse_sub_domain(struct background* background, FILE* rsp, struct token property, char* message);
@@ -4,15 +4,13 @@
 #include "display.h"
 #include "misc/helpers.h"
 #include "window.h"
+#include "render_pool.h"
+#include "trace.h"
 
-#define MAX_RENDER_THREADS 10
-static pthread_t g_render_threads[MAX_RENDER_THREADS];
-static uint32_t g_used_threads = 0;
+static struct render_pool g_render_pool = { 0 };
 
 void join_render_threads() {
-  for (int i = 0; i < g_used_threads; i++)
-    pthread_join(g_render_threads[i], NULL);
-  g_used_threads = 0;
+  render_pool_wait(&g_render_pool);
 }
 
 bool bar_draws_item(struct bar* bar, struct bar_item* bar_item) {
@@ -31,11 +29,13 @@ bool bar_draws_item(struct bar* bar, struct bar_item* bar_item) {
         && (bar_item->type != BAR_COMPONENT_SPACE)        )
       return false;
 
-    if (bar_item->position == POSITION_POPUP
-        && (!bar_item->parent
-            || !bar_item->parent->popup.drawing
-            || (bar->adid != g_bar_manager.active_adid)))
-      return false;
+    if (bar_item->position == POSITION_POPUP) {
+      struct bar_item* parent = bar_item_get_parent(bar_item);
+      if (!parent
+          || !parent->popup.drawing
+          || (bar->adid != g_bar_manager.active_adid))
+        return false;
+    }
 
     return true;
 }
@@ -63,7 +63,7 @@ static void bar_calculate_popup_anchor_for_bar_item(struct bar* bar, struct bar_
       anchor.y += (window->frame.size.height
                    - bar_item->popup.background.bounds.size.height) / 2;
     } else if (bar_item->popup.align == POSITION_LEFT) {
-      anchor.y -= bar_item->background.padding_left;
+      anchor.y -= bar_item->background.style->padding_left;
     } else {
       anchor.y += window->frame.size.height
                   - bar_item->popup.background.bounds.size.height;
@@ -76,7 +76,7 @@ static void bar_calculate_popup_anchor_for_bar_item(struct bar* bar, struct bar_
       anchor.x += (window->frame.size.width
                    - bar_item->popup.background.bounds.size.width) / 2;
     } else if (bar_item->popup.align == POSITION_LEFT) {
-      anchor.x -= bar_item->background.padding_left;
+      anchor.x -= bar_item->background.style->padding_left;
     } else {
       anchor.x += window->frame.size.width
                   - bar_item->popup.background.bounds.size.width;
@@ -149,6 +149,7 @@ static void bar_check_for_clip_updates(struct bar* bar) {
 
 void bar_draw(struct bar* bar, bool forced, bool threaded) {
   if (bar->sid < 1 || bar->adid < 1) return;
+  TRACE_BEGIN(bar_draw);
 
   if (g_bar_manager.might_need_clipping)
     bar_check_for_clip_updates(bar);
@@ -156,12 +157,11 @@ void bar_draw(struct bar* bar, bool forced, bool threaded) {
   if (g_bar_manager.bar_needs_update) {
     struct background background = g_bar_manager.background;
     background.bounds = bar->window.frame;
-    background.bounds.origin.y -= background.y_offset;
-    background.shadow.enabled = false;
+    background.bounds.origin.y -= background.style->y_offset;
     background.enabled = true;
     windows_freeze();
     CGContextClearRect(bar->window.context, bar->window.frame);
-    background_draw(&background, bar->window.context);
+    background_draw_without_shadow(&background, bar->window.context);
   }
 
   for (int i = 0; i < g_bar_manager.bar_item_count; i++) {
@@ -197,47 +197,113 @@ void bar_draw(struct bar* bar, bool forced, bool threaded) {
     }
 
     windows_freeze();
-    if (threaded && g_used_threads < MAX_RENDER_THREADS) {
-      uint32_t thread_id = g_used_threads++;
-      struct draw_item_payload {
-        struct window* window;
-        struct bar_item bar_item;
-      }* context = malloc(sizeof(struct draw_item_payload));
-      // We need to perform a shallow copy of the item here because
-      // the cached bounds will be invalidated when drawing the next bar.
-      context->bar_item = *bar_item;
-      context->window = window;
-      pthread_create(&g_render_threads[thread_id],
-                     NULL,
-                     draw_item_proc,
-                     context        );
-    } else {
-      CGContextClearRect(window->context, window->frame);
-      bar_item_draw(bar_item, window->context);
-      CGContextFlush(window->context);
-      window_flush(window);
-    }
+    if (threaded && !g_render_pool.running)
+      render_pool_init(&g_render_pool, draw_item_proc);
+
+    if (!threaded || !render_pool_submit(&g_render_pool, window, bar_item))
+      draw_item_proc(window, bar_item);
   }
 
   if (g_bar_manager.bar_needs_update) {
     CGContextFlush(bar->window.context);
     window_flush(&bar->window);
   }
+  TRACE_END(bar_draw);
+}
+
+static void bar_prepare_layout(struct bar* bar, uint32_t thickness) {
+  if (bar->layout_count < g_bar_manager.bar_item_count) {
+    bar->layout = realloc(bar->layout, sizeof(struct bar_layout_entry)
+                                       * g_bar_manager.bar_item_count);
+    memset(bar->layout + bar->layout_count,
+           0,
+           sizeof(struct bar_layout_entry)
+           * (g_bar_manager.bar_item_count - bar->layout_count));
+
+    bar->layout_count = g_bar_manager.bar_item_count;
+  }
+
+  // The measured item bounds are stored in the items themselves and are thus
+  // only reusable if no bar with a different thickness has overwritten them.
+  bar->layout_valid = !g_bar_manager.bar_needs_update
+                      && !bar->needs_association_check
+                      && bar->layout_thickness == thickness
+                      && bar_manager_bars_share_layout(&g_bar_manager);
+
+  bar->layout_thickness = thickness;
+}
+
+static struct bar_layout_entry* bar_measure_item(struct bar* bar, uint32_t index, bool vertical) {
+  struct bar_item* bar_item = g_bar_manager.bar_items[index];
+  struct bar_layout_entry* entry = &bar->layout[index];
+
+  if (!bar_draws_item(bar, bar_item)
+      || bar_item->type == BAR_COMPONENT_GROUP
+      || bar_item->position == POSITION_POPUP ) {
+    entry->bar_item = NULL;
+    return NULL;
+  }
+
+  if (bar->layout_valid
+      && entry->bar_item == bar_item
+      && !bar_item->needs_update   ) {
+    return entry;
+  }
+
+  entry->bar_item = bar_item;
+  entry->shadow_offsets = bar_item_calculate_shadow_offsets(bar_item);
+
+  if (vertical) {
+    uint32_t bar_item_display_length = bar_item_get_length(bar_item, true);
+    entry->display_length = bar_item_get_height(bar_item);
+    entry->length = entry->display_length;
+    entry->bounds_length = bar_item_calculate_bounds(bar_item,
+                              entry->display_length,
+                              (g_bar_manager.background.bounds.size.height
+                               - bar_item_display_length) / 2.
+                              + max(entry->shadow_offsets.x, 0),
+                              entry->display_length / 2.         );
+  } else {
+    entry->display_length = bar_item_get_length(bar_item, true);
+    entry->length = bar_item_get_length(bar_item, false);
+    entry->bounds_length = bar_item_calculate_bounds(bar_item,
+                                 bar->window.frame.size.height
+                                 - (g_bar_manager.background.style->border_width + 1),
+                                 max(entry->shadow_offsets.x, 0),
+                                 bar->window.frame.size.height / 2           );
+  }
+  return entry;
+}
+
+static uint32_t bar_measure_items(struct bar* bar, bool vertical) {
+  uint32_t center_length = 0;
+  for (int i = 0; i < g_bar_manager.bar_item_count; i++) {
+    struct bar_layout_entry* entry = bar_measure_item(bar, i, vertical);
+    if (!entry || entry->bar_item->position != POSITION_CENTER) continue;
+
+    center_length += entry->length
+                     + (entry->bar_item->has_const_width
+                        ? 0
+                        : entry->bar_item->background.style->padding_left
+                          + entry->bar_item->background.style->padding_right);
+  }
+  return center_length;
 }
 
 static void bar_calculate_bounds_top_bottom(struct bar* bar) {
   bool is_builtin = CGDisplayIsBuiltin(bar->did);
   uint32_t notch_width = is_builtin ? g_bar_manager.notch_width : 0;
 
-  uint32_t center_length = bar_manager_length_for_bar_side(&g_bar_manager,
-                                                           bar,
-                                                           POSITION_CENTER);
+  // Only items which changed are measured again, all others are shifted
+  // with their cached extents.
+  bar_prepare_layout(bar, bar->window.frame.size.height);
+  uint32_t center_length = bar_measure_items(bar, false);
 
-  uint32_t bar_left_first_item_x = max(g_bar_manager.background.padding_left,
+  uint32_t bar_left_first_item_x = max(g_bar_manager.background.style->padding_left,
                                        0                                     );
 
   uint32_t bar_right_first_item_x = bar->window.frame.size.width
-                                   -max(g_bar_manager.background.padding_right,
+                                   -max(g_bar_manager.background.style->padding_right,
                                           0                                  );
 
   uint32_t bar_center_first_item_x = (bar->window.frame.size.width
@@ -254,14 +320,10 @@ static void bar_calculate_bounds_top_bottom(struct bar* bar) {
 
   for (int i = 0; i < g_bar_manager.bar_item_count; i++) {
     struct bar_item* bar_item = g_bar_manager.bar_items[i];
+    struct bar_layout_entry* entry = &bar->layout[i];
+    if (entry->bar_item != bar_item) continue;
 
-    if (!bar_draws_item(bar, bar_item)
-        || bar_item->type == BAR_COMPONENT_GROUP
-        || bar_item->position == POSITION_POPUP ) {
-      continue;
-    } 
-
-    uint32_t bar_item_display_length = bar_item_get_length(bar_item, true);
+    uint32_t bar_item_display_length = entry->display_length;
     bool rtl = false;
 
     if (bar_item->position == POSITION_LEFT)
@@ -279,23 +341,19 @@ static void bar_calculate_bounds_top_bottom(struct bar* bar) {
     if (bar_item->position == POSITION_RIGHT
         || bar_item->position == POSITION_CENTER_LEFT) {
       *next_position = min(*next_position - bar_item_display_length
-                           - bar_item->background.padding_right,
+                           - bar_item->background.style->padding_right,
                            bar->window.frame.size.width
                            - bar_item_display_length               );
     }
     else {
       *next_position += max((int)-*next_position,
-                            bar_item->background.padding_left);
+                            bar_item->background.style->padding_left);
     }
 
     bar_item->graph.rtl = rtl;
 
-    CGPoint shadow_offsets = bar_item_calculate_shadow_offsets(bar_item);
-    uint32_t bar_item_length = bar_item_calculate_bounds(bar_item,
-                                 bar->window.frame.size.height
-                                 - (g_bar_manager.background.border_width + 1),
-                                 max(shadow_offsets.x, 0),
-                                 y                                           );
+    CGPoint shadow_offsets = entry->shadow_offsets;
+    uint32_t bar_item_length = entry->bounds_length;
 
     CGRect frame = {{bar->window.origin.x + *next_position
                     - max(shadow_offsets.x, 0),
@@ -314,15 +372,15 @@ static void bar_calculate_bounds_top_bottom(struct bar* bar) {
         || bar_item->position == POSITION_CENTER_LEFT) {
       *next_position += bar_item->has_const_width
                         ? bar_item_display_length
-                          + bar_item->background.padding_right
+                          + bar_item->background.style->padding_right
                           - bar_item->custom_width
-                        : (- bar_item->background.padding_left);
+                        : (- bar_item->background.style->padding_left);
     } else {
       *next_position += bar_item->has_const_width
                         ? bar_item->custom_width
-                          - bar_item->background.padding_left
+                          - bar_item->background.style->padding_left
                         : (bar_item_length
-                           + bar_item->background.padding_right);
+                           + bar_item->background.style->padding_right);
     }
   }
 
@@ -336,9 +394,8 @@ static void bar_calculate_bounds_top_bottom(struct bar* bar) {
     }
 
     group_calculate_bounds(bar_item->group, bar, y);
-    window_set_frame(bar_item_get_window(bar_item->group->members[0],
-                                         bar->adid                   ),
-                     bar_item->group->bounds                           );
+    window_set_frame(bar_item_get_window(bar_item, bar->adid),
+                     bar_item->group->bounds                  );
 
     if (bar_item->popup.drawing)
       bar_calculate_popup_anchor_for_bar_item(bar, bar_item);
@@ -348,15 +405,14 @@ static void bar_calculate_bounds_top_bottom(struct bar* bar) {
 static void bar_calculate_bounds_left_right(struct bar* bar) {
   uint32_t notch_width = 0;
 
-  uint32_t center_length = bar_manager_length_for_bar_side(&g_bar_manager,
-                                                           bar,
-                                                           POSITION_CENTER);
+  bar_prepare_layout(bar, g_bar_manager.background.bounds.size.height);
+  uint32_t center_length = bar_measure_items(bar, true);
 
-  uint32_t bar_left_first_item_y = max(g_bar_manager.background.padding_left,
+  uint32_t bar_left_first_item_y = max(g_bar_manager.background.style->padding_left,
                                        0                                     );
 
   uint32_t bar_right_first_item_y = bar->window.frame.size.height
-                                   -max(g_bar_manager.background.padding_right,
+                                   -max(g_bar_manager.background.style->padding_right,
                                           0                                  );
 
   uint32_t bar_center_first_item_y = (bar->window.frame.size.height
@@ -373,15 +429,10 @@ static void bar_calculate_bounds_left_right(struct bar* bar) {
 
   for (int i = 0; i < g_bar_manager.bar_item_count; i++) {
     struct bar_item* bar_item = g_bar_manager.bar_items[i];
+    struct bar_layout_entry* entry = &bar->layout[i];
+    if (entry->bar_item != bar_item) continue;
 
-    if (!bar_draws_item(bar, bar_item)
-        || bar_item->type == BAR_COMPONENT_GROUP
-        || bar_item->position == POSITION_POPUP ) {
-      continue;
-    } 
-
-    uint32_t bar_item_display_height = bar_item_get_height(bar_item);
-    uint32_t bar_item_display_length = bar_item_get_length(bar_item, true);
+    uint32_t bar_item_display_height = entry->display_length;
     uint32_t x =  0;
     bool rtl = false;
 
@@ -401,25 +452,18 @@ static void bar_calculate_bounds_left_right(struct bar* bar) {
         || bar_item->position == POSITION_CENTER_LEFT) {
 
       *next_position = min(*next_position - bar_item_display_height
-                           - bar_item->background.padding_right,
+                           - bar_item->background.style->padding_right,
                            bar->window.frame.size.height
                            - bar_item_display_height               );
     }
     else {
       *next_position += max((int)-*next_position,
-                            bar_item->background.padding_left);
+                            bar_item->background.style->padding_left);
     }
 
     bar_item->graph.rtl = rtl;
 
-    CGPoint shadow_offsets = bar_item_calculate_shadow_offsets(bar_item);
-    bar_item_calculate_bounds(bar_item,
-                              bar_item_display_height,
-                              (g_bar_manager.background.bounds.size.height
-                               - bar_item_display_length) / 2.
-                              + max(shadow_offsets.x, 0),
-                              bar_item_display_height / 2.);
-
+    CGPoint shadow_offsets = entry->shadow_offsets;
 
     CGRect frame = {{bar->window.origin.x + x
                      - max(shadow_offsets.x, 0),
@@ -438,15 +482,15 @@ static void bar_calculate_bounds_left_right(struct bar* bar) {
         || bar_item->position == POSITION_CENTER_LEFT) {
       *next_position += bar_item->has_const_width
                         ? bar_item_display_height
-                          + bar_item->background.padding_right
+                          + bar_item->background.style->padding_right
                           - bar_item->custom_width
-                        : - bar_item->background.padding_left;
+                        : - bar_item->background.style->padding_left;
     } else {
       *next_position += bar_item->has_const_width
                         ? bar_item->custom_width
-                          - bar_item->background.padding_left
+                          - bar_item->background.style->padding_left
                         : (bar_item_display_height
-                           + bar_item->background.padding_right);
+                           + bar_item->background.style->padding_right);
     }
   }
 }
@@ -454,12 +498,14 @@ static void bar_calculate_bounds_left_right(struct bar* bar) {
 void bar_calculate_bounds(struct bar* bar) {
   if (bar->sid < 1 || bar->adid < 1) return;
 
+  TRACE_BEGIN(bar_calculate_bounds);
   if (g_bar_manager.position == POSITION_LEFT
       || g_bar_manager.position == POSITION_RIGHT) {
     bar_calculate_bounds_left_right(bar);
   } else {
     bar_calculate_bounds_top_bottom(bar);
   }
+  TRACE_END(bar_calculate_bounds);
 }
 
 static CGRect bar_get_frame(struct bar *bar) {
@@ -473,7 +519,7 @@ static CGRect bar_get_frame(struct bar *bar) {
 
   if (g_bar_manager.position == POSITION_LEFT
       || g_bar_manager.position == POSITION_RIGHT) {
-    bounds.size.height -= 2*g_bar_manager.background.y_offset;
+    bounds.size.height -= 2*g_bar_manager.background.style->y_offset;
 
     origin.x += (g_bar_manager.position == POSITION_RIGHT
                  ? (bounds.size.width
@@ -481,7 +527,7 @@ static CGRect bar_get_frame(struct bar *bar) {
                     - g_bar_manager.margin)
                  : g_bar_manager.margin);
 
-    origin.y += g_bar_manager.background.y_offset;
+    origin.y += g_bar_manager.background.style->y_offset;
 
     if (display_menu_bar_visible() && !g_bar_manager.topmost) {
       CGRect menu = display_menu_bar_rect(bar->did);
@@ -496,13 +542,13 @@ static CGRect bar_get_frame(struct bar *bar) {
     bounds.size.width -= 2*g_bar_manager.margin;
     CGPoint origin = bounds.origin;
     origin.x += g_bar_manager.margin;
-    origin.y += g_bar_manager.background.y_offset + notch_offset;
+    origin.y += g_bar_manager.background.style->y_offset + notch_offset;
 
 
     if (g_bar_manager.position == POSITION_BOTTOM) {
       origin.y = CGRectGetMaxY(bounds)
                  - g_bar_manager.background.bounds.size.height
-                 - 2*(g_bar_manager.background.y_offset) - notch_offset;
+                 - 2*(g_bar_manager.background.style->y_offset) - notch_offset;
     } else if (display_menu_bar_visible() && !g_bar_manager.topmost) {
       CGRect menu = display_menu_bar_rect(bar->did);
       origin.y += menu.size.height;
@@ -536,6 +582,7 @@ void bar_resize(struct bar* bar) {
 void bar_set_hidden(struct bar* bar, bool hidden) {
   if (bar->hidden == hidden) return;
   bar->hidden = hidden;
+  bar->needs_association_check = true;
   
   if (hidden) window_move(&bar->window, g_nirvana);
   else bar_resize(bar);
@@ -571,6 +618,7 @@ struct bar *bar_create(uint32_t did) {
   bar->dsid = display_space_id(did);
   bar->sid = mission_control_index(bar->dsid);
   bar->shown = SLSSpaceGetType(g_connection, bar->dsid) != 4;
+  bar->needs_association_check = true;
   g_bar_manager.bar_needs_update = true;
   bar_create_window(bar);
   return bar;
@@ -578,5 +626,6 @@ struct bar *bar_create(uint32_t did) {
 
 void bar_destroy(struct bar *bar) {
   window_close(&bar->window);
+  if (bar->layout) free(bar->layout);
   free(bar);
 }
@@ -3,10 +3,19 @@
 #include "misc/helpers.h"
 #include "window.h"
 
+struct bar_layout_entry {
+  struct bar_item* bar_item;
+  uint32_t length;
+  uint32_t display_length;
+  uint32_t bounds_length;
+  CGPoint shadow_offsets;
+};
+
 struct bar {
   bool shown;
   bool hidden;
   bool mouse_over;
+  bool needs_association_check;
 
   uint32_t sid;
   uint32_t dsid;
@@ -14,6 +23,11 @@ struct bar {
   uint32_t adid;
 
   struct window window;
+
+  bool layout_valid;
+  uint32_t layout_thickness;
+  uint32_t layout_count;
+  struct bar_layout_entry* layout;
 };
 
 struct bar *bar_create(uint32_t did);
@@ -5,11 +5,12 @@
 #include "power.h"
 #include "media.h"
 #include "app_windows.h"
+#include "trace.h"
 
-struct bar_item* bar_item_create() {
-  struct bar_item* bar_item = malloc(sizeof(struct bar_item));
-  memset(bar_item, 0, sizeof(struct bar_item));
-  return bar_item;
+// Popup items refer to their host by handle, the host might already have
+// been removed, in which case this resolves to NULL.
+struct bar_item* bar_item_get_parent(struct bar_item* bar_item) {
+  return bar_manager_get_item(&g_bar_manager, bar_item->parent);
 }
 
 void bar_item_init(struct bar_item* bar_item, struct bar_item* default_item) {
@@ -49,7 +50,9 @@ void bar_item_init(struct bar_item* bar_item, struct bar_item* default_item) {
   bar_item->click_script = NULL;
 
   bar_item->group = NULL;
-  bar_item->parent = NULL;
+  bar_item->parent = ITEM_HANDLE_NULL;
+  bar_item->config_hash = 0;
+  bar_item->stage = NULL;
 
   text_init(&bar_item->icon);
   text_init(&bar_item->label);
@@ -157,7 +160,9 @@ bool bar_item_update(struct bar_item* bar_item, char* sender, bool forced, struc
     }
     // Script Update
     if (bar_item->script && strlen(bar_item->script) > 0) {
+      TRACE_BEGIN(fork_exec);
       fork_exec(bar_item->script, env_vars);
+      TRACE_END(fork_exec);
     }
 
     // Mach events
@@ -175,6 +180,9 @@ bool bar_item_update(struct bar_item* bar_item, char* sender, bool forced, struc
 
 void bar_item_needs_update(struct bar_item* bar_item) {
   bar_item->needs_update = true;
+
+  if (bar_item != &g_bar_manager.default_item)
+    bar_manager_mark_dirty(&g_bar_manager, bar_item);
 }
 
 void bar_item_cancel_drag(struct bar_item* bar_item) {
@@ -245,7 +253,9 @@ void bar_item_on_click(struct bar_item* bar_item, uint32_t type, uint32_t mouse_
                    string_copy(bar_item->signal_args.env_vars.vars[i]->value));
     }
 
+    TRACE_BEGIN(fork_exec);
     fork_exec(bar_item->click_script, &env_vars);
+    TRACE_END(fork_exec);
   }
   if (bar_item->update_mask & UPDATE_MOUSE_CLICKED)
     bar_item_update(bar_item,
@@ -473,9 +483,8 @@ bool bar_item_set_position(struct bar_item* bar_item, char* position) {
       return false;
   }
 
-  if (bar_item->parent != NULL){
-    popup_remove_item(&bar_item->parent->popup,bar_item);
-  }
+  struct bar_item* parent = bar_item_get_parent(bar_item);
+  if (parent) popup_remove_item(&parent->popup, bar_item);
 
   bar_item->position = position[0];
   if (position[0] != POSITION_POPUP)
@@ -561,8 +570,9 @@ struct window* bar_item_get_window(struct bar_item* bar_item, uint32_t adid) {
     context_set_font_smoothing(bar_item->windows[adid - 1]->context,
                                g_bar_manager.font_smoothing         );
     
-    if (bar_item->parent)
-      bar_item->parent->popup.needs_ordering = true;
+    struct bar_item* parent = bar_item_get_parent(bar_item);
+    if (parent)
+      parent->popup.needs_ordering = true;
     else
       g_bar_manager.needs_ordering = true;
   }
@@ -580,33 +590,33 @@ void bar_item_remove_window(struct bar_item* bar_item, uint32_t adid) {
 
 CGPoint bar_item_calculate_shadow_offsets(struct bar_item* bar_item) {
   CGPoint offset; 
-  offset.x = (int)((bar_item->background.shadow.enabled
-                ? max(-bar_item->background.shadow.offset.x, 0)
+  offset.x = (int)((bar_item->background.style->shadow.enabled
+                ? max(-bar_item->background.style->shadow.offset.x, 0)
                 : 0)
              + (bar_item->icon.shadow.enabled
                 ? max(-bar_item->icon.shadow.offset.x, 0)
                 : 0)
-             + (bar_item->icon.background.shadow.enabled
-                ? max(-bar_item->icon.background.shadow.offset.x, 0)
+             + (bar_item->icon.background.style->shadow.enabled
+                ? max(-bar_item->icon.background.style->shadow.offset.x, 0)
                 : 0)
-             + (bar_item->label.background.shadow.enabled
-                ? max(-bar_item->label.background.shadow.offset.x, 0)
+             + (bar_item->label.background.style->shadow.enabled
+                ? max(-bar_item->label.background.style->shadow.offset.x, 0)
                 : 0)
              + (bar_item->label.shadow.enabled
                 ? max(-bar_item->label.shadow.offset.x, 0)
                 : 0));
 
-  offset.y = (int)((bar_item->background.shadow.enabled
-                 ? max(bar_item->background.shadow.offset.x,0)
+  offset.y = (int)((bar_item->background.style->shadow.enabled
+                 ? max(bar_item->background.style->shadow.offset.x,0)
                  : 0)
               + (bar_item->icon.shadow.enabled
                  ? max(bar_item->icon.shadow.offset.x, 0)
                  : 0)
-              + (bar_item->icon.background.shadow.enabled
-                 ? max(bar_item->icon.background.shadow.offset.x, 0)
+              + (bar_item->icon.background.style->shadow.enabled
+                 ? max(bar_item->icon.background.style->shadow.offset.x, 0)
                  : 0)
-              + (bar_item->label.background.shadow.enabled
-                 ? max(bar_item->label.background.shadow.offset.x, 0)
+              + (bar_item->label.background.style->shadow.enabled
+                 ? max(bar_item->label.background.style->shadow.offset.x, 0)
                  : 0)
               + (bar_item->label.shadow.enabled
                  ? max(bar_item->label.shadow.offset.x, 0)
@@ -662,9 +672,9 @@ uint32_t bar_item_calculate_bounds(struct bar_item* bar_item, uint32_t bar_heigh
   if (bar_item->has_graph) {
     uint32_t height = bar_item->background.enabled
                       ? (bar_item->background.bounds.size.height
-                         - bar_item->background.border_width - 1)
+                         - bar_item->background.style->border_width - 1)
                       : (bar_height
-                         - (g_bar_manager.background.border_width + 1));
+                         - (g_bar_manager.background.style->border_width + 1));
 
     graph_calculate_bounds(&bar_item->graph,
                            sandwich_position,
@@ -676,7 +686,7 @@ uint32_t bar_item_calculate_bounds(struct bar_item* bar_item, uint32_t bar_heigh
     uint32_t height = bar_item->background.overrides_height
                       ? bar_item->background.bounds.size.height
                       : (bar_height
-                         - (g_bar_manager.background.border_width + 1));
+                         - (g_bar_manager.background.style->border_width + 1));
 
     background_calculate_bounds(&bar_item->background,
                                 x,
@@ -710,14 +720,13 @@ void bar_item_clip_bar(struct bar_item* bar_item, int offset, struct bar* bar) {
   background_clip_bar(&bar_item->label.background, offset, bar);
 }
 
-void* draw_item_proc(void* context) {
-  struct { struct window* window; struct bar_item bar_item; }* info = context;
-  CGContextClearRect(info->window->context, info->window->frame);
-  bar_item_draw(&info->bar_item, info->window->context);
-  CGContextFlush(info->window->context);
-  window_flush(info->window);
-  free(context);
-  return NULL;
+RENDER_FUNCTION(draw_item_proc) {
+  TRACE_BEGIN(draw_item_proc);
+  CGContextClearRect(window->context, window->frame);
+  bar_item_draw(bar_item, window->context);
+  CGContextFlush(window->context);
+  window_flush(window);
+  TRACE_END(draw_item_proc);
 }
 
 void bar_item_draw(struct bar_item* bar_item, CGContextRef context) {
@@ -753,6 +762,7 @@ static void bar_item_clear_pointers(struct bar_item* bar_item) {
   background_clear_pointers(&bar_item->background);
   slider_clear_pointers(&bar_item->slider);
   popup_clear_pointers(&bar_item->popup);
+  graph_clear_pointers(&bar_item->graph);
   bar_item->popup.host = bar_item;
 }
 
@@ -760,35 +770,55 @@ void bar_item_inherit_from_item(struct bar_item* bar_item, struct bar_item* ance
   text_destroy(&bar_item->icon);
   text_destroy(&bar_item->label);
   text_destroy(&bar_item->slider.knob);
+  background_destroy(&bar_item->background);
+  background_destroy(&bar_item->slider.background);
+  background_destroy(&bar_item->slider.foreground);
+  background_destroy(&bar_item->popup.background);
   
   char* name = bar_item->name;
   char* script = bar_item->script;
   char* click_script = bar_item->click_script;
+  uint64_t reload_generation = bar_item->reload_generation;
+  item_handle handle = bar_item->handle;
+  uint64_t change_seq = bar_item->change_seq;
+  uint64_t config_hash = bar_item->config_hash;
+  struct item_stage* stage = bar_item->stage;
+  bool needs_update = bar_item->needs_update;
+  bool in_dirty_set = bar_item->in_dirty_set;
 
   memcpy(bar_item, ancestor, sizeof(struct bar_item));
   bar_item_clear_pointers(bar_item);
+  // The update state belongs to the item, not to the ancestor
+  bar_item->needs_update = needs_update;
+  bar_item->in_dirty_set = in_dirty_set;
 
   bar_item->name = name;
   bar_item->script = script;
   bar_item->click_script = click_script;
+  bar_item->reload_generation = reload_generation;
+  bar_item->handle = handle;
+  bar_item->change_seq = change_seq;
+  bar_item->config_hash = config_hash;
+  bar_item->stage = stage;
 
   text_copy(&bar_item->icon, &ancestor->icon);
   text_copy(&bar_item->label, &ancestor->label);
   text_copy(&bar_item->slider.knob, &ancestor->slider.knob);
+  graph_copy(&bar_item->graph, &ancestor->graph);
 
   if (ancestor->script)
     bar_item_set_script(bar_item, string_copy(ancestor->script));
   if (ancestor->click_script)
     bar_item_set_click_script(bar_item, string_copy(ancestor->click_script));
 
-  image_copy(&bar_item->background.image,
-             ancestor->background.image.image_ref);
-
-  image_copy(&bar_item->icon.background.image,
-             ancestor->icon.background.image.image_ref);
-
-  image_copy(&bar_item->label.background.image,
-             ancestor->label.background.image.image_ref);
+  background_copy(&bar_item->background, &ancestor->background);
+  background_copy(&bar_item->icon.background, &ancestor->icon.background);
+  background_copy(&bar_item->label.background, &ancestor->label.background);
+  background_copy(&bar_item->slider.knob.background,
+                  &ancestor->slider.knob.background);
+  background_copy(&bar_item->slider.background, &ancestor->slider.background);
+  background_copy(&bar_item->slider.foreground, &ancestor->slider.foreground);
+  background_copy(&bar_item->popup.background, &ancestor->popup.background);
 
   if (bar_item->type == BAR_COMPONENT_SPACE) {
     env_vars_set(&bar_item->signal_args.env_vars,
@@ -806,7 +836,47 @@ void bar_item_inherit_from_item(struct bar_item* bar_item, struct bar_item* ance
   }
 }
 
-void bar_item_destroy(struct bar_item* bar_item, bool free_memory) {
+// Resets all properties to those of the ancestor while the windows and the
+// popup members of the item survive, such that a config reload can reuse
+// the item without recreating its windows.
+void bar_item_reset(struct bar_item* bar_item, struct bar_item* ancestor) {
+  char* name = bar_item->name;
+  struct window** windows = bar_item->windows;
+  uint32_t num_windows = bar_item->num_windows;
+  item_handle* popup_items = bar_item->popup.items;
+  uint32_t popup_item_count = bar_item->popup.num_items;
+  bool needs_update = bar_item->needs_update;
+  bool in_dirty_set = bar_item->in_dirty_set;
+  uint64_t config_hash = bar_item->config_hash;
+  struct item_stage* stage = bar_item->stage;
+
+  struct bar_item* parent = bar_item_get_parent(bar_item);
+  if (parent) popup_remove_item(&parent->popup, bar_item);
+
+  bar_item->name = NULL;
+  bar_item->stage = NULL;
+  bar_item->windows = NULL;
+  bar_item->num_windows = 0;
+  bar_item->popup.items = NULL;
+  bar_item->popup.num_items = 0;
+  bar_item_destroy(bar_item);
+
+  bar_item_init(bar_item, ancestor);
+  bar_item->windows = windows;
+  bar_item->num_windows = num_windows;
+  bar_item->popup.items = popup_items;
+  bar_item->popup.num_items = popup_item_count;
+  bar_item->popup.needs_ordering = true;
+  bar_item_set_name(bar_item, name);
+
+  bar_item->needs_update = needs_update;
+  bar_item->in_dirty_set = in_dirty_set;
+  bar_item->config_hash = config_hash;
+  bar_item->stage = stage;
+  bar_item_needs_update(bar_item);
+}
+
+void bar_item_destroy(struct bar_item* bar_item) {
   if (bar_item->name) free(bar_item->name);
   if (bar_item->script) free(bar_item->script);
   if (bar_item->click_script) free(bar_item->click_script);
@@ -827,65 +897,40 @@ void bar_item_destroy(struct bar_item* bar_item, bool free_memory) {
   popup_destroy(&bar_item->popup);
   background_destroy(&bar_item->background);
 
+  if (bar_item->stage) item_stage_destroy(bar_item->stage);
+  bar_item->stage = NULL;
+
   for (int j = 1; j <= bar_item->num_windows; j++) {
     bar_item_remove_window(bar_item, j);
   }
   if (bar_item->windows) free(bar_item->windows);
-
-  if (free_memory) free(bar_item);
 }
 
-void bar_item_serialize(struct bar_item* bar_item, FILE* rsp) {
-  char type[32] = { 0 };
+const char* bar_item_type_name(struct bar_item* bar_item) {
   switch (bar_item->type) {
-    case BAR_ITEM:
-      snprintf(type, 32, "item");
-      break;
-    case BAR_COMPONENT_ALIAS:
-      snprintf(type, 32, "alias");
-      break;
-    case BAR_COMPONENT_GROUP:
-      snprintf(type, 32, "bracket");
-      break;
-    case BAR_COMPONENT_SLIDER:
-      snprintf(type, 32, "slider");
-      break;
-    case BAR_COMPONENT_GRAPH:
-      snprintf(type, 32, "graph");
-      break;
-    case BAR_COMPONENT_SPACE:
-      snprintf(type, 32, "space");
-      break;
-    default:
-      snprintf(type, 32, "invalid");
-      break;
+    case BAR_ITEM: return "item";
+    case BAR_COMPONENT_ALIAS: return "alias";
+    case BAR_COMPONENT_GROUP: return "bracket";
+    case BAR_COMPONENT_SLIDER: return "slider";
+    case BAR_COMPONENT_GRAPH: return "graph";
+    case BAR_COMPONENT_SPACE: return "space";
+    default: return "invalid";
   }
+}
 
-  char position[32] = { 0 };
+const char* bar_item_position_name(struct bar_item* bar_item) {
   switch (bar_item->position) {
-    case POSITION_LEFT:
-      snprintf(position, 32, "left");
-      break;
-    case POSITION_RIGHT:
-      snprintf(position, 32, "right");
-      break;
-    case POSITION_CENTER:
-      snprintf(position, 32, "center");
-      break;
-    case POSITION_CENTER_LEFT:
-      snprintf(position, 32, "q");
-      break;
-    case POSITION_CENTER_RIGHT:
-      snprintf(position, 32, "e");
-      break;
-    case POSITION_POPUP:
-      snprintf(position, 32, "popup");
-      break;
-    default:
-      snprintf(position, 32, "invalid");
-      break;
+    case POSITION_LEFT: return "left";
+    case POSITION_RIGHT: return "right";
+    case POSITION_CENTER: return "center";
+    case POSITION_CENTER_LEFT: return "q";
+    case POSITION_CENTER_RIGHT: return "e";
+    case POSITION_POPUP: return "popup";
+    default: return "invalid";
   }
+}
 
+void bar_item_serialize(struct bar_item* bar_item, FILE* rsp) {
   fprintf(rsp, "{\n"
                "\t\"name\": \"%s\",\n"
                "\t\"type\": \"%s\",\n"
@@ -902,15 +947,15 @@ void bar_item_serialize(struct bar_item* bar_item, FILE* rsp) {
                "\t\t\"width\": %d,\n"
                "\t\t\"background\": {\n",
                bar_item->name,
-               type,
+               bar_item_type_name(bar_item),
                format_bool(bar_item->drawing),
-               position,
+               bar_item_position_name(bar_item),
                bar_item->associated_space,
                bar_item->associated_display,
                format_bool(bar_item->ignore_association),
                bar_item->y_offset,
-               bar_item->background.padding_left,
-               bar_item->background.padding_right,
+               bar_item->background.style->padding_left,
+               bar_item->background.style->padding_right,
                format_bool(bar_item->scroll_texts),
                bar_item->has_const_width ? bar_item->custom_width : -1);
 
@@ -979,19 +1024,68 @@ void bar_item_serialize(struct bar_item* bar_item, FILE* rsp) {
     fprintf(rsp, ",\n\t\"slider\": {\n");
     slider_serialize(&bar_item->slider, "\t\t", rsp);
     fprintf(rsp, "\n\t}");
+  } else if (bar_item->type == BAR_COMPONENT_ALIAS) {
+    fprintf(rsp, ",\n\t\"alias\": {\n");
+    alias_serialize(&bar_item->alias, "\t\t", rsp);
+    fprintf(rsp, "\n\t}");
   }
 
   fprintf(rsp, "\n}\n");
 }
 
+static uint32_t bar_item_sub_domain_changes(struct token subdom) {
+  if (token_equals(subdom, SUB_DOMAIN_ICON)) return CHANGE_ICON;
+  else if (token_equals(subdom, SUB_DOMAIN_LABEL)) return CHANGE_LABEL;
+  else if (token_equals(subdom, SUB_DOMAIN_BACKGROUND)) return CHANGE_GEOMETRY;
+  else if (token_equals(subdom, SUB_DOMAIN_POPUP)) return CHANGE_POPUP;
+  else if (token_equals(subdom, SUB_DOMAIN_GRAPH)) return CHANGE_GRAPH;
+  else if (token_equals(subdom, SUB_DOMAIN_ALIAS)) return CHANGE_ALIAS;
+  else if (token_equals(subdom, SUB_DOMAIN_SLIDER)) return CHANGE_SLIDER;
+  return 0;
+}
+
+static uint32_t bar_item_property_changes(struct token property) {
+  if (token_equals(property, PROPERTY_ICON)) return CHANGE_ICON;
+  else if (token_equals(property, PROPERTY_LABEL)) return CHANGE_LABEL;
+  else if (token_equals(property, PROPERTY_UPDATES)
+           || token_equals(property, PROPERTY_SCRIPT)
+           || token_equals(property, PROPERTY_CLICK_SCRIPT)
+           || token_equals(property, PROPERTY_UPDATE_FREQ)
+           || token_equals(property, PROPERTY_EVENT_PORT)  ) {
+    return CHANGE_SCRIPTING;
+  }
+  else if (token_equals(property, PROPERTY_DRAWING)
+           || token_equals(property, PROPERTY_SCROLL_TEXTS)
+           || token_equals(property, PROPERTY_WIDTH)
+           || token_equals(property, PROPERTY_POSITION)
+           || token_equals(property, PROPERTY_ALIGN)
+           || token_equals(property, PROPERTY_ASSOCIATED_SPACE)
+           || token_equals(property, PROPERTY_SPACE)
+           || token_equals(property, PROPERTY_ASSOCIATED_DISPLAY)
+           || token_equals(property, PROPERTY_DISPLAY)
+           || token_equals(property, PROPERTY_YOFFSET)
+           || token_equals(property, PROPERTY_PADDING_LEFT)
+           || token_equals(property, PROPERTY_PADDING_RIGHT)
+           || token_equals(property, PROPERTY_BLUR_RADIUS)
+           || token_equals(property, PROPERTY_SHADOW)
+           || token_equals(property, PROPERTY_IGNORE_ASSOCIATION)) {
+    return CHANGE_GEOMETRY;
+  }
+  return 0;
+}
+
 void bar_item_parse_set_message(struct bar_item* bar_item, char* message, FILE* rsp) {
   bool needs_refresh = false;
   struct token property = get_token(&message);
 
+  // Every accepted property is logged, even when it is animated or did not
+  // change the item, such that clients never miss a change.
+  uint32_t changes = 0;
   struct key_value_pair key_value_pair = get_key_value_pair(property.text,'.');
   if (key_value_pair.key && key_value_pair.value) {
     struct token subdom = { key_value_pair.key, strlen(key_value_pair.key) };
     struct token entry = { key_value_pair.value, strlen(key_value_pair.value)};
+    changes = bar_item_sub_domain_changes(subdom);
     if (token_equals(subdom, SUB_DOMAIN_ICON)) {
       needs_refresh = text_parse_sub_domain(&bar_item->icon,
                                             rsp,
@@ -1088,8 +1182,8 @@ void bar_item_parse_set_message(struct bar_item* bar_item, char* message, FILE*
               bar_item,
               bar_item->custom_width,
               bar_item_get_length(bar_item, true)
-              + bar_item->background.padding_left
-              + bar_item->background.padding_right);
+              + bar_item->background.style->padding_left
+              + bar_item->background.style->padding_right);
 
       struct animation* animation = animation_create();
       animation_setup(animation,
@@ -1107,8 +1201,8 @@ void bar_item_parse_set_message(struct bar_item* bar_item, char* message, FILE*
               bar_item_get_length(bar_item, false)
               + (bar_item->has_const_width
               ? 0
-              : (bar_item->background.padding_left
-                 + bar_item->background.padding_right)),
+              : (bar_item->background.style->padding_left
+                 + bar_item->background.style->padding_right)),
               token_to_int(token)                       );
     }
   } else if (token_equals(property, PROPERTY_SCRIPT)) {
@@ -1134,7 +1228,7 @@ void bar_item_parse_set_message(struct bar_item* bar_item, char* message, FILE*
         struct bar_item* target_item = g_bar_manager.bar_items[item_index_for_name];
         popup_add_item(&target_item->popup, bar_item);
       } else {
-        bar_item->parent = NULL;
+        bar_item->parent = ITEM_HANDLE_NULL;
       }
     }
     needs_refresh = true;
@@ -1165,6 +1259,7 @@ void bar_item_parse_set_message(struct bar_item* bar_item, char* message, FILE*
              || token_equals(property, PROPERTY_DISPLAY)        ) {
     struct token token = get_token(&message);
     uint32_t prev = bar_item->associated_display;
+    bool prev_active = bar_item->associated_to_active_display;
     bar_item->associated_display = 0;
     bar_item->associated_to_active_display = false;
     uint32_t count;
@@ -1183,7 +1278,8 @@ void bar_item_parse_set_message(struct bar_item* bar_item, char* message, FILE*
       }
       free(list);
     }
-    needs_refresh = (prev != bar_item->associated_display);
+    needs_refresh = (prev != bar_item->associated_display)
+                    || (prev_active != bar_item->associated_to_active_display);
   } else if (token_equals(property, PROPERTY_YOFFSET)) {
     struct token token = get_token(&message);
     ANIMATE(bar_item_set_yoffset,
@@ -1195,14 +1291,14 @@ void bar_item_parse_set_message(struct bar_item* bar_item, char* message, FILE*
     struct token token = get_token(&message);
     ANIMATE(background_set_padding_left,
             &bar_item->background,
-            bar_item->background.padding_left,
+            bar_item->background.style->padding_left,
             token_to_int(token)               );
 
   } else if (token_equals(property, PROPERTY_PADDING_RIGHT)) {
     struct token token = get_token(&message);
     ANIMATE(background_set_padding_right,
             &bar_item->background,
-            bar_item->background.padding_right,
+            bar_item->background.style->padding_right,
             token_to_int(token)                );
 
   } else if (token_equals(property, PROPERTY_BLUR_RADIUS)) {
@@ -1236,7 +1332,11 @@ void bar_item_parse_set_message(struct bar_item* bar_item, char* message, FILE*
     respond(rsp, "[!] Item (%s): Invalid property '%s' \n", bar_item->name, property.text);
   }
 
+  if (!key_value_pair.key || !key_value_pair.value)
+    changes = bar_item_property_changes(property);
+
   if (needs_refresh) bar_item_needs_update(bar_item);
+  change_log_record(&g_bar_manager.change_log, bar_item, changes);
 }
 
 void bar_item_parse_subscribe_message(struct bar_item* bar_item, char* message, FILE* rsp) {
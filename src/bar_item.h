@@ -7,8 +7,10 @@
 #include "misc/env_vars.h"
 #include "misc/helpers.h"
 #include "popup.h"
+#include "render_pool.h"
 #include "text.h"
 #include "slider.h"
+#include "config_stage.h"
 
 #define BAR_ITEM             'i'
 #define BAR_COMPONENT_GRAPH  'g'
@@ -18,13 +20,25 @@
 #define BAR_COMPONENT_SLIDER 't'
 #define BAR_PLUGIN           'p'
 
+// Item, icon, label, knob, slider track, slider fill and popup backgrounds
+#define BAR_ITEM_BACKGROUNDS 7
+
 struct bar_item {
   char type;
   char* name;
+  item_handle handle;
 
   // Update Modifiers
   uint32_t counter;
   bool needs_update;
+  bool in_dirty_set;
+  uint64_t reload_generation;
+  uint64_t change_seq;
+
+  // Hash of the config messages that produced the current properties, zero
+  // once the item has been changed outside of a config run
+  uint64_t config_hash;
+  struct item_stage* stage;
   bool updates;
   bool updates_only_when_shown;
   bool lazy;
@@ -90,17 +104,20 @@ struct bar_item {
 
   // Popup
   struct popup popup;
-  struct bar_item* parent;
+  item_handle parent;
 
   // Mach
   mach_port_t event_port;
 };
 
-struct bar_item* bar_item_create();
 void bar_item_inherit_from_item(struct bar_item* bar_item, struct bar_item* ancestor);
 void bar_item_init(struct bar_item* bar_item, struct bar_item* default_item);
+const char* bar_item_type_name(struct bar_item* bar_item);
+const char* bar_item_position_name(struct bar_item* bar_item);
 void bar_item_serialize(struct bar_item* bar_item, FILE* rsp);
-void bar_item_destroy(struct bar_item* bar_item, bool free_memory);
+void bar_item_reset(struct bar_item* bar_item, struct bar_item* ancestor);
+void bar_item_destroy(struct bar_item* bar_item);
+struct bar_item* bar_item_get_parent(struct bar_item* bar_item);
 
 bool bar_item_is_shown(struct bar_item* bar_item);
 void bar_item_needs_update(struct bar_item* bar_item);
@@ -132,7 +149,7 @@ void bar_item_remove_window(struct bar_item* bar_item, uint32_t adid);
 
 CGPoint bar_item_calculate_shadow_offsets(struct bar_item* bar_item);
 uint32_t bar_item_calculate_bounds(struct bar_item* bar_item, uint32_t bar_height, uint32_t x, uint32_t y);
-void* draw_item_proc(void* context);
+RENDER_FUNCTION(draw_item_proc);
 void bar_item_draw(struct bar_item* bar_item, CGContextRef context);
 bool bar_item_clip_needs_update_for_bar(struct bar_item* bar_item, struct bar* bar);
 void bar_item_clip_bar(struct bar_item* bar_item, int offset, struct bar* bar);
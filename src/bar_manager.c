@@ -4,12 +4,14 @@
 #include "event.h"
 #include "misc/env_vars.h"
 #include "misc/helpers.h"
+#include "misc/hash.h"
 #include "wifi.h"
 #include "volume.h"
 #include "power.h"
 #include "mouse.h"
 #include "media.h"
 #include "app_windows.h"
+#include "startup.h"
 
 extern void forced_front_app_event();
 
@@ -18,43 +20,76 @@ static CLOCK_CALLBACK(clock_handler) {
   event_post(&event);
 }
 
-void bar_manager_init(struct bar_manager* bar_manager) {
+static void bar_manager_set_active_adid(struct bar_manager* bar_manager, uint32_t adid) {
+  if (bar_manager->active_adid == adid) return;
+  bar_manager->active_adid = adid;
+
+  for (int i = 0; i < bar_manager->bar_count; i++)
+    bar_manager->bars[i]->needs_association_check = true;
+}
+
+// The properties of the bar itself, which a config sets through --bar
+static void bar_manager_init_properties(struct bar_manager* bar_manager) {
   bar_manager->font_smoothing = false;
-  bar_manager->any_bar_hidden = false;
-  bar_manager->needs_ordering = false;
-  bar_manager->bar_needs_update = false;
-  bar_manager->bars = NULL;
-  bar_manager->bar_count = 0;
-  bar_manager->bar_items = NULL;
-  bar_manager->bar_item_count = 0;
   bar_manager->displays = DISPLAY_ALL_PATTERN;
   bar_manager->position = POSITION_TOP;
   bar_manager->shadow = false;
   bar_manager->blur_radius = 0;
   bar_manager->margin = 0;
-  bar_manager->frozen = false;
-  bar_manager->sleeps = false;
   bar_manager->window_level = kCGBackstopMenuLevel;
   bar_manager->topmost = false;
   bar_manager->notch_width = 200;
   bar_manager->notch_offset = 0;
   bar_manager->notch_display_height = 0;
-  bar_manager->active_adid = display_active_display_adid();
-  bar_manager->might_need_clipping = false;
 
   bar_manager->sticky = true;
 
   bar_manager->show_in_fullscreen = false;
 
-  image_init(&bar_manager->current_artwork);
   background_init(&bar_manager->background);
   bar_manager->background.bounds.size.height = 25;
   bar_manager->background.overrides_height = true;
-  bar_manager->background.padding_left = 20;
-  bar_manager->background.padding_right = 20;
+  background_set_padding_left(&bar_manager->background, 20);
+  background_set_padding_right(&bar_manager->background, 20);
+
+  struct background_style* style = background_style_mut(&bar_manager->background);
+  color_set_hex(&style->border_color, 0xffff0000);
+  color_set_hex(&style->color, 0x44000000);
+}
+
+void bar_manager_init(struct bar_manager* bar_manager) {
+  bar_manager->any_bar_hidden = false;
+  bar_manager->needs_ordering = false;
+  bar_manager->bar_needs_update = false;
+  bar_manager->bars = NULL;
+  bar_manager->bar_count = 0;
+  bar_manager->bar_items = NULL;
+  bar_manager->bar_item_count = 0;
+  item_store_init(&bar_manager->item_store);
+  bar_manager->reloading = false;
+  bar_manager->reload_checkpointed = false;
+  bar_manager->config_running = false;
+  bar_manager->reload_generation = 0;
+  bar_manager->replaying_item = NULL;
+  bar_manager->claimed_items = NULL;
+  bar_manager->claimed_count = 0;
+  bar_manager->claimed_capacity = 0;
+  bar_manager->config_messages = 0;
+  bar_manager->defaults_hash = CONFIG_HASH_SEED;
+  config_stage_init(&bar_manager->bar_stage, CONFIG_HASH_SEED);
+  bar_manager->bar_config_keys = NULL;
+  bar_manager->bar_config_key_count = 0;
+  bar_manager->dirty_items = NULL;
+  bar_manager->dirty_item_count = 0;
+  bar_manager->dirty_item_capacity = 0;
+  hit_index_init(&bar_manager->hit_index);
+  bar_manager->frozen = false;
+  bar_manager->sleeps = false;
+  bar_manager->active_adid = display_active_display_adid();
+  bar_manager->might_need_clipping = false;
 
-  color_set_hex(&bar_manager->background.border_color, 0xffff0000);
-  color_set_hex(&bar_manager->background.color, 0x44000000);
+  image_init(&bar_manager->current_artwork);
+  bar_manager_init_properties(bar_manager);
 
   bar_item_init(&bar_manager->default_item, NULL);
   bar_item_set_name(&bar_manager->default_item, string_copy("defaults"));
@@ -62,6 +97,9 @@ void bar_manager_init(struct bar_manager* bar_manager) {
 
   animator_init(&bar_manager->animator);
   rotator_manager_init(&bar_manager->rotator_manager);
+  channel_manager_init(&bar_manager->channel_manager);
+  change_log_init(&bar_manager->change_log);
+  watch_registry_init(&bar_manager->watch_registry);
 
   int shell_refresh_frequency = 1;
 
@@ -79,25 +117,98 @@ void bar_manager_init(struct bar_manager* bar_manager) {
                     kCFRunLoopCommonModes);
 }
 
+// The listed items keep the slots they currently occupy in the item list and
+// are placed into them in the given order, all other items stay in place. The
+// positions are looked up by the handle index of the items, such that the
+// reorder is a single pass over the item list.
 void bar_manager_sort(struct bar_manager* bar_manager, struct bar_item** ordering, uint32_t count) {
-  int index = 0;
-  for (int i = 0; i < bar_manager->bar_item_count; i++) {
-    for (int j = 0; j < count; j++) {
-      if (bar_manager->bar_items[i] == ordering[j]
-          && bar_manager->bar_items[i] != ordering[index]) {
-        bar_manager->bar_items[i] = ordering[index];
-        index++;
-        bar_item_needs_update(bar_manager->bar_items[i]);
+  uint32_t item_count = bar_manager->bar_item_count;
+  if (count == 0 || item_count == 0) return;
+
+  uint32_t* positions = calloc(bar_manager->item_store.capacity + 1,
+                               sizeof(uint32_t)                     );
+  bool* listed = calloc(item_count, sizeof(bool));
+  struct bar_item** sorted = malloc(sizeof(struct bar_item*) * count);
+
+  for (uint32_t i = 0; i < item_count; i++) {
+    item_handle handle = bar_manager->bar_items[i]->handle;
+    positions[handle & ITEM_HANDLE_INDEX_MASK] = i + 1;
+  }
+
+  // Unknown and repeated items are dropped from the ordering
+  uint32_t sorted_count = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (!ordering[i]) continue;
+    uint32_t position = positions[ordering[i]->handle & ITEM_HANDLE_INDEX_MASK];
+    if (!position || bar_manager->bar_items[position - 1] != ordering[i]
+        || listed[position - 1]) {
+      continue;
+    }
+    listed[position - 1] = true;
+    sorted[sorted_count++] = ordering[i];
+  }
+
+  bool changed = false;
+  uint32_t index = 0;
+  for (uint32_t i = 0; i < item_count && index < sorted_count; i++) {
+    if (!listed[i]) continue;
+    struct bar_item* bar_item = sorted[index++];
+    if (bar_manager->bar_items[i] == bar_item) continue;
+
+    bar_manager->bar_items[i] = bar_item;
+    bar_item_needs_update(bar_item);
+    changed = true;
+  }
+
+  free(sorted);
+  free(listed);
+  free(positions);
+
+  if (changed) {
+    bar_manager->needs_ordering = true;
+    g_window_generation++;
+    change_log_record(&bar_manager->change_log, NULL, CHANGE_ORDER);
+  }
+}
+
+// Resolves all names with a single pass over the item list, unknown names
+// resolve to NULL.
+void bar_manager_get_items_for_names(struct bar_manager* bar_manager, char** names, uint32_t count, struct bar_item** items) {
+  if (count == 0) return;
+  memset(items, 0, sizeof(struct bar_item*) * count);
+  if (bar_manager->bar_item_count == 0) return;
+
+  uint32_t size = 1;
+  while (size < 2 * bar_manager->bar_item_count) size <<= 1;
+  uint32_t* table = calloc(size, sizeof(uint32_t));
+
+  for (uint32_t i = 0; i < bar_manager->bar_item_count; i++) {
+    char* name = bar_manager->bar_items[i]->name;
+    if (!name) continue;
+    uint32_t slot = hash_xxh64(name, strlen(name), 0) & (size - 1);
+    while (table[slot]) {
+      // The first item of a name wins, as for the linear lookup
+      if (string_equals(bar_manager->bar_items[table[slot] - 1]->name, name))
         break;
-      }
-      else if (bar_manager->bar_items[i] == ordering[j]
-               && bar_manager->bar_items[i] == ordering[index]) {
-        index++;
+      slot = (slot + 1) & (size - 1);
+    }
+    if (!table[slot]) table[slot] = i + 1;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (!names[i]) continue;
+    uint32_t slot = hash_xxh64(names[i], strlen(names[i]), 0) & (size - 1);
+    while (table[slot]) {
+      struct bar_item* bar_item = bar_manager->bar_items[table[slot] - 1];
+      if (string_equals(bar_item->name, names[i])) {
+        items[i] = bar_item;
         break;
       }
+      slot = (slot + 1) & (size - 1);
     }
   }
-  bar_manager->needs_ordering = true;
+
+  free(table);
 }
 
 int bar_manager_get_item_index_for_name(struct bar_manager* bar_manager, char* name) {
@@ -109,6 +220,10 @@ int bar_manager_get_item_index_for_name(struct bar_manager* bar_manager, char* n
   return -1;
 }
 
+struct bar_item* bar_manager_get_item(struct bar_manager* bar_manager, item_handle handle) {
+  return item_store_get(&bar_manager->item_store, handle);
+}
+
 int bar_manager_get_item_index_by_address(struct bar_manager* bar_manager, struct bar_item* bar_item) {
   for (int i = 0; i < bar_manager->bar_item_count; i++) {
     if (bar_manager->bar_items[i] == bar_item) {
@@ -119,44 +234,49 @@ int bar_manager_get_item_index_by_address(struct bar_manager* bar_manager, struc
 }
 
 void bar_manager_move_item(struct bar_manager* bar_manager, struct bar_item* item, struct bar_item* reference, bool before) {
-  if (bar_manager->bar_item_count <= 0) return;
-  struct bar_item* tmp[bar_manager->bar_item_count];
-  int count = 0;
-  for (int i = 0; i < bar_manager->bar_item_count; i++) {
-    if (bar_manager->bar_items[i] == item) continue;
-    if (bar_manager->bar_items[i] == reference && before) {
-      tmp[count++] = item;
-      tmp[count++] = bar_manager->bar_items[i];
-      continue;
-    } else if (bar_manager->bar_items[i] == reference && !before) {
-      tmp[count++] = bar_manager->bar_items[i];
-      tmp[count++] = item;
-      continue;
-    }
-    tmp[count++] = bar_manager->bar_items[i];
+  if (bar_manager->bar_item_count <= 0 || item == reference) return;
+  bar_manager_apply_claimed_order(bar_manager);
+  int from = bar_manager_get_item_index_by_address(bar_manager, item);
+  int to = bar_manager_get_item_index_by_address(bar_manager, reference);
+  if (from < 0 || to < 0) return;
+
+  // The target index once the item has been taken out of the list
+  if (to > from) to--;
+  if (!before) to++;
+  if (to == from) return;
+
+  struct bar_item** items = bar_manager->bar_items;
+  if (to < from) {
+    memmove(items + to + 1, items + to, sizeof(struct bar_item*)*(from - to));
+  } else {
+    memmove(items + from, items + from + 1, sizeof(struct bar_item*)*(to - from));
   }
-  bar_manager->bar_items = realloc(
-                        bar_manager->bar_items,
-                        sizeof(struct bar_item*)*bar_manager->bar_item_count);
-
-  memcpy(bar_manager->bar_items,
-         tmp,
-         sizeof(struct bar_item*)*bar_manager->bar_item_count);
+  items[to] = item;
+  bar_item_needs_update(item);
 
   bar_manager->needs_ordering = true;
+  g_window_generation++;
+  change_log_record(&bar_manager->change_log, NULL, CHANGE_ORDER);
 }
 
 void bar_manager_remove_item(struct bar_manager* bar_manager, struct bar_item* bar_item) {
   if (bar_manager->bar_item_count <= 0 || !bar_item
-      || bar_manager_get_item_index_by_address(bar_manager, bar_item) < 0) {
+      || bar_manager_get_item(bar_manager, bar_item->handle) != bar_item) {
     return;
   }
 
-  if (bar_item->position == POSITION_POPUP) {
-    for (int i = 0; i < bar_manager->bar_item_count; i++) {
-      popup_remove_item(&bar_manager->bar_items[i]->popup, bar_item);
-    }
+  struct bar_item* parent = bar_item_get_parent(bar_item);
+  if (parent) popup_remove_item(&parent->popup, bar_item);
+
+  g_window_generation++;
+
+  uint32_t dirty_count = 0;
+  for (int i = 0; i < bar_manager->dirty_item_count; i++) {
+    if (bar_manager->dirty_items[i] == bar_item) continue;
+    bar_manager->dirty_items[dirty_count++] = bar_manager->dirty_items[i];
   }
+  bar_manager->dirty_item_count = dirty_count;
+  bar_item->in_dirty_set = false;
   if (bar_manager->bar_item_count == 1) {
     free(bar_manager->bar_items);
     bar_manager->bar_items = NULL;
@@ -178,7 +298,10 @@ void bar_manager_remove_item(struct bar_manager* bar_manager, struct bar_item* b
            sizeof(struct bar_item*)*bar_manager->bar_item_count);
   }
 
-  bar_item_destroy(bar_item, true);
+  change_log_record_removal(&bar_manager->change_log, bar_item);
+  item_handle handle = bar_item->handle;
+  bar_item_destroy(bar_item);
+  item_store_release(&bar_manager->item_store, handle);
 }
 
 bool bar_manager_set_margin(struct bar_manager* bar_manager, int margin) {
@@ -189,8 +312,8 @@ bool bar_manager_set_margin(struct bar_manager* bar_manager, int margin) {
 }
 
 bool bar_manager_set_y_offset(struct bar_manager* bar_manager, int y_offset) {
-  if (bar_manager->background.y_offset == y_offset) return false;
-  bar_manager->background.y_offset = y_offset;
+  if (bar_manager->background.style->y_offset == y_offset) return false;
+  background_style_mut(&bar_manager->background)->y_offset = y_offset;
   bar_manager->bar_needs_resize = true;
   return true;
 }
@@ -323,97 +446,116 @@ void bar_manager_unfreeze(struct bar_manager *bar_manager) {
   bar_manager->frozen = false;
 }
 
-uint32_t bar_manager_length_for_bar_side(struct bar_manager* bar_manager, struct bar* bar, char side) {
-  uint32_t total_length = 0;
-  for (int i = 0; i < bar_manager->bar_item_count; i++) {
-    struct bar_item* bar_item = bar_manager->bar_items[i];
-    if (bar_item->position == side
-        && bar_item->type != BAR_COMPONENT_GROUP
-        && bar_draws_item(bar, bar_item)        ) {
-      int item_length = (bar_manager->position == POSITION_LEFT
-                         || bar_manager->position == POSITION_RIGHT)
-                        ? bar_item_get_height(bar_item)
-                        : bar_item_get_length(bar_item, false);
-
-      total_length += item_length + (bar_item->has_const_width
-                                     ? 0
-                                     : bar_item->background.padding_left
-                                       + bar_item->background.padding_right);
-    }
-  }
-  return total_length;
-}
+static bool bar_manager_item_needs_redraw(struct bar_manager* bar_manager, struct bar* bar, struct bar_item* bar_item) {
+  uint32_t bar_mask = 1 << bar->adid;
+  bool draws_item = bar_draws_item(bar, bar_item);
 
-bool bar_manager_bar_needs_redraw(struct bar_manager* bar_manager, struct bar* bar) {
-  if (bar_manager->bar_needs_update) return true;
+  bool regular_update = bar_item->needs_update
+                        && draws_item;
 
-  uint32_t bar_mask = 1 << bar->adid;
-  for (int i = 0; i < bar_manager->bar_item_count; i++) {
-    struct bar_item* bar_item = bar_manager->bar_items[i];
-    bool draws_item = bar_draws_item(bar, bar_item);
+  if (regular_update) return true;
 
-    bool regular_update = bar_item->needs_update
-                          && draws_item;
+  bool disabled_item_drawn_on_bar = !bar_item->drawing
+                                    && (bar_item->associated_bar != 0);
 
-    if (regular_update) return true;
+  if (disabled_item_drawn_on_bar) return true;
 
-    bool disabled_item_drawn_on_bar = !bar_item->drawing
-                                      && (bar_item->associated_bar != 0);
+  if (bar_item->ignore_association) return false;
 
-    if (disabled_item_drawn_on_bar) return true;
+  bool not_drawn_on_associated_display =
+    (draws_item
+     && (bar_item->associated_display > 0)
+     && (bar_item->associated_display & bar_mask)
+     && !(((bar_item->associated_bar << 1) & bar_mask)))
+    || (draws_item
+        && bar_item->associated_to_active_display
+        && bar_manager->active_adid == bar->adid
+        && !((bar_item->associated_bar << 1) & bar_mask));
 
-    if (bar_item->ignore_association) continue;
+  if (not_drawn_on_associated_display) return true;
 
-    bool not_drawn_on_associated_display =
-      (draws_item
-       && (bar_item->associated_display > 0)
-       && (bar_item->associated_display & bar_mask)
-       && !(((bar_item->associated_bar << 1) & bar_mask)))
-      || (draws_item
-          && bar_item->associated_to_active_display
-          && bar_manager->active_adid == bar->adid
-          && !((bar_item->associated_bar << 1) & bar_mask));
+  bool drawn_on_non_associated_display =
+    (!bar_item->associated_to_active_display
+     && (bar_item->associated_display > 0)
+     && !(bar_item->associated_display & bar_mask)
+     && (((bar_item->associated_bar << 1) & bar_mask)))
+    || (bar_item->drawing
+     && bar_item->associated_to_active_display
+     && (((bar_item->associated_bar << 1) & bar_mask))
+     && (bar->adid != bar_manager->active_adid));
 
-    if (not_drawn_on_associated_display) return true;
+  if (drawn_on_non_associated_display) return true;
 
-    bool drawn_on_non_associated_display =
-      (!bar_item->associated_to_active_display
-       && (bar_item->associated_display > 0)
-       && !(bar_item->associated_display & bar_mask)
-       && (((bar_item->associated_bar << 1) & bar_mask)))
-      || (bar_item->drawing
-       && bar_item->associated_to_active_display
-       && (((bar_item->associated_bar << 1) & bar_mask))
-       && (bar->adid != bar_manager->active_adid));
+  if (bar_item->type == BAR_COMPONENT_SPACE) return false;
 
-    if (drawn_on_non_associated_display) return true;
+  bool drawn_on_non_associated_space = bar_item->associated_space > 0
+                                       && !(bar_item->associated_space
+                                            & (1 << bar->sid))
+                                       && ((bar_item->associated_bar << 1)
+                                           & bar_mask);
 
-    if (bar_item->type == BAR_COMPONENT_SPACE) continue;
+  if (drawn_on_non_associated_space) return true;
 
-    bool drawn_on_non_associated_space = bar_item->associated_space > 0
-                                         && !(bar_item->associated_space
-                                              & (1 << bar->sid))
-                                         && ((bar_item->associated_bar << 1)
-                                             & bar_mask);
+  bool not_drawn_on_associated_space = draws_item
+                                       && bar_item->associated_space > 0
+                                       && (bar_item->associated_space
+                                           & (1 << bar->sid))
+                                       && !((bar_item->associated_bar << 1)
+                                            & bar_mask);
 
-    if (drawn_on_non_associated_space) return true;
+  return not_drawn_on_associated_space;
+}
 
-    bool not_drawn_on_associated_space = draws_item
-                                         && bar_item->associated_space > 0
-                                         && (bar_item->associated_space
-                                             & (1 << bar->sid))
-                                         && !((bar_item->associated_bar << 1)
-                                              & bar_mask);
+bool bar_manager_bar_needs_redraw(struct bar_manager* bar_manager, struct bar* bar) {
+  if (bar_manager->bar_needs_update) return true;
 
-    if (not_drawn_on_associated_space) return true;
+  // Only items in the dirty set can change the drawing state of a bar,
+  // unless the bar itself changed in a way that affects all associations.
+  if (bar->needs_association_check) {
+    for (int i = 0; i < bar_manager->bar_item_count; i++) {
+      if (bar_manager_item_needs_redraw(bar_manager,
+                                        bar,
+                                        bar_manager->bar_items[i])) {
+        return true;
+      }
+    }
+    return false;
+  }
 
+  for (int i = 0; i < bar_manager->dirty_item_count; i++) {
+    if (bar_manager_item_needs_redraw(bar_manager,
+                                      bar,
+                                      bar_manager->dirty_items[i])) {
+      return true;
+    }
   }
   return false;
 }
 
+void bar_manager_mark_dirty(struct bar_manager* bar_manager, struct bar_item* bar_item) {
+  if (bar_item->in_dirty_set) return;
+  bar_item->in_dirty_set = true;
+
+  if (bar_manager->dirty_item_count >= bar_manager->dirty_item_capacity) {
+    bar_manager->dirty_item_capacity = max(2*bar_manager->dirty_item_capacity,
+                                           32                              );
+    bar_manager->dirty_items = realloc(bar_manager->dirty_items,
+                                       sizeof(struct bar_item*)
+                                       * bar_manager->dirty_item_capacity);
+  }
+
+  bar_manager->dirty_items[bar_manager->dirty_item_count++] = bar_item;
+}
+
 void bar_manager_clear_needs_update(struct bar_manager* bar_manager) {
-  for (int i = 0; i < bar_manager->bar_item_count; i++)
-    bar_manager->bar_items[i]->needs_update = false;
+  for (int i = 0; i < bar_manager->dirty_item_count; i++) {
+    bar_manager->dirty_items[i]->needs_update = false;
+    bar_manager->dirty_items[i]->in_dirty_set = false;
+  }
+  bar_manager->dirty_item_count = 0;
+
+  for (int i = 0; i < bar_manager->bar_count; i++)
+    bar_manager->bars[i]->needs_association_check = false;
 
   bar_manager->needs_ordering = false;
   bar_manager->bar_needs_update = false;
@@ -424,8 +566,28 @@ void bar_manager_reset_bar_association(struct bar_manager* bar_manager) {
     bar_item_reset_associated_bar(bar_manager->bar_items[i]);
 }
 
+bool bar_manager_bars_share_layout(struct bar_manager* bar_manager) {
+  // The item bounds only depend on the bar thickness, which is shared by all
+  // vertical bars and differs for horizontal bars only on notched displays.
+  if (bar_manager->position == POSITION_LEFT
+      || bar_manager->position == POSITION_RIGHT) {
+    return true;
+  }
+
+  for (int i = 1; i < bar_manager->bar_count; i++) {
+    if (bar_manager->bars[i]->window.frame.size.height
+        != bar_manager->bars[0]->window.frame.size.height) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void bar_manager_refresh(struct bar_manager* bar_manager, bool forced, bool threaded) {
-  if (bar_manager->frozen) return;
+  if (bar_manager->frozen
+      || (bar_manager->reloading && !bar_manager->reload_checkpointed)) {
+    return;
+  }
   if (forced) {
     bar_manager_reset_bar_association(bar_manager);
     for (int j = 0; j < bar_manager->bar_item_count; j++) {
@@ -435,19 +597,44 @@ void bar_manager_refresh(struct bar_manager* bar_manager, bool forced, bool thre
 
   if (forced || bar_manager->bar_needs_resize) bar_manager_resize(bar_manager);
 
+  // When all bars lay out their items identically, the layout of every bar
+  // is done up front and the draws of all displays overlap on the render
+  // workers, followed by a single join.
+  bool parallel = threaded
+                  && bar_manager->bar_count > 1
+                  && bar_manager_bars_share_layout(bar_manager);
+
+  if (parallel) {
+    bool any_redraw = forced;
+    for (int i = 0; i < bar_manager->bar_count && !any_redraw; ++i) {
+      any_redraw = bar_manager_bar_needs_redraw(bar_manager,
+                                                bar_manager->bars[i]);
+    }
+
+    if (!any_redraw) parallel = false;
+    else {
+      for (int i = 0; i < bar_manager->bar_count; ++i)
+        bar_calculate_bounds(bar_manager->bars[i]);
+    }
+  }
+
   for (int i = 0; i < bar_manager->bar_count; ++i) {
     if (forced
         || bar_manager_bar_needs_redraw(bar_manager, bar_manager->bars[i])) {
-      bar_calculate_bounds(bar_manager->bars[i]);
+      if (!parallel) bar_calculate_bounds(bar_manager->bars[i]);
       bar_draw(bar_manager->bars[i], false, threaded);
       if (bar_manager->needs_ordering) {
         bar_order_item_windows(bar_manager->bars[i]);
       }
+
+      // The render workers draw the live items, so they have to finish
+      // before the next bar recalculates the item bounds.
+      if (threaded && !parallel) join_render_threads();
     }
   }
 
   bar_manager_clear_needs_update(bar_manager);
-  if (threaded) join_render_threads();
+  if (parallel) join_render_threads();
 }
 
 void bar_manager_resize(struct bar_manager* bar_manager) {
@@ -457,19 +644,242 @@ void bar_manager_resize(struct bar_manager* bar_manager) {
   bar_manager->bar_needs_resize = false;
 }
 
+// Items claimed or created by a reload are only recorded in order, the item
+// list is sorted once into that order instead of moving every item on claim.
+static void bar_manager_claim_position(struct bar_manager* bar_manager, struct bar_item* bar_item) {
+  if (bar_manager->claimed_count == bar_manager->claimed_capacity) {
+    bar_manager->claimed_capacity = bar_manager->claimed_capacity
+                                    ? 2 * bar_manager->claimed_capacity
+                                    : 64;
+    bar_manager->claimed_items = realloc(bar_manager->claimed_items,
+                                         sizeof(item_handle)
+                                         * bar_manager->claimed_capacity);
+  }
+  bar_manager->claimed_items[bar_manager->claimed_count++] = bar_item->handle;
+}
+
+// Sorts the claimed items into the order of their claims, in the positions
+// the claimed items occupy. Has to happen before anything else reorders the
+// items during a reload, e.g. a --move sent by the config.
+void bar_manager_apply_claimed_order(struct bar_manager* bar_manager) {
+  uint32_t count = bar_manager->claimed_count;
+  if (count == 0) return;
+
+  struct bar_item** ordering = malloc(sizeof(struct bar_item*) * count);
+  for (uint32_t i = 0; i < count; i++) {
+    ordering[i] = bar_manager_get_item(bar_manager,
+                                       bar_manager->claimed_items[i]);
+  }
+  bar_manager->claimed_count = 0;
+
+  bar_manager_sort(bar_manager, ordering, count);
+  free(ordering);
+}
+
 struct bar_item* bar_manager_create_item(struct bar_manager* bar_manager) {
   bar_manager->bar_items = (struct bar_item**) realloc(
                  bar_manager->bar_items,
                  sizeof(struct bar_item*) * (bar_manager->bar_item_count + 1));
 
   bar_manager->bar_item_count += 1;
-  struct bar_item* bar_item = bar_item_create();
+  item_handle handle;
+  struct bar_item* bar_item = item_store_acquire(&bar_manager->item_store,
+                                                 &handle                  );
+  bar_item->handle = handle;
   bar_item_init(bar_item, &bar_manager->default_item);
+  bar_item->reload_generation = bar_manager->reload_generation;
+  bar_item->config_hash = bar_manager->defaults_hash;
+  bar_item_needs_update(bar_item);
   bar_manager->bar_items[bar_manager->bar_item_count - 1] = bar_item;
   bar_manager->needs_ordering = true;
+  change_log_record(&bar_manager->change_log, bar_item, CHANGE_ITEM);
+  change_log_record(&bar_manager->change_log, NULL, CHANGE_ORDER);
+  if (bar_manager->reloading) bar_manager_claim_position(bar_manager, bar_item);
   return bar_item;
 }
 
+// An item left over from the previous config run is claimed by the current
+// run: it takes the position in the claimed order where a newly created item
+// would have been placed, and the messages the run sends to it are staged
+// until the reload commits.
+bool bar_manager_reconcile_item(struct bar_manager* bar_manager, struct bar_item* bar_item, struct bar_item* ancestor, uint64_t seed) {
+  if (bar_item == bar_manager->replaying_item) return true;
+  if (!bar_manager->reloading
+      || bar_item->reload_generation == bar_manager->reload_generation) {
+    return false;
+  }
+
+  bar_item->reload_generation = bar_manager->reload_generation;
+  if (bar_item->stage) item_stage_destroy(bar_item->stage);
+  bar_item->stage = item_stage_create(ancestor, seed);
+  bar_manager_claim_position(bar_manager, bar_item);
+  return true;
+}
+
+// Records a message that configures the item and returns whether it is to be
+// applied right away. Messages for a staged item are held back, all others
+// extend the config hash of the item while a config runs and invalidate it
+// otherwise.
+bool bar_manager_record_config(struct bar_manager* bar_manager, struct bar_item* bar_item, char* domain, char* name, char* tokens, uint32_t length) {
+  if (bar_item == bar_manager->replaying_item) return true;
+  if (bar_manager->config_running) bar_manager->config_messages++;
+  if (bar_item->stage) {
+    config_stage_append(&bar_item->stage->config, domain, name, tokens, length);
+    return false;
+  }
+
+  bar_item->config_hash = bar_manager->config_running
+                          ? config_hash_append(bar_item->config_hash,
+                                               domain,
+                                               name,
+                                               tokens,
+                                               length                )
+                          : 0;
+  return true;
+}
+
+// Bar properties are applied right away, the run only remembers them such
+// that properties the previous run set and this one did not can be reset.
+void bar_manager_record_bar_config(struct bar_manager* bar_manager, char* token, uint32_t length) {
+  if (!bar_manager->config_running) return;
+  bar_manager->config_messages++;
+  config_stage_append(&bar_manager->bar_stage, DOMAIN_BAR, NULL, token, length);
+}
+
+// Applies the staged messages of the item, unless they reproduce the
+// configuration it already has, in which case the item stays untouched.
+void bar_manager_commit_stage(struct bar_manager* bar_manager, struct bar_item* bar_item) {
+  struct item_stage* stage = bar_item->stage;
+  if (!stage || bar_item == bar_manager->replaying_item) return;
+  bar_item->stage = NULL;
+
+  if (stage->config.hash != bar_item->config_hash) {
+    item_handle handle = bar_item->handle;
+    bar_item_reset(bar_item, stage->ancestor);
+
+    struct bar_item* replaying_item = bar_manager->replaying_item;
+    bar_manager->replaying_item = bar_item;
+    config_stage_replay(&stage->config);
+    bar_manager->replaying_item = replaying_item;
+
+    // The replay removes the item again if its messages are invalid
+    if (bar_manager_get_item(bar_manager, handle) == bar_item) {
+      bar_item->config_hash = stage->config.hash;
+      g_window_generation++;
+      change_log_record(&bar_manager->change_log, bar_item, CHANGE_ITEM);
+    }
+  }
+  item_stage_destroy(stage);
+}
+
+// Resets the bar properties if the previous run set some that this run did
+// not set, and applies the properties of this run again on top.
+static bool bar_manager_commit_bar_config(struct bar_manager* bar_manager) {
+  uint32_t count = 0;
+  char** keys = config_stage_keys(&bar_manager->bar_stage, &count);
+
+  bool dropped = false;
+  for (int i = 0; i < bar_manager->bar_config_key_count; i++) {
+    bool found = false;
+    for (int j = 0; j < count && !found; j++)
+      found = string_equals(bar_manager->bar_config_keys[i], keys[j]);
+
+    dropped |= !found;
+    free(bar_manager->bar_config_keys[i]);
+  }
+  if (bar_manager->bar_config_keys) free(bar_manager->bar_config_keys);
+  bar_manager->bar_config_keys = keys;
+  bar_manager->bar_config_key_count = count;
+
+  if (dropped) {
+    background_destroy(&bar_manager->background);
+    bar_manager_init_properties(bar_manager);
+    config_stage_replay(&bar_manager->bar_stage);
+    bar_manager_reset(bar_manager);
+  }
+  config_stage_destroy(&bar_manager->bar_stage);
+  return dropped;
+}
+
+void bar_manager_begin_config(struct bar_manager* bar_manager) {
+  bar_manager->config_running = true;
+  bar_manager->defaults_hash = CONFIG_HASH_SEED;
+  config_stage_destroy(&bar_manager->bar_stage);
+}
+
+// The live items stay untouched until the new config run has finished, the
+// items it did not claim are removed afterwards.
+void bar_manager_begin_reload(struct bar_manager* bar_manager) {
+  bar_manager->reloading = true;
+  bar_manager->reload_checkpointed = false;
+  bar_manager->reload_generation++;
+  bar_manager->claimed_count = 0;
+  bar_manager_begin_config(bar_manager);
+
+  bar_item_destroy(&bar_manager->default_item);
+  bar_item_init(&bar_manager->default_item, NULL);
+  bar_item_set_name(&bar_manager->default_item, string_copy("defaults"));
+}
+
+static void bar_manager_commit_stages(struct bar_manager* bar_manager) {
+  uint32_t count = bar_manager->bar_item_count;
+  item_handle handles[count + 1];
+  for (int i = 0; i < count; i++)
+    handles[i] = bar_manager->bar_items[i]->handle;
+
+  for (int i = 0; i < count; i++) {
+    struct bar_item* bar_item = bar_manager_get_item(bar_manager, handles[i]);
+    if (bar_item) bar_manager_commit_stage(bar_manager, bar_item);
+  }
+}
+
+// A config which is still running but has gone quiet, e.g. because it ends
+// in a long lived helper, gets the items it claimed so far committed and
+// drawn. Unclaimed items stay until the config process has exited, the run
+// goes on claiming and staging items.
+void bar_manager_checkpoint_config(struct bar_manager* bar_manager) {
+  if (!bar_manager->config_running || !bar_manager->reloading) return;
+  bar_manager_apply_claimed_order(bar_manager);
+  bar_manager_commit_stages(bar_manager);
+  bar_manager->reload_checkpointed = true;
+  bar_manager_refresh(bar_manager, false, false);
+}
+
+// Ends the config run once its process has exited: the bar properties are
+// reconciled, the staged items are committed and the items the reload did
+// not claim are removed. Only the items that changed are drawn again. The
+// first commit, of the config or of a restored snapshot, draws the first
+// complete frame.
+void bar_manager_commit_config(struct bar_manager* bar_manager) {
+  if (!bar_manager->config_running) return;
+  bar_manager->config_running = false;
+  bool forced = bar_manager_commit_bar_config(bar_manager);
+  if (!bar_manager->reloading) {
+    bar_manager_refresh(bar_manager, forced, false);
+    startup_mark(STARTUP_FIRST_FRAME);
+    return;
+  }
+
+  bar_manager_apply_claimed_order(bar_manager);
+  bar_manager_commit_stages(bar_manager);
+  bar_manager->reloading = false;
+  bar_manager->reload_checkpointed = false;
+  uint32_t stale_count = 0;
+  struct bar_item* stale[bar_manager->bar_item_count + 1];
+  for (int i = 0; i < bar_manager->bar_item_count; i++) {
+    struct bar_item* bar_item = bar_manager->bar_items[i];
+    if (bar_item->reload_generation != bar_manager->reload_generation)
+      stale[stale_count++] = bar_item;
+  }
+
+  for (int i = 0; i < stale_count; i++) {
+    bar_manager_remove_item(bar_manager, stale[i]);
+  }
+
+  bar_manager_refresh(bar_manager, forced, false);
+  startup_mark(STARTUP_FIRST_FRAME);
+}
+
 void bar_manager_update_alias_components(struct bar_manager* bar_manager, bool forced) {
   for (int i = 0; i < bar_manager->bar_item_count; i++) {
     if ((!bar_item_is_shown(bar_manager->bar_items[i]) && !forced)
@@ -487,6 +897,7 @@ void bar_manager_update_space_components(struct bar_manager* bar_manager, bool f
     if (bar_item->type != BAR_COMPONENT_SPACE) continue;
 
     if (!bar_item->overrides_association) {
+      uint32_t prev = bar_item->associated_display;
       uint32_t space = get_set_bit_position(bar_item->associated_space);
       uint32_t space_did = display_id_for_space(space);
       if (space_did) {
@@ -495,6 +906,9 @@ void bar_manager_update_space_components(struct bar_manager* bar_manager, bool f
       else {
         bar_item->associated_display = 1 << 30;
       }
+
+      if (prev != bar_item->associated_display)
+        bar_item_needs_update(bar_item);
     }
     for (int j = 0; j < bar_manager->bar_count; j++) {
       struct bar* bar = bar_manager->bars[j];
@@ -544,6 +958,12 @@ void bar_manager_rotator_refresh(struct bar_manager* bar_manager, CVTimeStamp* o
   bar_manager_refresh(bar_manager, false, true);
 }
 
+void bar_manager_channel_refresh(struct bar_manager* bar_manager) {
+  if (!channel_manager_drain(&bar_manager->channel_manager)) return;
+  if (bar_manager->bar_needs_resize) bar_manager_resize(bar_manager);
+  bar_manager_refresh(bar_manager, false, false);
+}
+
 void bar_manager_update(struct bar_manager* bar_manager, bool forced) {
   if ((bar_manager->frozen && !forced) || bar_manager->sleeps) return;
 
@@ -635,46 +1055,37 @@ void bar_manager_begin(struct bar_manager* bar_manager) {
     bar_manager->active_displays |= 1 << bar_manager->bars[i]->adid;
   }
 
-  bar_manager->active_adid = display_active_display_adid();
+  bar_manager_set_active_adid(bar_manager, display_active_display_adid());
   bar_manager->needs_ordering = true;
 }
 
-struct bar_item* bar_manager_get_item_by_point(struct bar_manager* bar_manager, CGPoint point, struct window** window_out) {
-  for (int i = 0; i < bar_manager->bar_item_count; i++) {
-    struct bar_item* bar_item = bar_manager->bar_items[i];
-    if (!bar_item->drawing) continue;
-
-    for (int adid = 1; adid <= bar_item->num_windows; adid++) {
-      struct window* window = bar_item_get_window(bar_item, adid);
-      if (!window) continue;
+static void bar_manager_update_hit_index(struct bar_manager* bar_manager) {
+  bool vertical = bar_manager->position == POSITION_LEFT
+                  || bar_manager->position == POSITION_RIGHT;
 
-      CGRect frame = window->frame;
-      frame.origin = window->origin;
-      if (cgrect_contains_point(&frame, &point)) {
-        if (window_out) *window_out = window;
-        return bar_item;
-      }
-    }
+  if (hit_index_is_current(&bar_manager->hit_index,
+                           vertical,
+                           g_window_generation     )) {
+    hit_index_update_frames(&bar_manager->hit_index, g_window_moves);
+    return;
   }
-  return NULL;
-}
 
-struct bar_item* bar_manager_get_item_by_wid(struct bar_manager* bar_manager, uint32_t wid, struct window** window_out) {
-  for (int i = 0; i < bar_manager->bar_item_count; i++) {
-    struct bar_item* bar_item = bar_manager->bar_items[i];
-    if (!bar_item->drawing) continue;
+  hit_index_build(&bar_manager->hit_index,
+                  bar_manager->bar_items,
+                  bar_manager->bar_item_count,
+                  vertical,
+                  g_window_generation,
+                  g_window_moves              );
+}
 
-    for (int adid = 1; adid <= bar_item->num_windows; adid++) {
-      struct window* window = bar_item_get_window(bar_item, adid);
-      if (!window) continue;
+struct bar_item* bar_manager_get_item_by_point(struct bar_manager* bar_manager, CGPoint point, struct window** window_out) {
+  bar_manager_update_hit_index(bar_manager);
+  return hit_index_item_at_point(&bar_manager->hit_index, point, window_out);
+}
 
-      if (window->id == wid) {
-        if (window_out) *window_out = window;
-        return bar_item;
-      }
-    }
-  }
-  return NULL;
+struct bar_item* bar_manager_get_item_by_wid(struct bar_manager* bar_manager, uint32_t wid, struct window** window_out) {
+  bar_manager_update_hit_index(bar_manager);
+  return hit_index_item_for_wid(&bar_manager->hit_index, wid, window_out);
 }
 
 struct bar* bar_manager_get_bar_by_wid(struct bar_manager* bar_manager, uint32_t wid) {
@@ -694,37 +1105,13 @@ bool bar_manager_mouse_over_any_bar(struct bar_manager* bar_manager) {
 }
 
 struct popup* bar_manager_get_popup_by_wid(struct bar_manager* bar_manager, uint32_t wid) {
-  for (int i = 0; i < bar_manager->bar_item_count; i++) {
-    struct bar_item* bar_item = bar_manager->bar_items[i];
-    if (!bar_item->drawing || !bar_item->popup.drawing) {
-      continue;
-    }
-
-    struct window* window = &bar_item->popup.window;
-
-    if (window->id == wid) {
-      return &bar_item->popup;
-    }
-  }
-  return NULL;
+  bar_manager_update_hit_index(bar_manager);
+  return hit_index_popup_for_wid(&bar_manager->hit_index, wid);
 }
 
 struct popup* bar_manager_get_popup_by_point(struct bar_manager* bar_manager, CGPoint point) {
-  for (int i = 0; i < bar_manager->bar_item_count; i++) {
-    struct bar_item* bar_item = bar_manager->bar_items[i];
-    if (!bar_item->drawing || !bar_item->popup.drawing) {
-      continue;
-    }
-
-    struct window* window = &bar_item->popup.window;
-
-    CGRect frame = window->frame;
-    frame.origin = window->origin;
-
-    if (CGRectContainsPoint(frame, point)) return &bar_item->popup;
-  }
-  return NULL;
-
+  bar_manager_update_hit_index(bar_manager);
+  return hit_index_popup_at_point(&bar_manager->hit_index, point);
 }
 
 struct bar* bar_manager_get_bar_by_point(struct bar_manager* bar_manager, CGPoint point) {
@@ -740,14 +1127,8 @@ struct bar* bar_manager_get_bar_by_point(struct bar_manager* bar_manager, CGPoin
 }
 
 bool bar_manager_mouse_over_any_popup(struct bar_manager* bar_manager) {
-  for (int i = 0; i < bar_manager->bar_item_count; i++) {
-    struct bar_item* bar_item = bar_manager->bar_items[i];
-    if (!bar_item->drawing || !bar_item->popup.drawing) {
-      continue;
-    }
-    if (bar_item->popup.mouse_over) return true;
-  }
-  return false;
+  bar_manager_update_hit_index(bar_manager);
+  return hit_index_mouse_over_any_popup(&bar_manager->hit_index);
 }
 
 void bar_manager_custom_events_trigger(struct bar_manager* bar_manager, char* name, struct env_vars* env_vars) {
@@ -778,6 +1159,7 @@ void bar_manager_display_moved(struct bar_manager* bar_manager, uint32_t did) {
       bar->adid = display_arrangement(bar->did);
       bar->dsid = display_space_id(bar->did);
       bar->sid = mission_control_index(bar->dsid);
+      bar->needs_association_check = true;
     }
   }
   bar_manager->needs_ordering = true;
@@ -794,7 +1176,7 @@ void bar_manager_display_added(struct bar_manager* bar_manager, uint32_t did) {
 }
 
 void bar_manager_display_changed(struct bar_manager* bar_manager) {
-  bar_manager->active_adid = display_active_display_adid();
+  bar_manager_set_active_adid(bar_manager, display_active_display_adid());
 
   bar_manager_freeze(bar_manager);
   bar_manager_reset(bar_manager);
@@ -976,10 +1358,15 @@ void bar_manager_handle_space_change(struct bar_manager* bar_manager, bool force
   bool force_refresh = false;
   for (int i = 0; i < bar_manager->bar_count; i++) {
     uint64_t dsid = display_space_id(bar_manager->bars[i]->did);
-    bar_manager->bars[i]->sid = mission_control_index(dsid);
+    uint32_t sid = mission_control_index(dsid);
+    bar_manager->bars[i]->needs_association_check
+                                      |= bar_manager->bars[i]->sid != sid;
+    bar_manager->bars[i]->sid = sid;
 
     bool was_shown = bar_manager->bars[i]->shown;
     bar_manager->bars[i]->shown = SLSSpaceGetType(g_connection, dsid) != 4 || bar_manager->show_in_fullscreen;
+    bar_manager->bars[i]->needs_association_check
+                                  |= was_shown != bar_manager->bars[i]->shown;
 
     bar_manager->needs_ordering |= !was_shown && bar_manager->bars[i]->shown;
     force_refresh |= !was_shown && bar_manager->bars[i]->shown;
@@ -1012,7 +1399,7 @@ void bar_manager_handle_space_change(struct bar_manager* bar_manager, bool force
 
 
   bar_manager_unfreeze(bar_manager);
-  bar_manager_refresh(bar_manager, force_refresh, false);
+  bar_manager_refresh(bar_manager, force_refresh, true);
   env_vars_destroy(&env_vars);
 }
 
@@ -1024,7 +1411,7 @@ void bar_manager_poll_active_display(struct bar_manager* bar_manager) {
 }
 
 void bar_manager_handle_display_change(struct bar_manager* bar_manager) {
-  bar_manager->active_adid = display_active_display_adid();
+  bar_manager_set_active_adid(bar_manager, display_active_display_adid());
   struct env_vars env_vars;
   env_vars_init(&env_vars);
   char adid_str[3];
@@ -1089,19 +1476,30 @@ void bar_manager_destroy(struct bar_manager* bar_manager) {
 
   animator_destroy(&bar_manager->animator);
   rotator_manager_destroy(&bar_manager->rotator_manager);
+  channel_manager_destroy(&bar_manager->channel_manager);
 
   while (bar_manager->bar_item_count > 0) {
     bar_manager_remove_item(bar_manager, bar_manager->bar_items[0]);
   }
 
   if (bar_manager->bar_items) free(bar_manager->bar_items);
+  if (bar_manager->dirty_items) free(bar_manager->dirty_items);
+  item_store_destroy(&bar_manager->item_store);
+  change_log_destroy(&bar_manager->change_log);
+  watch_registry_destroy(&bar_manager->watch_registry);
+  hit_index_destroy(&bar_manager->hit_index);
   for (int i = 0; i < bar_manager->bar_count; i++) {
     bar_destroy(bar_manager->bars[i]);
   }
 
-  bar_item_destroy(&bar_manager->default_item, false);
+  bar_item_destroy(&bar_manager->default_item);
   custom_events_destroy(&bar_manager->custom_events);
   background_destroy(&bar_manager->background);
+  config_stage_destroy(&bar_manager->bar_stage);
+  for (int i = 0; i < bar_manager->bar_config_key_count; i++)
+    free(bar_manager->bar_config_keys[i]);
+  if (bar_manager->bar_config_keys) free(bar_manager->bar_config_keys);
+  if (bar_manager->claimed_items) free(bar_manager->claimed_items);
 
   if (bar_manager->bars) free(bar_manager->bars);
   CFRunLoopRemoveTimer(CFRunLoopGetMain(),
@@ -3,6 +3,10 @@
 #include "bar_item.h"
 #include "animation.h"
 #include "rotator.h"
+#include "hit_index.h"
+#include "channel.h"
+#include "change_log.h"
+#include "watch.h"
 
 #define CLOCK_CALLBACK(name) void name(CFRunLoopTimerRef timer, void *context)
 typedef CLOCK_CALLBACK(clock_callback);
@@ -18,6 +22,9 @@ struct bar_manager {
 
   bool frozen;
   bool sleeps;
+  bool reloading;
+  bool reload_checkpointed;
+  bool config_running;
   bool shadow;
   bool topmost;
   bool sticky;
@@ -45,14 +52,36 @@ struct bar_manager {
   uint32_t active_displays;
 
   struct bar_item** bar_items;
+  struct item_store item_store;
   struct bar_item default_item;
   uint32_t bar_item_count;
+  uint64_t reload_generation;
+
+  // Config reload staging, see config_stage.h
+  struct bar_item* replaying_item;
+  item_handle* claimed_items;
+  uint32_t claimed_count;
+  uint32_t claimed_capacity;
+  uint64_t config_messages;
+  uint64_t defaults_hash;
+  struct config_stage bar_stage;
+  char** bar_config_keys;
+  uint32_t bar_config_key_count;
+
+  struct bar_item** dirty_items;
+  uint32_t dirty_item_count;
+  uint32_t dirty_item_capacity;
+
+  struct hit_index hit_index;
 
   struct background background;
   struct custom_events custom_events;
 
   struct animator animator;
   struct rotator_manager rotator_manager;
+  struct channel_manager channel_manager;
+  struct change_log change_log;
+  struct watch_registry watch_registry;
   struct image current_artwork;
 };
 
@@ -61,12 +90,23 @@ void bar_manager_begin(struct bar_manager* bar_manager);
 void bar_manager_reset(struct bar_manager* bar_manager);
 
 struct bar_item* bar_manager_create_item(struct bar_manager* bar_manager);
+bool bar_manager_reconcile_item(struct bar_manager* bar_manager, struct bar_item* bar_item, struct bar_item* ancestor, uint64_t seed);
+bool bar_manager_record_config(struct bar_manager* bar_manager, struct bar_item* bar_item, char* domain, char* name, char* tokens, uint32_t length);
+void bar_manager_record_bar_config(struct bar_manager* bar_manager, char* token, uint32_t length);
+void bar_manager_commit_stage(struct bar_manager* bar_manager, struct bar_item* bar_item);
+void bar_manager_begin_config(struct bar_manager* bar_manager);
+void bar_manager_begin_reload(struct bar_manager* bar_manager);
+void bar_manager_apply_claimed_order(struct bar_manager* bar_manager);
+void bar_manager_checkpoint_config(struct bar_manager* bar_manager);
+void bar_manager_commit_config(struct bar_manager* bar_manager);
 void bar_manager_remove_item(struct bar_manager* bar_manager, struct bar_item* bar_item);
+void bar_manager_mark_dirty(struct bar_manager* bar_manager, struct bar_item* bar_item);
 void bar_manager_move_item(struct bar_manager* bar_manager, struct bar_item* item, struct bar_item* reference, bool before);
 void bar_manager_handle_notification(struct bar_manager* bar_manager, struct notification* notification);
 
 void bar_manager_animator_refresh(struct bar_manager* bar_manager, uint64_t time);
 void bar_manager_rotator_refresh(struct bar_manager* bar_manager, CVTimeStamp* output_time);
+void bar_manager_channel_refresh(struct bar_manager* bar_manager);
 void bar_manager_update(struct bar_manager* bar_manager, bool forced);
 void bar_manager_update_space_components(struct bar_manager* bar_manager, bool forced);
 bool bar_manager_set_margin(struct bar_manager* bar_manager, int margin);
@@ -95,7 +135,9 @@ struct bar_item* bar_manager_get_item_by_wid(struct bar_manager* bar_manager, ui
 struct popup* bar_manager_get_popup_by_wid(struct bar_manager* bar_manager, uint32_t wid);
 struct bar* bar_manager_get_bar_by_wid(struct bar_manager* bar_manager, uint32_t wid);
 int bar_manager_get_item_index_for_name(struct bar_manager* bar_manager, char* name);
-uint32_t bar_manager_length_for_bar_side(struct bar_manager* bar_manager, struct bar* bar, char side);
+void bar_manager_get_items_for_names(struct bar_manager* bar_manager, char** names, uint32_t count, struct bar_item** items);
+struct bar_item* bar_manager_get_item(struct bar_manager* bar_manager, item_handle handle);
+bool bar_manager_bars_share_layout(struct bar_manager* bar_manager);
 bool bar_manager_mouse_over_any_popup(struct bar_manager* bar_manager);
 bool bar_manager_mouse_over_any_bar(struct bar_manager* bar_manager);
 
@@ -0,0 +1,220 @@
+#include "change_log.h"
+#include "bar_manager.h"
+
+static const char* g_change_groups[] = { "name", "type", "geometry", "icon",
+                                         "label", "scripting", "popup",
+                                         "graph", "slider", "alias"        };
+
+#define CHANGE_GROUP_COUNT (sizeof(g_change_groups) / sizeof(char*))
+
+struct change_summary {
+  item_handle item;
+  uint32_t changes;
+  char* name;
+};
+
+// Sequence numbers start at an epoch taken from the start time, such that a
+// sequence of a previous server process lies below the log and is truncated.
+void change_log_init(struct change_log* change_log) {
+  memset(change_log, 0, sizeof(struct change_log));
+  change_log->head = (uint64_t)time(NULL) << CHANGE_LOG_EPOCH_SHIFT;
+  change_log->dropped = change_log->head;
+}
+
+static struct change_entry* change_log_newest(struct change_log* change_log) {
+  if (change_log->count == 0) return NULL;
+  return &change_log->entries[(change_log->count - 1) % CHANGE_LOG_CAPACITY];
+}
+
+static struct change_entry* change_log_append(struct change_log* change_log) {
+  struct change_entry* entry = &change_log->entries[change_log->count
+                                                    % CHANGE_LOG_CAPACITY];
+  if (change_log->count >= CHANGE_LOG_CAPACITY) {
+    change_log->dropped = entry->seq;
+    if (entry->name) free(entry->name);
+  }
+
+  memset(entry, 0, sizeof(struct change_entry));
+  change_log->count++;
+  return entry;
+}
+
+void change_log_record(struct change_log* change_log, struct bar_item* bar_item, uint32_t changes) {
+  if (!changes) return;
+
+  item_handle item = ITEM_HANDLE_NULL;
+  if (bar_item) {
+    // The default item is not queried by clients
+    if (!bar_item->handle) return;
+    item = bar_item->handle;
+  }
+
+  uint64_t seq = ++change_log->head;
+  if (bar_item) bar_item->change_seq = seq;
+
+  struct change_entry* entry = change_log_newest(change_log);
+  if (!entry || entry->item != item || entry->name) {
+    entry = change_log_append(change_log);
+    entry->item = item;
+  }
+
+  entry->seq = seq;
+  entry->changes |= changes;
+}
+
+void change_log_record_removal(struct change_log* change_log, struct bar_item* bar_item) {
+  if (!bar_item->handle || !bar_item->name) return;
+
+  struct change_entry* entry = change_log_append(change_log);
+  entry->seq = ++change_log->head;
+  entry->item = bar_item->handle;
+  entry->changes = CHANGE_REMOVED;
+  entry->name = string_copy(bar_item->name);
+}
+
+static int change_summary_compare(const void* a, const void* b) {
+  const struct change_summary* summary_a = a;
+  const struct change_summary* summary_b = b;
+  if (summary_a->item != summary_b->item)
+    return summary_a->item < summary_b->item ? -1 : 1;
+  return 0;
+}
+
+static bool change_filter_match(struct change_filter* filter, const char* name) {
+  if (!name) return false;
+  if (!filter || !filter->match) return true;
+  return filter->match(name, filter->context);
+}
+
+static void change_log_write_item(struct json_writer* writer, struct bar_item* bar_item, uint32_t changes, struct change_filter* filter) {
+  struct query_projection projection;
+  query_projection_init(&projection);
+
+  json_key(writer, bar_item->name, strlen(bar_item->name));
+  json_begin_object(writer);
+  json_key(writer, "seq", 3);
+  json_printf(writer, "%llu", bar_item->change_seq);
+
+  json_key(writer, "changed", 7);
+  json_printf(writer, "[");
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < CHANGE_GROUP_COUNT; i++) {
+    if (!(changes & (1 << i))) continue;
+    if (count++ > 0) json_printf(writer, ", ");
+    json_string(writer, g_change_groups[i]);
+    query_projection_select(&projection, g_change_groups[i],
+                                         strlen(g_change_groups[i]));
+  }
+  json_printf(writer, "]");
+
+  query_write_fields(writer, bar_item, filter && filter->projection
+                                       ? filter->projection
+                                       : &projection                );
+  json_end_object(writer);
+  query_projection_destroy(&projection);
+}
+
+// Only the entries newer than since are visited. A client which asks for
+// changes older than the log reaches receives all items instead, as does a
+// full write and a client ahead of the head. Returns the number of items
+// written as changed or removed.
+uint32_t change_log_write(struct change_log* change_log, uint64_t since, bool full, struct change_filter* filter, struct json_writer* writer) {
+  bool truncated = full
+                   || since < change_log->dropped
+                   || since > change_log->head;
+  uint32_t bar_changes = truncated ? CHANGE_BAR | CHANGE_ORDER : 0;
+
+  uint32_t count = 0;
+  struct change_summary* summaries = NULL;
+  if (!truncated) {
+    uint64_t available = change_log->count < CHANGE_LOG_CAPACITY
+                         ? change_log->count
+                         : CHANGE_LOG_CAPACITY;
+    summaries = malloc(sizeof(struct change_summary) * (available + 1));
+
+    for (uint64_t i = 0; i < available; i++) {
+      struct change_entry* entry = &change_log->entries[(change_log->count
+                                                         - 1 - i)
+                                                        % CHANGE_LOG_CAPACITY];
+      if (entry->seq <= since) break;
+      if (!entry->item) {
+        bar_changes |= entry->changes;
+        continue;
+      }
+      summaries[count++] = (struct change_summary){ entry->item,
+                                                    entry->changes,
+                                                    entry->name     };
+    }
+    qsort(summaries, count, sizeof(struct change_summary),
+                            change_summary_compare        );
+  }
+
+  json_begin_object(writer);
+  json_key(writer, "head", 4);
+  json_printf(writer, "%llu", change_log->head);
+  json_key(writer, "truncated", 9);
+  json_string(writer, format_bool(truncated));
+  json_key(writer, "bar", 3);
+  json_string(writer, format_bool(bar_changes & CHANGE_BAR));
+  json_key(writer, "order", 5);
+  json_string(writer, format_bool(bar_changes & CHANGE_ORDER));
+
+  uint32_t written = 0;
+  json_key(writer, "items", 5);
+  json_begin_object(writer);
+  if (truncated) {
+    for (uint32_t i = 0; i < g_bar_manager.bar_item_count; i++) {
+      struct bar_item* bar_item = g_bar_manager.bar_items[i];
+      if (!change_filter_match(filter, bar_item->name)) continue;
+      change_log_write_item(writer, bar_item, CHANGE_ITEM, filter);
+      written++;
+    }
+  } else {
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t changes = 0;
+      uint32_t j = i;
+      for (; j < count && summaries[j].item == summaries[i].item; j++)
+        if (!summaries[j].name) changes |= summaries[j].changes;
+
+      struct bar_item* bar_item = bar_manager_get_item(&g_bar_manager,
+                                                       summaries[i].item);
+      if (bar_item && changes && change_filter_match(filter, bar_item->name)) {
+        change_log_write_item(writer, bar_item, changes, filter);
+        written++;
+      }
+      i = j - 1;
+    }
+  }
+  json_end_object(writer);
+
+  json_key(writer, "removed", 7);
+  json_printf(writer, "[");
+  uint32_t removed = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (!summaries[i].name) continue;
+    if (!change_filter_match(filter, summaries[i].name)) continue;
+    if (removed++ > 0) json_printf(writer, ", ");
+    json_string(writer, summaries[i].name);
+  }
+  json_printf(writer, "]");
+  json_end_object(writer);
+
+  if (summaries) free(summaries);
+  return written + removed;
+}
+
+void change_log_serialize(struct change_log* change_log, uint64_t since, FILE* rsp) {
+  struct json_writer* writer = &change_log->writer;
+  json_writer_reset(writer);
+  change_log_write(change_log, since, false, NULL, writer);
+  json_printf(writer, "\n");
+  json_writer_flush(writer, rsp);
+}
+
+void change_log_destroy(struct change_log* change_log) {
+  for (uint32_t i = 0; i < CHANGE_LOG_CAPACITY; i++) {
+    if (change_log->entries[i].name) free(change_log->entries[i].name);
+  }
+  if (change_log->writer.buffer) free(change_log->writer.buffer);
+  change_log_init(change_log);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "misc/helpers.h"
+#include "item_store.h"
+#include "query.h"
+
+#define CHANGE_LOG_CAPACITY    4096
+#define CHANGE_LOG_EPOCH_SHIFT 20
+#define CHANGES_SINCE_PREFIX   "since="
+
+#define CHANGE_NAME      (1 << 0)
+#define CHANGE_TYPE      (1 << 1)
+#define CHANGE_GEOMETRY  (1 << 2)
+#define CHANGE_ICON      (1 << 3)
+#define CHANGE_LABEL     (1 << 4)
+#define CHANGE_SCRIPTING (1 << 5)
+#define CHANGE_POPUP     (1 << 6)
+#define CHANGE_GRAPH     (1 << 7)
+#define CHANGE_SLIDER    (1 << 8)
+#define CHANGE_ALIAS     (1 << 9)
+#define CHANGE_ITEM      ((1 << 10) - 1)
+
+#define CHANGE_REMOVED   (1 << 29)
+#define CHANGE_BAR       (1 << 30)
+#define CHANGE_ORDER     (1u << 31)
+
+struct bar_item;
+
+// Changes of the bar itself and of the item order are logged without an
+// item, removals keep the name the item had.
+struct change_entry {
+  uint64_t seq;
+  item_handle item;
+  uint32_t changes;
+  char* name;
+};
+
+// Bounded log of recent mutations, consecutive changes of the same item
+// share one entry. A client which fell behind the log receives everything.
+struct change_log {
+  struct change_entry entries[CHANGE_LOG_CAPACITY];
+  uint64_t count;
+  uint64_t head;
+  uint64_t dropped;
+
+  struct json_writer writer;
+};
+
+// Restricts written changes to the items whose names match, a projection
+// replaces the changed property groups by a fixed set of fields.
+struct change_filter {
+  bool (*match)(const char* name, void* context);
+  void* context;
+  struct query_projection* projection;
+};
+
+void change_log_init(struct change_log* change_log);
+void change_log_record(struct change_log* change_log, struct bar_item* bar_item, uint32_t changes);
+void change_log_record_removal(struct change_log* change_log, struct bar_item* bar_item);
+uint32_t change_log_write(struct change_log* change_log, uint64_t since, bool full, struct change_filter* filter, struct json_writer* writer);
+void change_log_serialize(struct change_log* change_log, uint64_t since, FILE* rsp);
+void change_log_destroy(struct change_log* change_log);
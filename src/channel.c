@@ -0,0 +1,249 @@
+#include "channel.h"
+#include "bar_manager.h"
+#include "event.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <ctype.h>
+
+extern char g_name[256];
+
+void channel_manager_init(struct channel_manager* channel_manager) {
+  channel_manager->channels = NULL;
+  channel_manager->channel_count = 0;
+  channel_manager->display_link = NULL;
+}
+
+static CVReturn channel_frame_callback(CVDisplayLinkRef display_link, const CVTimeStamp* now, const CVTimeStamp* output_time, CVOptionFlags flags, CVOptionFlags* flags_out, void* context) {
+  struct event event = { NULL, CHANNEL_REFRESH };
+  event_post(&event);
+  return kCVReturnSuccess;
+}
+
+static void channel_manager_destroy_display_link(struct channel_manager* channel_manager) {
+  if (channel_manager->display_link) {
+    CVDisplayLinkStop(channel_manager->display_link);
+    CVDisplayLinkRelease(channel_manager->display_link);
+    channel_manager->display_link = NULL;
+  }
+}
+
+static void channel_manager_renew_display_link(struct channel_manager* channel_manager) {
+  channel_manager_destroy_display_link(channel_manager);
+
+  CVDisplayLinkCreateWithActiveCGDisplays(&channel_manager->display_link);
+  CVDisplayLinkSetOutputCallback(channel_manager->display_link,
+                                 channel_frame_callback,
+                                 channel_manager         );
+
+  CVDisplayLinkStart(channel_manager->display_link);
+}
+
+static struct channel* channel_manager_get(struct channel_manager* channel_manager, char* name) {
+  for (int i = 0; i < channel_manager->channel_count; i++) {
+    if (string_equals(channel_manager->channels[i]->name, name))
+      return channel_manager->channels[i];
+  }
+  return NULL;
+}
+
+// The name becomes part of the file name of the ring, hence it is limited to
+// characters that can not leave the directory.
+bool channel_name_valid(char* name) {
+  if (!name || !*name || strstr(name, "..")) return false;
+  for (char* c = name; *c; c++) {
+    if (!isalnum(*c) && *c != '.' && *c != '_' && *c != '-') return false;
+  }
+  return true;
+}
+
+static struct channel* channel_create(char* name) {
+  char directory[MAXLEN];
+  if (!channel_name_valid(name)
+      || !get_user_temp_dir(directory, sizeof(directory))) {
+    return NULL;
+  }
+
+  struct channel* channel = malloc(sizeof(struct channel));
+  memset(channel, 0, sizeof(struct channel));
+  snprintf(channel->path, MAXLEN, CHANNEL_PATH_FMT, directory, g_name, name);
+
+  int fd = create_private_file(channel->path, O_RDWR);
+  if (fd < 0) {
+    free(channel);
+    return NULL;
+  }
+
+  channel->size = ring_size(RING_CAPACITY);
+  if (ftruncate(fd, channel->size) != 0) {
+    close(fd);
+    unlink(channel->path);
+    free(channel);
+    return NULL;
+  }
+
+  void* ring = mmap(NULL,
+                    channel->size,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED,
+                    fd,
+                    0                      );
+  close(fd);
+
+  if (ring == MAP_FAILED) {
+    unlink(channel->path);
+    free(channel);
+    return NULL;
+  }
+
+  channel->ring = ring;
+  channel->name = string_copy(name);
+  ring_init(channel->ring, RING_CAPACITY);
+  return channel;
+}
+
+static void channel_destroy(struct channel* channel) {
+  munmap(channel->ring, channel->size);
+  unlink(channel->path);
+  free(channel->name);
+  free(channel);
+}
+
+struct channel* channel_manager_open(struct channel_manager* channel_manager, char* name) {
+  struct channel* channel = channel_manager_get(channel_manager, name);
+  if (channel) return channel;
+
+  channel = channel_create(name);
+  if (!channel) return NULL;
+
+  channel_manager->channels = realloc(channel_manager->channels,
+                                      sizeof(struct channel*)
+                                      * ++channel_manager->channel_count);
+  channel_manager->channels[channel_manager->channel_count - 1] = channel;
+
+  if (!channel_manager->display_link)
+    channel_manager_renew_display_link(channel_manager);
+
+  return channel;
+}
+
+void channel_manager_close(struct channel_manager* channel_manager, char* name) {
+  struct channel* channel = channel_manager_get(channel_manager, name);
+  if (!channel) return;
+
+  uint32_t count = 0;
+  for (int i = 0; i < channel_manager->channel_count; i++) {
+    if (channel_manager->channels[i] == channel) continue;
+    channel_manager->channels[count++] = channel_manager->channels[i];
+  }
+  channel_manager->channel_count = count;
+  channel_destroy(channel);
+
+  if (channel_manager->channel_count == 0) {
+    free(channel_manager->channels);
+    channel_manager->channels = NULL;
+    channel_manager_destroy_display_link(channel_manager);
+  }
+}
+
+// Returns the change log groups of the properties which changed
+static uint32_t channel_apply_last(struct bar_item* bar_item, struct ring_sample* sample) {
+  if (sample->count == 0) {
+    char text[RING_TEXT_LENGTH];
+    memcpy(text, sample->text, RING_TEXT_LENGTH);
+    text[RING_TEXT_LENGTH - 1] = '\0';
+    return text_set_string(&bar_item->label, string_copy(text), false)
+           ? CHANGE_LABEL
+           : 0;
+  }
+
+  float value = sample->values[0];
+  if (bar_item->has_slider) {
+    return slider_set_percentage(&bar_item->slider, clamp(value, 0.f, 100.f))
+           ? CHANGE_SLIDER
+           : 0;
+  }
+
+  char text[32];
+  snprintf(text, 32, "%g", value);
+  return text_set_string(&bar_item->label, string_copy(text), false)
+         ? CHANGE_LABEL
+         : 0;
+}
+
+static bool channel_drain(struct channel* channel) {
+  struct ring_header* ring = channel->ring;
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint64_t tail = ring->tail;
+  if (head == tail) return false;
+
+  // A misbehaving producer can not make us read beyond the ring
+  if (head - tail > RING_CAPACITY) tail = head - RING_CAPACITY;
+
+  int index = bar_manager_get_item_index_for_name(&g_bar_manager,
+                                                  channel->name );
+  struct bar_item* bar_item = index >= 0
+                              ? g_bar_manager.bar_items[index]
+                              : NULL;
+
+  uint32_t changes = 0;
+  struct ring_sample* last = NULL;
+  for (uint64_t i = tail; i < head; i++) {
+    struct ring_sample* sample = &ring->samples[i % RING_CAPACITY];
+    if (bar_item && bar_item->has_graph && sample->count > 0) {
+      graph_push_back_series(&bar_item->graph,
+                             sample->values,
+                             min(sample->count, RING_MAX_VALUES));
+      changes |= CHANGE_GRAPH;
+    } else last = sample;
+  }
+
+  if (bar_item && last) changes |= channel_apply_last(bar_item, last);
+  __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+  channel->drained += head - tail;
+
+  if (changes) {
+    bar_item_needs_update(bar_item);
+    change_log_record(&g_bar_manager.change_log, bar_item, changes);
+  }
+  return changes != 0;
+}
+
+bool channel_manager_drain(struct channel_manager* channel_manager) {
+  bool needs_refresh = false;
+  for (int i = 0; i < channel_manager->channel_count; i++) {
+    needs_refresh |= channel_drain(channel_manager->channels[i]);
+  }
+  return needs_refresh;
+}
+
+void channel_manager_destroy(struct channel_manager* channel_manager) {
+  channel_manager_destroy_display_link(channel_manager);
+  for (int i = 0; i < channel_manager->channel_count; i++) {
+    channel_destroy(channel_manager->channels[i]);
+  }
+  if (channel_manager->channels) free(channel_manager->channels);
+  channel_manager_init(channel_manager);
+}
+
+void channel_manager_serialize(struct channel_manager* channel_manager, FILE* rsp) {
+  fprintf(rsp, "{\n");
+  for (int i = 0; i < channel_manager->channel_count; i++) {
+    struct channel* channel = channel_manager->channels[i];
+    struct ring_header* ring = channel->ring;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    fprintf(rsp, "\t\"%s\": {\n"
+                 "\t\t\"path\": \"%s\",\n"
+                 "\t\t\"capacity\": %u,\n"
+                 "\t\t\"pending\": %llu,\n"
+                 "\t\t\"drained\": %llu,\n"
+                 "\t\t\"dropped\": %llu\n",
+                 channel->name,
+                 channel->path,
+                 ring->capacity,
+                 head - ring->tail,
+                 channel->drained,
+                 __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED));
+    fprintf(rsp, i < channel_manager->channel_count - 1 ? "\t},\n" : "\t}\n");
+  }
+  fprintf(rsp, "}\n");
+}
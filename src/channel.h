@@ -0,0 +1,30 @@
+#pragma once
+#include <CoreVideo/CoreVideo.h>
+#include "misc/helpers.h"
+#include "misc/ring.h"
+
+#define CHANNEL_PATH_FMT "%s%s.%s.channel"
+
+// A shared memory ring bound to the item of the same name. Graphs receive
+// every sample, sliders and labels only the most recent one per frame.
+struct channel {
+  char* name;
+  char path[MAXLEN];
+  struct ring_header* ring;
+  size_t size;
+  uint64_t drained;
+};
+
+struct channel_manager {
+  struct channel** channels;
+  uint32_t channel_count;
+  CVDisplayLinkRef display_link;
+};
+
+void channel_manager_init(struct channel_manager* channel_manager);
+bool channel_name_valid(char* name);
+struct channel* channel_manager_open(struct channel_manager* channel_manager, char* name);
+void channel_manager_close(struct channel_manager* channel_manager, char* name);
+bool channel_manager_drain(struct channel_manager* channel_manager);
+void channel_manager_destroy(struct channel_manager* channel_manager);
+void channel_manager_serialize(struct channel_manager* channel_manager, FILE* rsp);
@@ -0,0 +1,81 @@
+#include "config_stage.h"
+#include "bar_item.h"
+#include "message.h"
+#include "misc/hash.h"
+
+// The length of the NUL separated tokens up to the empty token ending them
+uint32_t config_token_list_length(char* tokens) {
+  char* cursor = tokens;
+  while (*cursor) cursor += strlen(cursor) + 1;
+  return cursor - tokens;
+}
+
+uint64_t config_hash_append(uint64_t hash, char* domain, char* name, char* tokens, uint32_t length) {
+  hash = hash_xxh64(domain, strlen(domain) + 1, hash);
+  if (name) hash = hash_xxh64(name, strlen(name) + 1, hash);
+  return hash_xxh64(tokens, length, hash);
+}
+
+void config_stage_init(struct config_stage* stage, uint64_t seed) {
+  stage->messages = NULL;
+  stage->length = 0;
+  stage->hash = seed;
+}
+
+static void config_stage_append_bytes(struct config_stage* stage, char* bytes, uint32_t length) {
+  // The messages always end in the empty token that terminates a message
+  stage->messages = realloc(stage->messages, stage->length + length + 1);
+  memcpy(stage->messages + stage->length, bytes, length);
+  stage->length += length;
+  stage->messages[stage->length] = '\0';
+}
+
+void config_stage_append(struct config_stage* stage, char* domain, char* name, char* tokens, uint32_t length) {
+  if (length == 0) return;
+  config_stage_append_bytes(stage, domain, strlen(domain) + 1);
+  if (name) config_stage_append_bytes(stage, name, strlen(name) + 1);
+  config_stage_append_bytes(stage, tokens, length);
+  stage->hash = config_hash_append(stage->hash, domain, name, tokens, length);
+}
+
+// The keys of all <key>=<value> tokens in the staged messages
+char** config_stage_keys(struct config_stage* stage, uint32_t* count) {
+  *count = 0;
+  char** keys = NULL;
+  char* cursor = stage->messages;
+  char* end = stage->messages + stage->length;
+  while (cursor && cursor < end) {
+    char* separator = strchr(cursor, '=');
+    if (cursor[0] != '-' && separator) {
+      keys = realloc(keys, sizeof(char*) * (*count + 1));
+      keys[(*count)++] = strndup(cursor, separator - cursor);
+    }
+    cursor += strlen(cursor) + 1;
+  }
+  return keys;
+}
+
+void config_stage_replay(struct config_stage* stage) {
+  if (stage->length == 0) return;
+  handle_message(stage->messages, NULL);
+}
+
+void config_stage_destroy(struct config_stage* stage) {
+  if (stage->messages) free(stage->messages);
+  config_stage_init(stage, 0);
+}
+
+struct item_stage* item_stage_create(struct bar_item* ancestor, uint64_t seed) {
+  struct item_stage* stage = malloc(sizeof(struct item_stage));
+  config_stage_init(&stage->config, seed);
+  stage->ancestor = malloc(sizeof(struct bar_item));
+  bar_item_init(stage->ancestor, ancestor);
+  return stage;
+}
+
+void item_stage_destroy(struct item_stage* stage) {
+  bar_item_destroy(stage->ancestor);
+  free(stage->ancestor);
+  config_stage_destroy(&stage->config);
+  free(stage);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "misc/helpers.h"
+
+#define CONFIG_HASH_SEED 0x53424346
+
+struct bar_item;
+
+// The messages of a config run in the message grammar, together with a hash
+// chained over them in the order they arrived. Two runs that send the same
+// messages end with the same hash.
+struct config_stage {
+  char* messages;
+  uint32_t length;
+  uint64_t hash;
+};
+
+// The messages a reload sends to an item of the previous run are held back
+// until the reload commits. They are only applied, on top of a copy of the
+// ancestor the item was claimed with, if they do not reproduce the
+// configuration the item already has.
+struct item_stage {
+  struct config_stage config;
+  struct bar_item* ancestor;
+};
+
+uint32_t config_token_list_length(char* tokens);
+uint64_t config_hash_append(uint64_t hash, char* domain, char* name, char* tokens, uint32_t length);
+
+void config_stage_init(struct config_stage* stage, uint64_t seed);
+void config_stage_append(struct config_stage* stage, char* domain, char* name, char* tokens, uint32_t length);
+char** config_stage_keys(struct config_stage* stage, uint32_t* count);
+void config_stage_replay(struct config_stage* stage);
+void config_stage_destroy(struct config_stage* stage);
+
+struct item_stage* item_stage_create(struct bar_item* ancestor, uint64_t seed);
+void item_stage_destroy(struct item_stage* stage);
@@ -2,6 +2,7 @@
 #include "bar_manager.h"
 #include "custom_events.h"
 #include "hotload.h"
+#include "trace.h"
 
 extern struct bar_manager g_bar_manager;
 extern int g_connection;
@@ -69,6 +70,10 @@ static void event_rotator_refresh(void* context) {
   bar_manager_rotator_refresh(&g_bar_manager, (CVTimeStamp*)context);
 }
 
+static void event_channel_refresh(void* context) {
+  bar_manager_channel_refresh(&g_bar_manager);
+}
+
 static void event_mach_message(void* context) {
   handle_message_mach(context);
 }
@@ -340,10 +345,15 @@ static void event_space_windows_changed(void* context) {
 }
 
 static void event_hotload(void* context) {
-  bar_manager_destroy(&g_bar_manager);
-  bar_manager_init(&g_bar_manager);
-  bar_manager_begin(&g_bar_manager);
-  exec_config_file();
+  reload_config();
+}
+
+static void event_hotload_commit(void* context) {
+  commit_config();
+}
+
+static void event_hotload_checkpoint(void* context) {
+  checkpoint_config((pid_t)(intptr_t)context);
 }
 
 typedef void callback_type(void*);
@@ -373,8 +383,11 @@ static callback_type* event_handler[] = {
   [SHELL_REFRESH]              = event_shell_refresh,
   [ANIMATOR_REFRESH]           = event_animator_refresh,
   [ROTATOR_REFRESH]            = event_rotator_refresh,
+  [CHANNEL_REFRESH]            = event_channel_refresh,
   [MACH_MESSAGE]               = event_mach_message,
   [HOTLOAD]                    = event_hotload,
+  [HOTLOAD_COMMIT]             = event_hotload_commit,
+  [HOTLOAD_CHECKPOINT]         = event_hotload_checkpoint,
   [SPACE_WINDOWS_CHANGED]      = event_space_windows_changed,
 };
 
@@ -395,7 +408,9 @@ void event_post(struct event *event) {
     error("Trying to reinitialize the event mutex! abort..\n");
   } else if (!initialized) error("The event mutex is not ready! abort..\n");
 
-  if (event->type == ANIMATOR_REFRESH || event->type == ROTATOR_REFRESH) {
+  if (event->type == ANIMATOR_REFRESH
+      || event->type == ROTATOR_REFRESH
+      || event->type == CHANNEL_REFRESH) {
     // We try to lock the mutex up to 1ms and then concede (skip the frame) to
     // avoid deadlocking occuring due to the CVDisplayLink.
     int locked;
@@ -411,7 +426,14 @@ void event_post(struct event *event) {
     }
   }
 
+  TRACE_BEGIN(event_post);
   event_handler[event->type](event->context);
   windows_unfreeze();
+
+  // Also reached while the bar is frozen or a reload is running, when no
+  // refresh happens
+  watch_registry_flush(&g_bar_manager.watch_registry,
+                       &g_bar_manager.change_log    );
+  TRACE_END_ARG(event_post, event->type);
   pthread_mutex_unlock(&event_mutex);
 }
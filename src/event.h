@@ -17,6 +17,7 @@ enum event_type {
   SHELL_REFRESH,
   ANIMATOR_REFRESH,
   ROTATOR_REFRESH,
+  CHANNEL_REFRESH,
   MACH_MESSAGE,
   MOUSE_UP,
   MOUSE_DRAGGED,
@@ -32,6 +33,8 @@ enum event_type {
   SPACE_WINDOWS_CHANGED,
   DISTRIBUTED_NOTIFICATION,
   HOTLOAD,
+  HOTLOAD_COMMIT,
+  HOTLOAD_CHECKPOINT,
 
   INIT_MUTEX,
   EVENT_TYPE_COUNT
@@ -1,6 +1,7 @@
 #include "font.h"
 #include "animation.h"
 #include "bar_manager.h"
+#include "startup.h"
 
 void font_register(char* font_path) {
   CFStringRef url_string = CFStringCreateWithCString(kCFAllocatorDefault,
@@ -21,19 +22,35 @@ void font_register(char* font_path) {
   free(font_path);
 }
 
-void font_create_ctfont(struct font* font) {
+static struct font_registry g_font_registry = { 0 };
+
+static uint64_t font_hash(char* family, char* style, float size) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (char* c = family; *c; c++) {
+    hash = (hash ^ (unsigned char)*c) * 0x100000001b3ULL;
+  }
+  hash = (hash ^ ':') * 0x100000001b3ULL;
+  for (char* c = style; *c; c++) {
+    hash = (hash ^ (unsigned char)*c) * 0x100000001b3ULL;
+  }
 
+  uint32_t size_bits;
+  memcpy(&size_bits, &size, sizeof(uint32_t));
+  return (hash ^ size_bits) * 0x100000001b3ULL;
+}
+
+static void font_handle_create_ctfont(struct font_handle* handle) {
   CFStringRef family_ref = CFStringCreateWithCString(NULL,
-                                                     font->family,
+                                                     handle->family,
                                                      kCFStringEncodingUTF8);
 
   CFStringRef style_ref = CFStringCreateWithCString(NULL,
-                                                    font->style,
+                                                    handle->style,
                                                     kCFStringEncodingUTF8);
 
   CFNumberRef size_ref = CFNumberCreate(NULL,
                                         kCFNumberFloat32Type,
-                                        &font->size          );
+                                        &handle->size        );
 
   const void *keys[] = { kCTFontFamilyNameAttribute,
                          kCTFontStyleNameAttribute,
@@ -48,18 +65,101 @@ void font_create_ctfont(struct font* font) {
                                             &kCFTypeDictionaryValueCallBacks);
 
   CTFontDescriptorRef descriptor = CTFontDescriptorCreateWithAttributes(attr);
-
-  if (font->ct_font) CFRelease(font->ct_font);
-  font->ct_font = CTFontCreateWithFontDescriptor(descriptor, 0.0, NULL);
+  handle->ct_font = CTFontCreateWithFontDescriptor(descriptor, 0.0, NULL);
+  startup_count(STARTUP_FONTS);
 
   CFRelease(descriptor);
   CFRelease(attr);
   CFRelease(size_ref);
   CFRelease(style_ref);
   CFRelease(family_ref);
+
+  const void *text_keys[] = { kCTFontAttributeName,
+                              kCTForegroundColorFromContextAttributeName };
+
+  const void *text_values[] = { handle->ct_font, kCFBooleanTrue };
+  handle->attributes = CFDictionaryCreate(NULL,
+                                          text_keys,
+                                          text_values,
+                                          array_count(text_keys),
+                                          &kCFTypeDictionaryKeyCallBacks,
+                                          &kCFTypeDictionaryValueCallBacks);
+}
+
+static struct font_handle* font_handle_acquire(char* family, char* style, float size) {
+  g_font_registry.lookups++;
+  uint64_t hash = font_hash(family, style, size);
+  struct font_handle** bucket
+                       = &g_font_registry.buckets[hash % FONT_REGISTRY_BUCKETS];
+
+  for (struct font_handle* handle = *bucket; handle; handle = handle->next) {
+    if (handle->hash == hash
+        && handle->size == size
+        && string_equals(handle->family, family)
+        && string_equals(handle->style, style)) {
+      return font_handle_retain(handle);
+    }
+  }
+
+  struct font_handle* handle = malloc(sizeof(struct font_handle));
+  memset(handle, 0, sizeof(struct font_handle));
+  handle->hash = hash;
+  handle->refcount = 1;
+  handle->family = string_copy(family);
+  handle->style = string_copy(style);
+  handle->size = size;
+  font_handle_create_ctfont(handle);
+
+  handle->next = *bucket;
+  *bucket = handle;
+  g_font_registry.count++;
+  g_font_registry.created++;
+  return handle;
+}
+
+struct font_handle* font_handle_retain(struct font_handle* handle) {
+  if (handle) handle->refcount++;
+  return handle;
+}
+
+void font_handle_release(struct font_handle* handle) {
+  if (!handle || --handle->refcount > 0) return;
+
+  struct font_handle** link
+                       = &g_font_registry.buckets[handle->hash
+                                                  % FONT_REGISTRY_BUCKETS];
+  while (*link && *link != handle) link = &(*link)->next;
+  if (*link) *link = handle->next;
+
+  if (handle->attributes) CFRelease(handle->attributes);
+  if (handle->ct_font) CFRelease(handle->ct_font);
+  free(handle->family);
+  free(handle->style);
+  free(handle);
+  g_font_registry.count--;
+}
+
+void font_registry_serialize(char* indent, FILE* rsp) {
+  fprintf(rsp, "%s\"entries\": %u,\n"
+               "%s\"created\": %llu,\n"
+               "%s\"lookups\": %llu",
+               indent, g_font_registry.count,
+               indent, g_font_registry.created,
+               indent, g_font_registry.lookups);
+}
+
+void font_create_ctfont(struct font* font) {
+  struct font_handle* handle = font_handle_acquire(font->family,
+                                                   font->style,
+                                                   font->size   );
+
+  font_handle_release(font->handle);
+  font->handle = handle;
 }
 
 void font_init(struct font* font) {
+  font->handle = NULL;
+  font->font_changed = false;
   font->size = 14.f;
   font->style = string_copy("Bold");
   font->family = string_copy("Hack Nerd Font");
@@ -122,7 +222,7 @@ bool font_set(struct font* font, char* font_string, bool forced) {
 }
 
 void font_clear_pointers(struct font* font) {
-  font->ct_font = NULL;
+  font->handle = NULL;
   font->family = NULL;
   font->style = NULL;
 }
@@ -130,7 +230,7 @@ void font_clear_pointers(struct font* font) {
 void font_destroy(struct font* font) {
   if (font->style) free(font->style);
   if (font->family) free(font->family);
-  if (font->ct_font) CFRelease(font->ct_font);
+  font_handle_release(font->handle);
   font_clear_pointers(font);
 }
 
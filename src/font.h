@@ -2,8 +2,34 @@
 #include <CoreText/CoreText.h>
 #include "misc/helpers.h"
 
-struct font {
+#define FONT_REGISTRY_BUCKETS 64
+
+// Fonts are interned by family, style and size, such that all texts using
+// the same font share a single CTFont and attribute dictionary.
+struct font_handle {
+  uint64_t hash;
+  uint32_t refcount;
+
+  char* family;
+  char* style;
+  float size;
+
   CTFontRef ct_font;
+  CFDictionaryRef attributes;
+
+  struct font_handle* next;
+};
+
+struct font_registry {
+  struct font_handle* buckets[FONT_REGISTRY_BUCKETS];
+  uint32_t count;
+
+  uint64_t created;
+  uint64_t lookups;
+};
+
+struct font {
+  struct font_handle* handle;
 
   bool font_changed;
   float size;
@@ -13,6 +39,10 @@ struct font {
 
 void font_register(char* font_path);
 
+struct font_handle* font_handle_retain(struct font_handle* handle);
+void font_handle_release(struct font_handle* handle);
+void font_registry_serialize(char* indent, FILE* rsp);
+
 void font_init(struct font* font);
 void font_destroy(struct font* font);
 bool font_set(struct font* font, char* font_string, bool forced);
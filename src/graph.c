@@ -1,8 +1,17 @@
 #include "graph.h"
+#include "misc/hash.h"
+#include <math.h>
 
 void graph_init(struct graph* graph) {
   graph->width = 0;
+  graph->draw_width = 0;
   graph->cursor = 0;
+  graph->pushes = 0;
+  graph->incremental = false;
+  graph->samples = NULL;
+  graph->storage = GRAPH_STORAGE_FLOAT;
+  graph->series = 1;
+  graph->series_colors = NULL;
 
   graph->line_width = 0.5;
   graph->fill = true;
@@ -11,47 +20,199 @@ void graph_init(struct graph* graph) {
 
   color_init(&graph->line_color, 0xffcccccc);
   color_init(&graph->fill_color, 0xffcccccc);
+
+  memset(&graph->bitmap, 0, sizeof(struct graph_bitmap));
+  pthread_mutex_init(&graph->bitmap.mutex, NULL);
+}
+
+void graph_clear_pointers(struct graph* graph) {
+  graph->samples = NULL;
+  graph->series_colors = NULL;
+  memset(&graph->bitmap, 0, sizeof(struct graph_bitmap));
+  pthread_mutex_init(&graph->bitmap.mutex, NULL);
+}
+
+static struct graph_samples graph_get_samples(struct graph* graph) {
+  return (struct graph_samples){ graph->enabled ? graph->samples : NULL,
+                                 graph->storage,
+                                 graph->width,
+                                 graph->series,
+                                 graph->cursor                         };
 }
 
 void graph_setup(struct graph* graph, uint32_t width) {
+  if (graph->samples) free(graph->samples);
   graph->width = width;
-  graph->y = malloc(sizeof(float) * width);
-  memset(graph->y, 0, sizeof(float) * width);
+  graph->cursor = 0;
+  size_t size = graph_storage_size(graph->storage) * width * graph->series;
+  graph->samples = malloc(size);
+  memset(graph->samples, 0, size);
+}
+
+// Converts the stored samples to a new series count and storage type. New
+// series start out empty, dropped series are discarded.
+bool graph_set_layout(struct graph* graph, uint32_t series, char storage) {
+  if (series < 1) series = 1;
+  if (graph->series == series && graph->storage == storage) return false;
+
+  if (graph->series_colors || series > 1) {
+    uint32_t colored = graph->series_colors ? graph->series : 0;
+    graph->series_colors = realloc(graph->series_colors,
+                                   sizeof(struct color) * series);
+    for (uint32_t i = colored; i < series; i++) {
+      color_init(&graph->series_colors[i], graph->line_color.hex);
+    }
+  }
+
+  if (graph->samples) {
+    size_t size = graph_storage_size(storage) * graph->width * series;
+    void* samples = malloc(size);
+    memset(samples, 0, size);
+
+    uint32_t copied = min(graph->series, series);
+    for (uint32_t i = 0; i < graph->width; i++) {
+      for (uint32_t j = 0; j < copied; j++) {
+        graph_storage_store(samples,
+                            storage,
+                            i * series + j,
+                            graph_storage_load(graph->samples,
+                                               graph->storage,
+                                               i * graph->series + j));
+      }
+    }
+    free(graph->samples);
+    graph->samples = samples;
+  }
+
+  graph->series = series;
+  graph->storage = storage;
+  return true;
+}
+
+void graph_copy(struct graph* graph, struct graph* source) {
+  if (source->series_colors) {
+    graph->series_colors = malloc(sizeof(struct color) * source->series);
+    memcpy(graph->series_colors,
+           source->series_colors,
+           sizeof(struct color) * source->series);
+  }
+
+  if (source->samples) {
+    size_t size = graph_storage_size(source->storage)
+                  * source->width
+                  * source->series;
+    graph->samples = malloc(size);
+    memcpy(graph->samples, source->samples, size);
+  }
+}
+
+// Reads the stored sample at the raw index, regardless of the cursor
+float graph_get_sample(struct graph* graph, uint32_t index) {
+  if (!graph->samples) return 0.f;
+  return graph_storage_load(graph->samples, graph->storage, index);
+}
+
+float graph_get_value(struct graph* graph, uint32_t series, uint32_t i) {
+  if (!graph->enabled || !graph->samples || series >= graph->series)
+    return 0.f;
+
+  uint32_t sample = (graph->cursor + i) % graph->width;
+  return graph_storage_load(graph->samples,
+                            graph->storage,
+                            sample * graph->series + series);
 }
 
 float graph_get_y(struct graph* graph, uint32_t i) {
-  if (!graph->enabled) return 0.f;
-  return graph->y[ (graph->cursor + i)%graph->width ];
+  return graph_get_value(graph, 0, i);
 }
 
-void graph_push_back(struct graph* graph, float y) {
-  if (!graph->enabled) return;
-  graph->y[graph->cursor] = y;
+float graph_get_value_for_age(struct graph* graph, uint32_t series, uint32_t age) {
+  struct graph_samples samples = graph_get_samples(graph);
+  return graph_samples_get_for_age(&samples, series, age);
+}
+
+void graph_push_back_series(struct graph* graph, float* values, uint32_t count) {
+  if (!graph->enabled || !graph->samples) return;
+  for (uint32_t i = 0; i < graph->series; i++) {
+    graph_storage_store(graph->samples,
+                        graph->storage,
+                        graph->cursor * graph->series + i,
+                        i < count ? values[i] : 0.f       );
+  }
 
   ++graph->cursor;
   graph->cursor %= graph->width;
+  graph->pushes++;
+}
+
+void graph_push_back(struct graph* graph, float y) {
+  graph_push_back_series(graph, &y, 1);
+}
+
+// A pushed token holds one sample, the values of multiple series are
+// separated by colons, e.g. "0.2:0.7".
+void graph_push_back_token(struct graph* graph, struct token token) {
+  float values[graph->series];
+  uint32_t count = 0;
+
+  char* cursor = token.text;
+  while (count < graph->series) {
+    char* end = NULL;
+    values[count++] = strtof(cursor, &end);
+    if (!end || *end != ':') break;
+    cursor = end + 1;
+  }
+
+  graph_push_back_series(graph, values, count);
+}
+
+// The samples are reduced to one column per device pixel of the drawn width
+// when there are more samples than pixels.
+uint32_t graph_get_columns(struct graph* graph, CGFloat scale) {
+  uint32_t pixels = graph_get_length(graph) * scale;
+  if (pixels > 0 && pixels < graph->width) return pixels;
+  return graph->width;
+}
+
+void graph_decimate(struct graph* graph, uint32_t series, uint32_t columns, uint32_t first, uint32_t count, float* low_out, float* high_out) {
+  struct graph_samples samples = graph_get_samples(graph);
+  graph_path_decimate(&samples,
+                      series,
+                      columns,
+                      first,
+                      count,
+                      low_out,
+                      high_out);
 }
 
 uint32_t graph_get_length(struct graph* graph) {
-  if (graph->enabled) return graph->width;
-  return 0;
+  if (!graph->enabled) return 0;
+  return graph->draw_width > 0 ? graph->draw_width : graph->width;
 }
 
 void graph_calculate_bounds(struct graph* graph, uint32_t x, uint32_t y, uint32_t height) {
+  graph->bounds.size.width = graph_get_length(graph);
   graph->bounds.size.height = height;
   graph->bounds.origin.x = x;
   graph->bounds.origin.y = y - graph->bounds.size.height / 2
                            + graph->line_width;
 }
 
-void graph_draw(struct graph* graph, CGContextRef context) {
-  uint32_t x =  graph->bounds.origin.x + (graph->rtl ? graph->width : 0);
-  uint32_t y = graph->bounds.origin.y;
-  uint32_t height = graph->bounds.size.height;
+// The first series uses the line and fill color of the graph, further
+// series are drawn in their own color with a translucent fill.
+static void graph_set_style(struct graph* graph, CGContextRef context, uint32_t series) {
+  if (series > 0 && graph->series_colors) {
+    struct color* color = &graph->series_colors[series];
+    CGContextSetRGBStrokeColor(context, color->r, color->g, color->b, color->a);
+    CGContextSetRGBFillColor(context,
+                             color->r,
+                             color->g,
+                             color->b,
+                             0.2 * color->a);
+    CGContextSetLineWidth(context, graph->line_width);
+    return;
+  }
 
-  uint32_t sample_width = 1;
-  bool fill = graph->fill;
-  CGContextSaveGState(context);
   CGContextSetRGBStrokeColor(context,
                              graph->line_color.r,
                              graph->line_color.g,
@@ -72,6 +233,240 @@ void graph_draw(struct graph* graph, CGContextRef context) {
                              0.2 * graph->line_color.a);
 
   CGContextSetLineWidth(context, graph->line_width);
+}
+
+// Draws the columns [first, first + count) with column 0 at x and step points
+// between columns, the columns grow towards older samples. The geometry comes
+// from graph_path_points, only the path and its paint happen here.
+static void graph_draw_columns(struct graph* graph, CGContextRef context, uint32_t series, uint32_t columns, CGFloat step, CGFloat x, CGFloat y, CGFloat height, uint32_t first, uint32_t count) {
+  if (count == 0) return;
+  struct graph_samples samples = graph_get_samples(graph);
+  struct graph_point points[2 * count + 3];
+  uint32_t stroke_count = 0;
+  uint32_t point_count = graph_path_points(&samples,
+                                           series,
+                                           columns,
+                                           graph->rtl ? -step : step,
+                                           x,
+                                           y,
+                                           height,
+                                           first,
+                                           count,
+                                           graph->fill,
+                                           points,
+                                           &stroke_count             );
+
+  CGMutablePathRef p = CGPathCreateMutable();
+  CGPathMoveToPoint(p, NULL, points[0].x, points[0].y);
+  for (uint32_t i = 1; i < stroke_count; i++)
+    CGPathAddLineToPoint(p, NULL, points[i].x, points[i].y);
+
+  CGContextAddPath(context, p);
+  CGContextStrokePath(context);
+  if (point_count > stroke_count) {
+    for (uint32_t i = stroke_count; i < point_count; i++)
+      CGPathAddLineToPoint(p, NULL, points[i].x, points[i].y);
+    CGPathCloseSubpath(p);
+    CGContextAddPath(context, p);
+    CGContextFillPath(context);
+  }
+  CGPathRelease(p);
+}
+
+static uint64_t graph_style_hash(struct graph* graph, uint32_t columns, uint32_t pixel_width, uint32_t pixel_height) {
+  uint32_t style[8 + graph->series];
+  style[0] = graph->line_color.hex;
+  style[1] = graph->fill_color.hex;
+  style[2] = graph->overrides_fill_color;
+  style[3] = graph->fill;
+  style[4] = graph->rtl;
+  style[5] = *(uint32_t*)&graph->line_width;
+  style[6] = pixel_width;
+  style[7] = pixel_height;
+  for (uint32_t i = 0; i < graph->series; i++) {
+    style[8 + i] = graph->series_colors ? graph->series_colors[i].hex : 0;
+  }
+
+  return hash_xxh64(style, sizeof(style), columns);
+}
+
+// Renders the columns [first, first + count) into the bitmap, clipped to the
+// span between the column positions from and to. The span may reach into the
+// padding on either side and is widened to whole device pixels.
+static void graph_bitmap_render(struct graph* graph, CGFloat scale, CGFloat pad, uint32_t columns, CGFloat step, uint32_t first, uint32_t count, CGFloat from, CGFloat to) {
+  struct graph_bitmap* bitmap = &graph->bitmap;
+  CGFloat x = pad + (graph->rtl ? columns * step : 0);
+  CGFloat start = graph->rtl ? x - to * step : x + from * step;
+  CGFloat end = graph->rtl ? x - from * step : x + to * step;
+  start = fmax(floor(start * scale) / scale, 0);
+  end = fmin(ceil(end * scale) / scale, bitmap->pixel_width / scale);
+  if (end <= start) return;
+
+  CGRect clip = {{ start, 0 }, { end - start, bitmap->pixel_height / scale }};
+  CGContextSaveGState(bitmap->context);
+  CGContextScaleCTM(bitmap->context, scale, scale);
+  CGContextClipToRect(bitmap->context, clip);
+  CGContextClearRect(bitmap->context, clip);
+  for (uint32_t i = 0; i < graph->series; i++) {
+    graph_set_style(graph, bitmap->context, i);
+    graph_draw_columns(graph,
+                       bitmap->context,
+                       i,
+                       columns,
+                       step,
+                       x,
+                       pad,
+                       graph->bounds.size.height,
+                       first,
+                       count                     );
+  }
+  CGContextRestoreGState(bitmap->context);
+}
+
+// Moves the rendered pixels by offset device pixels towards the older end
+// and clears the strip they vacated at the newest end.
+static void graph_bitmap_shift(struct graph* graph, uint32_t offset) {
+  struct graph_bitmap* bitmap = &graph->bitmap;
+  unsigned char* data = CGBitmapContextGetData(bitmap->context);
+  size_t bytes_per_row = CGBitmapContextGetBytesPerRow(bitmap->context);
+  uint32_t width = bitmap->pixel_width;
+  offset = min(offset, width);
+
+  for (uint32_t row = 0; row < bitmap->pixel_height; row++) {
+    uint32_t* pixels = (uint32_t*)(data + row * bytes_per_row);
+    if (graph->rtl) {
+      memmove(pixels, pixels + offset, (width - offset) * sizeof(uint32_t));
+      memset(pixels + width - offset, 0, offset * sizeof(uint32_t));
+    } else {
+      memmove(pixels + offset, pixels, (width - offset) * sizeof(uint32_t));
+      memset(pixels, 0, offset * sizeof(uint32_t));
+    }
+  }
+}
+
+static bool graph_draw_incremental(struct graph* graph, CGContextRef context, CGFloat scale, uint32_t columns, CGFloat step) {
+  if (scale < 1.f || fabs(scale - round(scale)) > 0.01f) return false;
+  scale = round(scale);
+
+  CGFloat pad = ceil(graph->line_width) + 1;
+  uint32_t pixel_width = (graph_get_length(graph) + 2 * pad) * scale;
+  uint32_t pixel_height = (graph->bounds.size.height + 2 * pad) * scale;
+  uint64_t style = graph_style_hash(graph, columns, pixel_width, pixel_height);
+
+  struct graph_bitmap* bitmap = &graph->bitmap;
+  pthread_mutex_lock(&bitmap->mutex);
+  if (!bitmap->context
+      || bitmap->pixel_width != pixel_width
+      || bitmap->pixel_height != pixel_height) {
+    if (bitmap->context) CGContextRelease(bitmap->context);
+    CGColorSpaceRef color_space = CGColorSpaceCreateDeviceRGB();
+    bitmap->context = CGBitmapContextCreate(NULL,
+                                            pixel_width,
+                                            pixel_height,
+                                            8,
+                                            pixel_width * 4,
+                                            color_space,
+                                            kCGImageAlphaPremultipliedFirst
+                                            | kCGBitmapByteOrder32Little  );
+    CGColorSpaceRelease(color_space);
+    bitmap->pixel_width = pixel_width;
+    bitmap->pixel_height = pixel_height;
+    bitmap->style = 0;
+
+    if (!bitmap->context) {
+      pthread_mutex_unlock(&bitmap->mutex);
+      return false;
+    }
+  }
+
+  // Only whole device pixels can be shifted, and decimated columns change
+  // with every sample. The stroke of a column reaches into its neighbours,
+  // hence the columns within reach of a redrawn span are drawn along with
+  // it: next to the new samples and at the old end, where the path now
+  // ends earlier.
+  CGFloat column_pixels = step * scale;
+  bool shiftable = columns == graph->width
+                   && fabs(column_pixels - round(column_pixels)) < 0.01f;
+  uint32_t reach = ceil(pad / step) + 1;
+  uint64_t new_samples = graph->pushes - bitmap->pushes;
+
+  if (bitmap->style != style
+      || !shiftable
+      || new_samples + 4 * reach >= columns) {
+    graph_bitmap_render(graph, scale, pad, columns, step, 0, columns,
+                                                          -INFINITY,
+                                                          INFINITY  );
+  } else if (new_samples > 0) {
+    graph_bitmap_shift(graph, new_samples * round(column_pixels));
+    graph_bitmap_render(graph, scale, pad, columns, step,
+                        0,
+                        new_samples + 2 * reach,
+                        -INFINITY,
+                        new_samples + reach     );
+
+    graph_bitmap_render(graph, scale, pad, columns, step,
+                        columns - 2 * reach,
+                        2 * reach,
+                        columns - reach,
+                        INFINITY            );
+  }
+  bitmap->style = style;
+  bitmap->pushes = graph->pushes;
+
+  CGImageRef image = CGBitmapContextCreateImage(bitmap->context);
+  pthread_mutex_unlock(&bitmap->mutex);
+  if (!image) return false;
+
+  CGContextDrawImage(context,
+                     CGRectMake(graph->bounds.origin.x - pad,
+                                graph->bounds.origin.y - pad,
+                                pixel_width / scale,
+                                pixel_height / scale         ),
+                     image                                    );
+  CGImageRelease(image);
+  return true;
+}
+
+void graph_draw(struct graph* graph, CGContextRef context) {
+  CGSize unit = CGContextConvertSizeToDeviceSpace(context, CGSizeMake(1, 1));
+  CGFloat scale = fmax(fabs(unit.width), 1.f);
+  uint32_t columns = graph_get_columns(graph, scale);
+  if (columns == 0) return;
+
+  CGFloat step = (CGFloat)graph_get_length(graph) / columns;
+  if (graph->incremental
+      && graph_draw_incremental(graph, context, scale, columns, step)) {
+    return;
+  }
+
+  if (columns < graph->width || graph->series > 1 || step != 1.f) {
+    CGContextSaveGState(context);
+    for (uint32_t i = 0; i < graph->series; i++) {
+      graph_set_style(graph, context, i);
+      graph_draw_columns(graph,
+                         context,
+                         i,
+                         columns,
+                         step,
+                         graph->bounds.origin.x
+                         + (graph->rtl ? columns * step : 0),
+                         graph->bounds.origin.y,
+                         graph->bounds.size.height,
+                         0,
+                         columns                           );
+    }
+    CGContextRestoreGState(context);
+    return;
+  }
+
+  uint32_t x =  graph->bounds.origin.x + (graph->rtl ? graph->width : 0);
+  uint32_t y = graph->bounds.origin.y;
+  uint32_t height = graph->bounds.size.height;
+
+  uint32_t sample_width = 1;
+  bool fill = graph->fill;
+  CGContextSaveGState(context);
+  graph_set_style(graph, context, 0);
   CGMutablePathRef p = CGPathCreateMutable();
   uint32_t start_x = x;
   if (graph->rtl) {
@@ -108,26 +503,96 @@ void graph_draw(struct graph* graph, CGContextRef context) {
   CGContextRestoreGState(context);
 }
 
+char* graph_storage_name(char storage) {
+  switch (storage) {
+    case GRAPH_STORAGE_UINT8: return "uint8";
+    case GRAPH_STORAGE_UINT16: return "uint16";
+    default: return "float";
+  }
+}
+
+// Assigns a comma separated list of colors to the series in order, the
+// first entry is also the line color of the graph.
+static bool graph_set_colors(struct graph* graph, struct token token) {
+  if (!graph->series_colors) {
+    graph->series_colors = malloc(sizeof(struct color) * graph->series);
+    for (uint32_t i = 0; i < graph->series; i++) {
+      color_init(&graph->series_colors[i], graph->line_color.hex);
+    }
+  }
+
+  bool changed = false;
+  char* cursor = token.text;
+  for (uint32_t i = 0; i < graph->series && cursor && *cursor; i++) {
+    char* end = NULL;
+    uint32_t hex = strtoul(cursor, &end, 0);
+    if (end == cursor) break;
+
+    changed |= color_set_hex(&graph->series_colors[i], hex);
+    if (i == 0) changed |= color_set_hex(&graph->line_color, hex);
+    cursor = *end == ',' ? end + 1 : NULL;
+  }
+  return changed;
+}
+
 void graph_serialize(struct graph* graph, char* indent, FILE* rsp) {
     fprintf(rsp, "%s\"color\": \"0x%x\",\n"
                  "%s\"fill_color\": \"0x%x\",\n"
                  "%s\"line_width\": \"%f\",\n"
-                 "%s\"data\": [\n",
+                 "%s\"width\": %u,\n"
+                 "%s\"incremental\": \"%s\",\n"
+                 "%s\"series\": %u,\n"
+                 "%s\"storage\": \"%s\",\n",
                  indent, graph->line_color.hex,
                  indent, graph->fill_color.hex,
-                 indent, graph->line_width, indent);
+                 indent, graph->line_width,
+                 indent, graph_get_length(graph),
+                 indent, format_bool(graph->incremental),
+                 indent, graph->series,
+                 indent, graph_storage_name(graph->storage));
+
+    if (graph->series_colors) {
+      fprintf(rsp, "%s\"colors\": [ ", indent);
+      for (uint32_t i = 0; i < graph->series; i++) {
+        fprintf(rsp, "%s\"0x%x\"", i > 0 ? ", " : "",
+                                   graph->series_colors[i].hex);
+      }
+      fprintf(rsp, " ],\n");
+    }
+
+    fprintf(rsp, "%s\"data\": [\n", indent);
     int counter = 0;
-    for (int i = 0; i < graph->width; i++) {
+    for (int i = 0; i < graph->width && graph->samples; i++) {
       if (counter++ > 0) fprintf(rsp, ",\n");
-      fprintf(rsp, "%s\t\"%f\"", indent, graph->y[i]);
+      if (graph->series == 1) {
+        fprintf(rsp, "%s\t\"%f\"",
+                     indent,
+                     graph_get_sample(graph, i));
+        continue;
+      }
+
+      fprintf(rsp, "%s\t[ ", indent);
+      for (uint32_t j = 0; j < graph->series; j++) {
+        fprintf(rsp, "%s\"%f\"",
+                     j > 0 ? ", " : "",
+                     graph_get_sample(graph, i * graph->series + j));
+      }
+      fprintf(rsp, " ]");
     }
     fprintf(rsp, "\n%s]", indent);
 }
 
 void graph_destroy(struct graph* graph) {
+  if (graph->bitmap.context) CGContextRelease(graph->bitmap.context);
+  graph->bitmap.context = NULL;
+  pthread_mutex_destroy(&graph->bitmap.mutex);
+
+  if (graph->series_colors) free(graph->series_colors);
+  graph->series_colors = NULL;
+
   if (!graph->enabled) return;
-  if (graph->y) free(graph->y);
-  graph->y = NULL;
+  if (graph->samples) free(graph->samples);
+  graph->samples = NULL;
 }
 
 bool graph_parse_sub_domain(struct graph* graph, FILE* rsp, struct token property, char* message) {
@@ -141,7 +606,38 @@ bool graph_parse_sub_domain(struct graph* graph, FILE* rsp, struct token propert
   } else if (token_equals(property, PROPERTY_LINE_WIDTH)) {
     graph->line_width = token_to_float(get_token(&message));
     return true;
-  } 
+  } else if (token_equals(property, PROPERTY_WIDTH)) {
+    uint32_t draw_width = token_to_uint32t(get_token(&message));
+    if (graph->draw_width == draw_width) return false;
+    graph->draw_width = draw_width;
+    return true;
+  } else if (token_equals(property, PROPERTY_INCREMENTAL)) {
+    bool incremental = evaluate_boolean_state(get_token(&message),
+                                              graph->incremental  );
+    if (graph->incremental == incremental) return false;
+    graph->incremental = incremental;
+    return true;
+  } else if (token_equals(property, PROPERTY_SERIES)) {
+    uint32_t series = token_to_uint32t(get_token(&message));
+    if (series < 1 || series > GRAPH_MAX_SERIES) {
+      respond(rsp, "[!] Graph: Invalid series count '%u'\n", series);
+      return false;
+    }
+    return graph_set_layout(graph, series, graph->storage);
+  } else if (token_equals(property, PROPERTY_STORAGE)) {
+    struct token token = get_token(&message);
+    char storage;
+    if (token_equals(token, "float")) storage = GRAPH_STORAGE_FLOAT;
+    else if (token_equals(token, "uint16")) storage = GRAPH_STORAGE_UINT16;
+    else if (token_equals(token, "uint8")) storage = GRAPH_STORAGE_UINT8;
+    else {
+      respond(rsp, "[!] Graph: Invalid storage '%s'\n", token.text);
+      return false;
+    }
+    return graph_set_layout(graph, graph->series, storage);
+  } else if (token_equals(property, PROPERTY_COLORS)) {
+    return graph_set_colors(graph, get_token(&message));
+  }
   else {
     struct key_value_pair key_value_pair = get_key_value_pair(property.text,
                                                               '.'           );
@@ -1,32 +1,71 @@
 #pragma once
+#include <pthread.h>
 #include "misc/helpers.h"
 #include "color.h"
+#include "graph_path.h"
+
+#define GRAPH_MAX_SERIES     16
+
+// Device pixels of the last incremental render. New samples shift the
+// previous pixels along the time axis and only the new columns are drawn.
+struct graph_bitmap {
+  pthread_mutex_t mutex;
+  CGContextRef context;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint64_t pushes;
+  uint64_t style;
+};
 
 struct graph {
   bool rtl;
   bool fill;
   bool enabled;
   bool overrides_fill_color;
+  bool incremental;
 
-  float* y;
+  // Samples are stored column-major, all series of a sample are adjacent.
+  // Quantized storage keeps values in [0, 1] as 8 or 16 bit fractions.
+  void* samples;
+  char storage;
+  uint32_t series;
+  struct color* series_colors;
+
+  // The graph is draw_width points wide, or one point per sample if it is
+  // not set. Samples beyond the device pixels of that width are decimated.
   uint32_t width;
+  uint32_t draw_width;
   uint32_t cursor;
+  uint64_t pushes;
   float line_width;
 
   CGRect bounds;
   struct color line_color;
   struct color fill_color;
+
+  struct graph_bitmap bitmap;
 };
 
 void graph_init(struct graph* graph);
 void graph_setup(struct graph* graph, uint32_t width);
+bool graph_set_layout(struct graph* graph, uint32_t series, char storage);
 void graph_push_back(struct graph* graph, float y);
+void graph_push_back_series(struct graph* graph, float* values, uint32_t count);
+void graph_push_back_token(struct graph* graph, struct token token);
 float graph_get_y(struct graph* graph, uint32_t i);
+float graph_get_sample(struct graph* graph, uint32_t index);
+float graph_get_value(struct graph* graph, uint32_t series, uint32_t i);
+float graph_get_value_for_age(struct graph* graph, uint32_t series, uint32_t age);
+uint32_t graph_get_columns(struct graph* graph, CGFloat scale);
+void graph_decimate(struct graph* graph, uint32_t series, uint32_t columns, uint32_t first, uint32_t count, float* low_out, float* high_out);
 uint32_t graph_get_length(struct graph* graph);
+void graph_copy(struct graph* graph, struct graph* source);
+void graph_clear_pointers(struct graph* graph);
 
 void graph_calculate_bounds(struct graph* graph, uint32_t x, uint32_t y, uint32_t height);
 void graph_draw(struct graph* graph, CGContextRef context);
 void graph_destroy(struct graph* graph);
 
+char* graph_storage_name(char storage);
 void graph_serialize(struct graph* graph, char* indent, FILE* rsp);
 bool graph_parse_sub_domain(struct graph* graph, FILE* rsp, struct token property, char* message);
@@ -0,0 +1,104 @@
+#include "graph_path.h"
+
+size_t graph_storage_size(char storage) {
+  switch (storage) {
+    case GRAPH_STORAGE_UINT8: return sizeof(uint8_t);
+    case GRAPH_STORAGE_UINT16: return sizeof(uint16_t);
+    default: return sizeof(float);
+  }
+}
+
+static float graph_storage_clamp(float value) {
+  if (value < 0.f) return 0.f;
+  if (value > 1.f) return 1.f;
+  return value;
+}
+
+float graph_storage_load(void* data, char storage, uint32_t index) {
+  switch (storage) {
+    case GRAPH_STORAGE_UINT8:
+      return ((uint8_t*)data)[index] / (float)UINT8_MAX;
+    case GRAPH_STORAGE_UINT16:
+      return ((uint16_t*)data)[index] / (float)UINT16_MAX;
+    default:
+      return ((float*)data)[index];
+  }
+}
+
+void graph_storage_store(void* data, char storage, uint32_t index, float value) {
+  switch (storage) {
+    case GRAPH_STORAGE_UINT8:
+      ((uint8_t*)data)[index] = graph_storage_clamp(value) * UINT8_MAX + 0.5f;
+      break;
+    case GRAPH_STORAGE_UINT16:
+      ((uint16_t*)data)[index] = graph_storage_clamp(value) * UINT16_MAX
+                                 + 0.5f;
+      break;
+    default:
+      ((float*)data)[index] = value;
+      break;
+  }
+}
+
+float graph_samples_get_for_age(struct graph_samples* samples, uint32_t series, uint32_t age) {
+  if (!samples->data || series >= samples->series) return 0.f;
+  uint32_t sample = (samples->cursor + samples->width - 1 - age)
+                    % samples->width;
+  return graph_storage_load(samples->data,
+                            samples->storage,
+                            sample * samples->series + series);
+}
+
+// Reduces the samples to the minimum and maximum value of each column,
+// starting with the column of the newest sample.
+void graph_path_decimate(struct graph_samples* samples, uint32_t series, uint32_t columns, uint32_t first, uint32_t count, float* low_out, float* high_out) {
+  uint32_t width = samples->width;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t column = first + i;
+    uint32_t begin = (uint64_t)column * width / columns;
+    uint32_t end = (uint64_t)(column + 1) * width / columns;
+    if (end <= begin) end = begin + 1;
+
+    float low = graph_samples_get_for_age(samples, series, begin);
+    float high = low;
+    for (uint32_t age = begin + 1; age < end && age < width; age++) {
+      float y = graph_samples_get_for_age(samples, series, age);
+      if (y < low) low = y;
+      if (y > high) high = y;
+    }
+    low_out[i] = low;
+    high_out[i] = high;
+  }
+}
+
+// Lays out the columns [first, first + count) with column 0 at x and
+// direction points between columns. Decimated columns contribute their
+// maximum and minimum such that peaks survive the reduction. The first
+// stroke_count points are the line, a filled graph continues with two
+// points on the baseline that close the area. points holds 2 * count + 3
+// points, the number of points written is returned.
+uint32_t graph_path_points(struct graph_samples* samples, uint32_t series, uint32_t columns, double direction, double x, double y, double height, uint32_t first, uint32_t count, bool fill, struct graph_point* points, uint32_t* stroke_count) {
+  *stroke_count = 0;
+  if (count == 0) return 0;
+  float low[count];
+  float high[count];
+  graph_path_decimate(samples, series, columns, first, count, low, high);
+
+  uint32_t n = 0;
+  points[n++] = (struct graph_point){ x + direction * first,
+                                      y + high[0] * height   };
+  for (uint32_t i = 0; i < count; i++) {
+    double column_x = x + direction * (first + i);
+    points[n++] = (struct graph_point){ column_x, y + high[i] * height };
+    if (low[i] != high[i])
+      points[n++] = (struct graph_point){ column_x, y + low[i] * height };
+  }
+  *stroke_count = n;
+
+  if (fill) {
+    points[n++] = (struct graph_point){ x + direction * (first + count - 1),
+                                        y                                   };
+    points[n++] = (struct graph_point){ x + direction * first, y };
+  }
+  return n;
+}
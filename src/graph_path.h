@@ -0,0 +1,32 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GRAPH_STORAGE_FLOAT  'f'
+#define GRAPH_STORAGE_UINT16 's'
+#define GRAPH_STORAGE_UINT8  'b'
+
+// The sample ring of a graph without any of its drawing state, such that the
+// column reduction and the path geometry build without CoreGraphics. Samples
+// are stored column-major, all series of a sample are adjacent.
+struct graph_samples {
+  void* data;
+  char storage;
+  uint32_t width;
+  uint32_t series;
+  uint32_t cursor;
+};
+
+struct graph_point {
+  double x;
+  double y;
+};
+
+size_t graph_storage_size(char storage);
+float graph_storage_load(void* data, char storage, uint32_t index);
+void graph_storage_store(void* data, char storage, uint32_t index, float value);
+
+float graph_samples_get_for_age(struct graph_samples* samples, uint32_t series, uint32_t age);
+void graph_path_decimate(struct graph_samples* samples, uint32_t series, uint32_t columns, uint32_t first, uint32_t count, float* low_out, float* high_out);
+uint32_t graph_path_points(struct graph_samples* samples, uint32_t series, uint32_t columns, double direction, double x, double y, double height, uint32_t first, uint32_t count, bool fill, struct graph_point* points, uint32_t* stroke_count);
@@ -1,5 +1,11 @@
 #include "group.h"
 #include "bar.h"
+#include "bar_manager.h"
+
+struct bar_item* group_get_member(struct group* group, uint32_t index) {
+  if (index >= group->num_members) return NULL;
+  return bar_manager_get_item(&g_bar_manager, group->members[index]);
+}
 
 static struct bar_item* group_get_first_member(struct group* group, struct bar* bar) {
   if (group->num_members == 1) return NULL;
@@ -8,8 +14,8 @@ static struct bar_item* group_get_first_member(struct group* group, struct bar*
   struct bar_item* first_item = NULL;
 
   for (int i = 1; i < group->num_members; i++) {
-    struct bar_item* member = group->members[i];
-    if (bar_draws_item(bar, member)) {
+    struct bar_item* member = group_get_member(group, i);
+    if (member && bar_draws_item(bar, member)) {
       struct window* window = bar_item_get_window(member, bar->adid);
       if (window->origin.x < min) {
         min = window->origin.x;
@@ -28,8 +34,8 @@ static struct bar_item* group_get_last_member(struct group* group, struct bar* b
   struct bar_item* last_item = NULL;
 
   for (int i = 1; i < group->num_members; i++) {
-    struct bar_item* member = group->members[i];
-    if (bar_draws_item(bar, member)) {
+    struct bar_item* member = group_get_member(group, i);
+    if (member && bar_draws_item(bar, member)) {
       struct window* window = bar_item_get_window(member, bar->adid);
       if (window->origin.x + window->frame.size.width > max) {
         max = window->origin.x + window->frame.size.width;
@@ -54,22 +60,24 @@ void group_init(struct group* group) {
 
 bool group_is_item_member(struct group* group, struct bar_item* item) {
   for (uint32_t i = 0; i < group->num_members; i++) {
-    if (group->members[i] == item) return true;
+    if (group->members[i] == item->handle) return true;
   }
   return false;
 }
 
 void group_add_member(struct group* group, struct bar_item* item) {
   if (group_is_item_member(group, item)) return;
-  if (item->group && item->group->members && item->group->members[0] == item) {
+  if (item->group && item->group->members
+      && item->group->members[0] == item->handle) {
     for (int i = 1; i < item->group->num_members; i++) {
-      group_add_member(group, item->group->members[i]);
+      struct bar_item* member = group_get_member(item->group, i);
+      if (member) group_add_member(group, member);
     }
   } else {
     group->num_members++;
     group->members = realloc(group->members,
-                             sizeof(struct bar_item*)*group->num_members);
-    group->members[group->num_members - 1] = item;
+                             sizeof(item_handle)*group->num_members);
+    group->members[group->num_members - 1] = item->handle;
     item->group = group;
   }
 }
@@ -77,8 +85,8 @@ void group_add_member(struct group* group, struct bar_item* item) {
 uint32_t group_get_length(struct group* group, struct bar* bar) {
   int len = group->last_window->origin.x
             + group->last_window->frame.size.width
-            + group->last_item->background.padding_right
-            + group->first_item->background.padding_left
+            + group->last_item->background.style->padding_right
+            + group->first_item->background.style->padding_left
             - group->first_window->origin.x;
 
   return max(len, 0);
@@ -86,21 +94,20 @@ uint32_t group_get_length(struct group* group, struct bar* bar) {
 
 void group_remove_member(struct group* group, struct bar_item* bar_item) {
   if (group->num_members <= 0) return;
-  struct bar_item* tmp[group->num_members - 1];
-  int count = 0;
+  uint32_t count = 0;
   for (int i = 0; i < group->num_members; i++) {
-    if (group->members[i] == bar_item) continue;
-    tmp[count++] = group->members[i];
+    if (group->members[i] == bar_item->handle) continue;
+    group->members[count++] = group->members[i];
   }
-  group->num_members--;
+  group->num_members = count;
   group->members = realloc(group->members,
-                           sizeof(struct bar_item*)*group->num_members);
-  memcpy(group->members, tmp, sizeof(struct bar_item*)*group->num_members);
+                           sizeof(item_handle)*group->num_members);
 }
 
 void group_destroy(struct group* group) {
   for (int i = 0; i < group->num_members; i++) {
-    group->members[i]->group = NULL;
+    struct bar_item* member = group_get_member(group, i);
+    if (member && member->group == group) member->group = NULL;
   }
   if (group->members) free(group->members);
   free(group);
@@ -118,31 +125,35 @@ void group_calculate_bounds(struct group* group, struct bar* bar, uint32_t y) {
     return;
   }
 
+  struct bar_item* bracket = group_get_member(group, 0);
+  if (!bracket) return;
+
   uint32_t group_length = group_get_length(group, bar);
-  CGPoint shadow_offsets = bar_item_calculate_shadow_offsets(group->members[0]);
-  
+  CGPoint shadow_offsets = bar_item_calculate_shadow_offsets(bracket);
+
 
   group->bounds = (CGRect){{group->first_window->origin.x
-                            - group->first_item->background.padding_left,
+                            - group->first_item->background.style->padding_left,
                             group->first_window->origin.y},
                            {group_length
                             + shadow_offsets.x
                             + shadow_offsets.y,
                            group->first_window->frame.size.height}};
   
-  background_calculate_bounds(&group->members[0]->background,
+  background_calculate_bounds(&bracket->background,
                               max(shadow_offsets.x, 0),
-                              y + group->members[0]->y_offset,
+                              y + bracket->y_offset,
                               group_get_length(group, bar),
-                              group->members[0]->background.bounds.size.height);
+                              bracket->background.bounds.size.height);
 }
 
 void group_serialize(struct group* group, char* indent, FILE* rsp) {
     int counter = 0;
     for (int i = 1; i < group->num_members; i++) {
-      if (!group->members[i]) continue;
+      struct bar_item* member = group_get_member(group, i);
+      if (!member) continue;
       if (counter++ > 0) fprintf(rsp, ",\n");
-      fprintf(rsp, "%s\"%s\"", indent, group->members[i]->name);
+      fprintf(rsp, "%s\"%s\"", indent, member->name);
     }
 }
 
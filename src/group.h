@@ -1,4 +1,5 @@
 #pragma once
+#include "item_store.h"
 #include "bar_item.h"
 
 struct bar;
@@ -13,12 +14,13 @@ struct group {
   struct bar_item* last_item;
 
   uint32_t num_members;
-  struct bar_item** members;
+  item_handle* members;
 };
 
 struct group* group_create();
 void group_init(struct group* group);
 void group_set_name(struct group* group, char* _name);
+struct bar_item* group_get_member(struct group* group, uint32_t index);
 void group_add_member(struct group* group, struct bar_item* item);
 void group_remove_member(struct group* group, struct bar_item* bar_item);
 uint32_t group_get_length(struct group* group, struct bar* bar);
@@ -0,0 +1,253 @@
+#include "hit_index.h"
+#include "bar_item.h"
+
+void hit_index_init(struct hit_index* hit_index) {
+  memset(hit_index, 0, sizeof(struct hit_index));
+}
+
+static int hit_interval_compare(const void* a, const void* b) {
+  const struct hit_interval* interval_a = a;
+  const struct hit_interval* interval_b = b;
+  if (interval_a->start < interval_b->start) return -1;
+  if (interval_a->start > interval_b->start) return 1;
+  return (int)interval_a->order - (int)interval_b->order;
+}
+
+static void hit_interval_set_frame(struct hit_interval* interval, bool vertical) {
+  struct window* window = interval->window;
+  interval->start = vertical ? window->origin.y : window->origin.x;
+  interval->end = interval->start + (vertical
+                                     ? window->frame.size.height
+                                     : window->frame.size.width );
+  interval->reach = interval->end;
+}
+
+// The reach of an interval is turned into the furthest reach of all
+// intervals starting before it, such that a backwards scan can stop early.
+static void hit_index_accumulate_reach(struct hit_index* hit_index) {
+  for (uint32_t i = 1; i < hit_index->interval_count; i++) {
+    hit_index->intervals[i].reach = max(hit_index->intervals[i].end,
+                                        hit_index->intervals[i - 1].reach);
+  }
+}
+
+static uint32_t hit_index_hash(uint32_t wid, uint32_t slot_count) {
+  return (wid * 2654435761u) & (slot_count - 1);
+}
+
+static void hit_index_insert_wid(struct hit_index* hit_index, uint32_t wid, struct bar_item* bar_item, struct window* window) {
+  uint32_t slot = hit_index_hash(wid, hit_index->slot_count);
+  while (hit_index->slots[slot].wid) {
+    if (hit_index->slots[slot].wid == wid) return;
+    slot = (slot + 1) & (hit_index->slot_count - 1);
+  }
+
+  hit_index->slots[slot].wid = wid;
+  hit_index->slots[slot].bar_item = bar_item;
+  hit_index->slots[slot].window = window;
+}
+
+bool hit_index_is_current(struct hit_index* hit_index, bool vertical, uint64_t generation) {
+  return hit_index->built
+         && hit_index->vertical == vertical
+         && hit_index->generation == generation;
+}
+
+// Brackets span the windows of their members and popup items are stacked
+// across the bar axis, neither is a good fit for the sorted scan.
+static bool hit_index_is_wide(struct bar_item* bar_item) {
+  return bar_item->type == BAR_COMPONENT_GROUP || bar_item->parent;
+}
+
+void hit_index_build(struct hit_index* hit_index, struct bar_item** bar_items, uint32_t bar_item_count, bool vertical, uint64_t generation, uint64_t moves) {
+  uint32_t window_count = 0;
+  uint32_t wide_count = 0;
+  uint32_t popup_count = 0;
+  uint32_t stride = 1;
+  for (uint32_t i = 0; i < bar_item_count; i++) {
+    window_count += bar_items[i]->num_windows;
+    if (hit_index_is_wide(bar_items[i]))
+      wide_count += bar_items[i]->num_windows;
+    stride = max(stride, bar_items[i]->num_windows);
+    if (bar_items[i]->popup.drawing) popup_count++;
+  }
+
+  hit_index->intervals = realloc(hit_index->intervals,
+                                 sizeof(struct hit_interval)
+                                 * max(window_count - wide_count, 1));
+  hit_index->wide = realloc(hit_index->wide,
+                            sizeof(struct hit_interval)
+                            * max(wide_count, 1)       );
+
+  uint32_t slot_count = 16;
+  while (slot_count < 2 * window_count) slot_count <<= 1;
+  if (slot_count != hit_index->slot_count) {
+    hit_index->slots = realloc(hit_index->slots,
+                               sizeof(struct hit_slot) * slot_count);
+    hit_index->slot_count = slot_count;
+  }
+  memset(hit_index->slots, 0, sizeof(struct hit_slot) * slot_count);
+
+  hit_index->popups = realloc(hit_index->popups,
+                              sizeof(struct popup*) * max(popup_count, 1));
+
+  hit_index->interval_count = 0;
+  hit_index->wide_count = 0;
+  hit_index->popup_count = 0;
+  for (uint32_t i = 0; i < bar_item_count; i++) {
+    struct bar_item* bar_item = bar_items[i];
+    if (bar_item->popup.drawing)
+      hit_index->popups[hit_index->popup_count++] = &bar_item->popup;
+
+    for (uint32_t j = 0; j < bar_item->num_windows; j++) {
+      struct window* window = bar_item->windows[j];
+      if (!window) continue;
+
+      struct hit_interval* interval = hit_index_is_wide(bar_item)
+                        ? &hit_index->wide[hit_index->wide_count++]
+                        : &hit_index->intervals[hit_index->interval_count++];
+
+      interval->order = i * stride + j;
+      interval->bar_item = bar_item;
+      interval->window = window;
+      hit_interval_set_frame(interval, vertical);
+
+      if (window->id) hit_index_insert_wid(hit_index, window->id,
+                                                      bar_item,
+                                                      window     );
+    }
+  }
+
+  qsort(hit_index->intervals,
+        hit_index->interval_count,
+        sizeof(struct hit_interval),
+        hit_interval_compare        );
+
+  hit_index_accumulate_reach(hit_index);
+
+  hit_index->vertical = vertical;
+  hit_index->generation = generation;
+  hit_index->moves = moves;
+  hit_index->built = true;
+}
+
+// Refreshes the intervals from the frames of their windows, the set of
+// windows is unchanged. Moved windows mostly keep their place in the sorted
+// order, hence an insertion sort restores it in close to linear time.
+void hit_index_update_frames(struct hit_index* hit_index, uint64_t moves) {
+  if (hit_index->moves == moves) return;
+
+  for (uint32_t i = 0; i < hit_index->wide_count; i++)
+    hit_interval_set_frame(&hit_index->wide[i], hit_index->vertical);
+
+  struct hit_interval* intervals = hit_index->intervals;
+  for (uint32_t i = 0; i < hit_index->interval_count; i++) {
+    hit_interval_set_frame(&intervals[i], hit_index->vertical);
+
+    struct hit_interval interval = intervals[i];
+    uint32_t j = i;
+    while (j > 0 && hit_interval_compare(&intervals[j - 1], &interval) > 0) {
+      intervals[j] = intervals[j - 1];
+      j--;
+    }
+    intervals[j] = interval;
+  }
+
+  hit_index_accumulate_reach(hit_index);
+  hit_index->moves = moves;
+}
+
+struct bar_item* hit_index_item_at_point(struct hit_index* hit_index, CGPoint point, struct window** window_out) {
+  CGFloat position = hit_index->vertical ? point.y : point.x;
+
+  uint32_t low = 0;
+  uint32_t high = hit_index->interval_count;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (hit_index->intervals[mid].start <= position) low = mid + 1;
+    else high = mid;
+  }
+
+  struct hit_interval* hit = NULL;
+  for (int i = (int)low - 1; i >= 0; i--) {
+    struct hit_interval* interval = &hit_index->intervals[i];
+    if (interval->reach < position) break;
+    if (hit && interval->order > hit->order) continue;
+    if (!interval->bar_item->drawing) continue;
+
+    CGRect frame = interval->window->frame;
+    frame.origin = interval->window->origin;
+    if (cgrect_contains_point(&frame, &point)) hit = interval;
+  }
+
+  for (uint32_t i = 0; i < hit_index->wide_count; i++) {
+    struct hit_interval* interval = &hit_index->wide[i];
+    if (position < interval->start || position > interval->end) continue;
+    if (hit && interval->order > hit->order) continue;
+    if (!interval->bar_item->drawing) continue;
+
+    CGRect frame = interval->window->frame;
+    frame.origin = interval->window->origin;
+    if (cgrect_contains_point(&frame, &point)) hit = interval;
+  }
+
+  if (!hit) return NULL;
+  if (window_out) *window_out = hit->window;
+  return hit->bar_item;
+}
+
+struct bar_item* hit_index_item_for_wid(struct hit_index* hit_index, uint32_t wid, struct window** window_out) {
+  if (!wid) return NULL;
+
+  uint32_t slot = hit_index_hash(wid, hit_index->slot_count);
+  while (hit_index->slots[slot].wid) {
+    if (hit_index->slots[slot].wid == wid) {
+      if (!hit_index->slots[slot].bar_item->drawing) return NULL;
+      if (window_out) *window_out = hit_index->slots[slot].window;
+      return hit_index->slots[slot].bar_item;
+    }
+    slot = (slot + 1) & (hit_index->slot_count - 1);
+  }
+  return NULL;
+}
+
+static bool hit_index_popup_is_open(struct popup* popup) {
+  return popup->drawing && popup->host && popup->host->drawing;
+}
+
+struct popup* hit_index_popup_at_point(struct hit_index* hit_index, CGPoint point) {
+  for (uint32_t i = 0; i < hit_index->popup_count; i++) {
+    struct popup* popup = hit_index->popups[i];
+    if (!hit_index_popup_is_open(popup)) continue;
+
+    CGRect frame = popup->window.frame;
+    frame.origin = popup->window.origin;
+    if (CGRectContainsPoint(frame, point)) return popup;
+  }
+  return NULL;
+}
+
+struct popup* hit_index_popup_for_wid(struct hit_index* hit_index, uint32_t wid) {
+  for (uint32_t i = 0; i < hit_index->popup_count; i++) {
+    struct popup* popup = hit_index->popups[i];
+    if (hit_index_popup_is_open(popup) && popup->window.id == wid)
+      return popup;
+  }
+  return NULL;
+}
+
+bool hit_index_mouse_over_any_popup(struct hit_index* hit_index) {
+  for (uint32_t i = 0; i < hit_index->popup_count; i++) {
+    struct popup* popup = hit_index->popups[i];
+    if (hit_index_popup_is_open(popup) && popup->mouse_over) return true;
+  }
+  return false;
+}
+
+void hit_index_destroy(struct hit_index* hit_index) {
+  if (hit_index->intervals) free(hit_index->intervals);
+  if (hit_index->wide) free(hit_index->wide);
+  if (hit_index->slots) free(hit_index->slots);
+  if (hit_index->popups) free(hit_index->popups);
+  hit_index_init(hit_index);
+}
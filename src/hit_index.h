@@ -0,0 +1,60 @@
+#pragma once
+#include "misc/helpers.h"
+
+struct bar_item;
+struct window;
+struct popup;
+
+struct hit_interval {
+  CGFloat start;
+  CGFloat end;
+  CGFloat reach;
+  uint32_t order;
+  struct bar_item* bar_item;
+  struct window* window;
+};
+
+struct hit_slot {
+  uint32_t wid;
+  struct bar_item* bar_item;
+  struct window* window;
+};
+
+// Lookup structures for the mouse event handlers. The item windows are kept
+// sorted along the bar axis and mapped by their window id, the open popups
+// are collected in item order. Brackets and popup items overlap the windows
+// of other items, they are kept apart in the wide list such that they do not
+// stretch the scan over the sorted intervals. The index is rebuilt whenever
+// the window generation changed since the last build, moved windows only
+// have their interval refreshed in place.
+struct hit_index {
+  bool built;
+  bool vertical;
+  uint64_t generation;
+  uint64_t moves;
+
+  struct hit_interval* intervals;
+  uint32_t interval_count;
+
+  struct hit_interval* wide;
+  uint32_t wide_count;
+
+  struct hit_slot* slots;
+  uint32_t slot_count;
+
+  struct popup** popups;
+  uint32_t popup_count;
+};
+
+void hit_index_init(struct hit_index* hit_index);
+void hit_index_build(struct hit_index* hit_index, struct bar_item** bar_items, uint32_t bar_item_count, bool vertical, uint64_t generation, uint64_t moves);
+bool hit_index_is_current(struct hit_index* hit_index, bool vertical, uint64_t generation);
+void hit_index_update_frames(struct hit_index* hit_index, uint64_t moves);
+
+struct bar_item* hit_index_item_at_point(struct hit_index* hit_index, CGPoint point, struct window** window_out);
+struct bar_item* hit_index_item_for_wid(struct hit_index* hit_index, uint32_t wid, struct window** window_out);
+struct popup* hit_index_popup_at_point(struct hit_index* hit_index, CGPoint point);
+struct popup* hit_index_popup_for_wid(struct hit_index* hit_index, uint32_t wid);
+bool hit_index_mouse_over_any_popup(struct hit_index* hit_index);
+
+void hit_index_destroy(struct hit_index* hit_index);
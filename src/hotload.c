@@ -1,12 +1,21 @@
+#include "hotload.h"
 #include "bar_manager.h"
 #include "event.h"
+#include "trace.h"
+#include "snapshot.h"
+#include "startup.h"
 #include <ApplicationServices/ApplicationServices.h>
 #include <libgen.h>
+#include <errno.h>
 
 extern char g_config_file[4096];
 extern char g_name[256];
 bool g_hotload = false;
 int64_t g_last_hotload = 0;
+static pid_t g_config_pid = -1;
+static bool g_config_running = false;
+static bool g_reload_pending = false;
+static uint64_t g_config_messages = 0;
 
 void hotload_set_state(int state) {
   g_hotload = state;
@@ -43,16 +52,20 @@ static bool get_config_file(char *restrict filename, char *restrict buffer, int
   return file_exists(buffer);
 }
 
-void exec_config_file() {
-  if (!*g_config_file
-    && !get_config_file("sketchybarrc", g_config_file, sizeof(g_config_file))) {
+static bool resolve_config_file() {
+  return *g_config_file
+         || get_config_file("sketchybarrc", g_config_file, sizeof(g_config_file));
+}
+
+pid_t exec_config_file() {
+  if (!resolve_config_file()) {
     printf("could not locate config file..\n");
-    return;
+    return -1;
   }
 
   if (!file_exists(g_config_file)) {
     printf("file '%s' does not exist..\n", g_config_file);
-    return;
+    return -1;
   }
 
   setenv("CONFIG_DIR", dirname(g_config_file), 1);
@@ -60,13 +73,135 @@ void exec_config_file() {
 
   if (!ensure_executable_permission(g_config_file)) {
     printf("could not set the executable permission bit for '%s'\n", g_config_file);
-    return;
+    return -1;
   }
 
-  if (!fork_exec(g_config_file, NULL)) {
+  TRACE_BEGIN(fork_exec);
+  pid_t pid = fork_exec_pid(g_config_file, NULL);
+  TRACE_END(fork_exec);
+  startup_mark(STARTUP_CONFIG_FORKED);
+  if (pid == -1) {
     printf("failed to execute file '%s'\n", g_config_file);
+  }
+  return pid;
+}
+
+static void config_exit_handler(void* context) {
+  dispatch_source_t source = context;
+  pid_t pid = (pid_t)dispatch_source_get_handle(source);
+  dispatch_source_cancel(source);
+  dispatch_release(source);
+
+  if (pid == g_config_pid) {
+    struct event event = { NULL, HOTLOAD_COMMIT };
+    event_post(&event);
+  }
+}
+
+// A config that keeps running, e.g. because it starts a long lived helper
+// in the foreground, must not hold the reload back indefinitely
+static void config_timeout_handler(void* context) {
+  pid_t pid = (pid_t)(intptr_t)context;
+  if (pid == g_config_pid) {
+    struct event event = { context, HOTLOAD_CHECKPOINT };
+    event_post(&event);
+  }
+}
+
+static void arm_config_timeout(pid_t pid) {
+  dispatch_after_f(dispatch_time(DISPATCH_TIME_NOW,
+                                 CONFIG_CHECKPOINT_INTERVAL * NSEC_PER_SEC),
+                   dispatch_get_main_queue(),
+                   (void*)(intptr_t)pid,
+                   config_timeout_handler                                  );
+}
+
+static bool watch_config_process(pid_t pid) {
+  g_config_pid = pid;
+  if (pid <= 0) return false;
+
+  dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_PROC,
+                                                    pid,
+                                                    DISPATCH_PROC_EXIT,
+                                                    dispatch_get_main_queue());
+  if (!source) return false;
+  dispatch_set_context(source, source);
+  dispatch_source_set_event_handler_f(source, config_exit_handler);
+  dispatch_resume(source);
+
+  g_config_messages = g_bar_manager.config_messages;
+  arm_config_timeout(pid);
+
+  // The config might have finished before the source was armed
+  return !(kill(pid, 0) != 0 && errno == ESRCH);
+}
+
+static void run_config(bool reload) {
+  g_config_running = true;
+  if (reload) bar_manager_begin_reload(&g_bar_manager);
+  else bar_manager_begin_config(&g_bar_manager);
+
+  snapshot_begin_recording();
+  if (!watch_config_process(exec_config_file())) commit_config();
+}
+
+// Runs every CONFIG_CHECKPOINT_INTERVAL seconds while the config process is
+// alive. As long as the config keeps sending messages nothing happens, once
+// it has gone quiet the items it claimed so far are committed. Unclaimed
+// items are only removed when the process exits.
+void checkpoint_config(pid_t pid) {
+  if (!g_config_running || pid != g_config_pid) return;
+
+  if (g_bar_manager.config_messages == g_config_messages) {
+    bar_manager_checkpoint_config(&g_bar_manager);
+  }
+  g_config_messages = g_bar_manager.config_messages;
+  arm_config_timeout(pid);
+}
+
+// Called once the config process has exited. All items the config did not
+// claim are removed and the messages it sent become the new snapshot. A
+// reload requested in the meantime starts now.
+void commit_config() {
+  if (!g_config_running) return;
+  g_config_running = false;
+  g_config_pid = -1;
+
+  startup_mark(STARTUP_CONFIG_EXITED);
+  bar_manager_commit_config(&g_bar_manager);
+  snapshot_end_recording();
+
+  if (g_reload_pending) {
+    g_reload_pending = false;
+    reload_config();
+  }
+}
+
+// Re-runs the config against the live items. The reload is committed once
+// the config process has exited, which removes all items it did not claim.
+// Reloads do not overlap, one requested while a config runs follows it.
+void reload_config() {
+  if (g_config_running) {
+    g_reload_pending = true;
     return;
   }
+  run_config(true);
+}
+
+// Restores the snapshot of the previous session if there is one, in which
+// case the config only reconciles the restored state in the background.
+void load_config() {
+  if (resolve_config_file()) {
+    bar_manager_begin_config(&g_bar_manager);
+    if (snapshot_load_automatic()) {
+      startup_mark(STARTUP_SNAPSHOT_LOADED);
+      bar_manager_commit_config(&g_bar_manager);
+      reload_config();
+      return;
+    }
+  }
+
+  run_config(false);
 }
 
 static void handler(ConstFSEventStreamRef stream, void* context, size_t count, void* paths, const FSEventStreamEventFlags* flags, const FSEventStreamEventId* ids) {
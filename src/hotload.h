@@ -1,10 +1,19 @@
 #include <stdbool.h>
+#include <sys/types.h>
 
 #define HOTLOAD_STATE_ENABLED true
 #define HOTLOAD_STATE_DISABLED false
 
-void exec_config_file();
-void begin_receiving_config_change_events();
+// Seconds without a config message after which a still running reload
+// commits the items claimed so far
+#define CONFIG_CHECKPOINT_INTERVAL 2
+
+pid_t exec_config_file();
+void reload_config();
+void load_config();
+void checkpoint_config(pid_t pid);
+void commit_config();
+int begin_receiving_config_change_events();
 void hotload_set_state(int state);
 int hotload_get_state();
 bool set_config_file_path(char* file);
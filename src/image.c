@@ -4,6 +4,9 @@
 #include "shadow.h"
 #include "workspace.h"
 #include "media.h"
+#include "image_cache.h"
+#include "startup.h"
+#include "misc/hash.h"
 #include <math.h>
 #include <pthread.h>
 #include <stdio.h>
@@ -11,7 +14,7 @@
 void image_init(struct image* image) {
   image->enabled = false;
   image->image_ref = NULL;
-  image->data_ref = NULL;
+  image->hash = 0;
   image->bounds = CGRectNull;
   image->size = CGSizeZero;
   image->scale = 1.0;
@@ -50,12 +53,40 @@ bool image_load(struct image* image, char* path, FILE* rsp) {
   image->path = string_copy(path);
   char* res_path = resolve_path(path);
   CGImageRef new_image_ref = NULL;
+  uint64_t content_hash = 0;
   float scale = 1.f;
 
   struct key_value_pair app_kv = get_key_value_pair(app, '.');
   if (app_kv.key && app_kv.value && strcmp(app_kv.key, "app") == 0) {
-    CGImageRef app_icon = workspace_icon_for_app(app_kv.value);
+    // The icon is keyed on the bundle and validated against its Info.plist,
+    // which an update of the application replaces.
     scale = workspace_get_scale();
+    char* bundle_path = workspace_copy_app_path(app_kv.value);
+    CGImageRef app_icon = NULL;
+    if (bundle_path) {
+      char key[MAXLEN];
+      char info_path[MAXLEN];
+      snprintf(key, MAXLEN, "app:%s@%.2f", bundle_path, scale);
+      snprintf(info_path, MAXLEN, "%s/Contents/Info.plist", bundle_path);
+
+      struct stat file_stat = { 0 };
+      if (stat(info_path, &file_stat) != 0) stat(bundle_path, &file_stat);
+      int64_t mtime = (int64_t)file_stat.st_mtimespec.tv_sec * 1000000000LL
+                      + file_stat.st_mtimespec.tv_nsec;
+
+      app_icon = image_cache_lookup(key,
+                                    mtime,
+                                    file_stat.st_size,
+                                    &content_hash     );
+      if (!app_icon) {
+        app_icon = image_cache_insert(key,
+                                      mtime,
+                                      file_stat.st_size,
+                                      workspace_icon_for_path(bundle_path),
+                                      &content_hash                        );
+      }
+      free(bundle_path);
+    }
     scale *= scale;
     if (app_icon) new_image_ref = app_icon;
     else {
@@ -80,25 +111,42 @@ bool image_load(struct image* image, char* path, FILE* rsp) {
     begin_receiving_media_events();
     return image_set_link(image, &g_bar_manager.current_artwork);
   } else if (file_exists(res_path)) {
-    CGDataProviderRef data_provider = CGDataProviderCreateWithFilename(res_path);
-    if (data_provider) {
-      if (strlen(res_path) > 3 && string_equals(&res_path[strlen(res_path) - 4], ".png"))
-        new_image_ref = CGImageCreateWithPNGDataProvider(data_provider,
-                                                         NULL,
-                                                         false,
-                                                         kCGRenderingIntentDefault);
-      else {
-        new_image_ref = CGImageCreateWithJPEGDataProvider(data_provider,
-                                                          NULL,
-                                                          false,
-                                                          kCGRenderingIntentDefault);
+    struct stat file_stat = { 0 };
+    stat(res_path, &file_stat);
+    int64_t mtime = (int64_t)file_stat.st_mtimespec.tv_sec * 1000000000LL
+                    + file_stat.st_mtimespec.tv_nsec;
+
+    new_image_ref = image_cache_lookup(res_path,
+                                       mtime,
+                                       file_stat.st_size,
+                                       &content_hash     );
+    if (!new_image_ref) {
+      CGDataProviderRef data_provider = CGDataProviderCreateWithFilename(res_path);
+      if (data_provider) {
+        if (strlen(res_path) > 3 && string_equals(&res_path[strlen(res_path) - 4], ".png"))
+          new_image_ref = CGImageCreateWithPNGDataProvider(data_provider,
+                                                           NULL,
+                                                           false,
+                                                           kCGRenderingIntentDefault);
+        else {
+          new_image_ref = CGImageCreateWithJPEGDataProvider(data_provider,
+                                                            NULL,
+                                                            false,
+                                                            kCGRenderingIntentDefault);
+        }
+        CFRelease(data_provider);
+      } else {
+        respond(rsp, "[!] Image: Invalid Image Format: '%s'\n", app_kv.value);
+        free(res_path);
+        free(app);
+        return false;
       }
-      CFRelease(data_provider);
-    } else {
-      respond(rsp, "[!] Image: Invalid Image Format: '%s'\n", app_kv.value);
-      free(res_path);
-      free(app);
-      return false;
+
+      new_image_ref = image_cache_insert(res_path,
+                                         mtime,
+                                         file_stat.st_size,
+                                         new_image_ref,
+                                         &content_hash     );
     }
   }
   else if (strlen(res_path) == 0) {
@@ -114,12 +162,14 @@ bool image_load(struct image* image, char* path, FILE* rsp) {
   }
 
   if (new_image_ref) {
-    image_set_image(image,
-                    new_image_ref,
-                    (CGRect){{0,0},
-                            {CGImageGetWidth(new_image_ref) / scale,
-                              CGImageGetHeight(new_image_ref) / scale }},
-                    true                                        );
+    startup_count(STARTUP_IMAGES);
+    image_set_image_with_hash(image,
+                              new_image_ref,
+                              (CGRect){{0,0},
+                                      {CGImageGetWidth(new_image_ref) / scale,
+                                        CGImageGetHeight(new_image_ref) / scale }},
+                              true,
+                              content_hash                                  );
     if (image->rotator) {
       if (image->rotate_rate != 0.f) {
         image_rotator_start(image, true);
@@ -142,45 +192,68 @@ bool image_load(struct image* image, char* path, FILE* rsp) {
   return true;
 }
 
-static bool image_data_equals(struct image* image, CFDataRef new_data_ref) {
-  bool equals = false;
-  if (image->image_ref && image->data_ref) {
-    uint32_t old_len = CFDataGetLength(image->data_ref);
-    uint32_t new_len = CFDataGetLength(new_data_ref);
-    if (old_len == new_len)
-      equals = memcmp(CFDataGetBytePtr(image->data_ref),
-                      CFDataGetBytePtr(new_data_ref),
-                      old_len                           )
-               == 0;
+// Hashes the pixels in place when the provider exposes its backing store,
+// which it does for window captures and decoded bitmaps, and only falls back
+// to a copy of the pixels for providers that have to produce them.
+static uint64_t image_content_hash(CGImageRef image_ref) {
+  CGDataProviderRef provider = CGImageGetDataProvider(image_ref);
+  if (!provider) return 0;
+
+  uint64_t seed = ((uint64_t)CGImageGetWidth(image_ref) << 32)
+                  | CGImageGetHeight(image_ref);
+
+  const void* bytes = CGDataProviderRetainBytePtr(provider);
+  if (bytes) {
+    uint64_t hash = hash_xxh64(bytes,
+                               CGImageGetBytesPerRow(image_ref)
+                               * CGImageGetHeight(image_ref),
+                               seed                             );
+    CGDataProviderReleaseBytePtr(provider);
+    return hash;
   }
 
-  return equals;
+  CFDataRef data_ref = CGDataProviderCopyData(provider);
+  if (!data_ref) return 0;
+
+  uint64_t hash = hash_xxh64(CFDataGetBytePtr(data_ref),
+                             CFDataGetLength(data_ref),
+                             seed                      );
+  CFRelease(data_ref);
+  return hash;
 }
 
 void image_copy(struct image* image, CGImageRef source) {
   if (source) image->image_ref = CGImageCreateCopy(source);
 }
 
-bool image_set_image(struct image* image, CGImageRef new_image_ref, CGRect bounds, bool forced) {
+// The content hash of cached images is known from their decode, all other
+// images are hashed here from their pixels.
+bool image_set_image_with_hash(struct image* image, CGImageRef new_image_ref, CGRect bounds, bool forced, uint64_t content_hash) {
   if (!new_image_ref) {
     if (image->image_ref) CGImageRelease(image->image_ref);
-    if (image->data_ref) CFRelease(image->data_ref);
     image->image_ref = NULL;
-    image->data_ref = NULL;
+    image->hash = 0;
     return false;
   }
   if (image->link) image_set_link(image, NULL);
-  CFDataRef new_data_ref = CGDataProviderCopyData(CGImageGetDataProvider(new_image_ref));
 
-  if (!forced && image_data_equals(image, new_data_ref)
-      && CGSizeEqualToSize(image->size, bounds.size)   ) {
-    CFRelease(new_data_ref);
+  // Images shared through the image cache are identical by reference,
+  // everything else is compared by a content hash of its pixels.
+  bool same_size = CGSizeEqualToSize(image->size, bounds.size);
+  if (!forced && same_size && new_image_ref == image->image_ref) {
+    CGImageRelease(new_image_ref);
+    return false;
+  }
+
+  uint64_t new_hash = content_hash ? content_hash
+                                   : image_content_hash(new_image_ref);
+  if (!forced && same_size && image->image_ref
+      && new_hash && image->hash == new_hash) {
     CGImageRelease(new_image_ref);
     return false;
   }
 
   if (image->image_ref) CGImageRelease(image->image_ref);
-  if (image->data_ref) CFRelease(image->data_ref);
 
   image->size = bounds.size;
   image->bounds = (CGRect){{0, 0},
@@ -188,11 +261,15 @@ bool image_set_image(struct image* image, CGImageRef new_image_ref, CGRect bound
                             bounds.size.height * image->scale}};
 
   image->image_ref = new_image_ref;
-  image->data_ref = new_data_ref;
+  image->hash = new_hash;
   image->enabled = true;
   return true;
 }
 
+bool image_set_image(struct image* image, CGImageRef new_image_ref, CGRect bounds, bool forced) {
+  return image_set_image_with_hash(image, new_image_ref, bounds, forced, 0);
+}
+
 bool image_set_scale(struct image* image, float scale) {
   if (scale == image->scale) return false;
   image->scale = scale;
@@ -268,6 +345,14 @@ void image_calculate_bounds(struct image* image, uint32_t x, uint32_t y) {
   image->bounds.origin.y = y - image->bounds.size.height / 2 + image->y_offset;
 }
 
+static CGFloat rotated_context_size(CGImageRef imageRef) {
+  size_t original_width = CGImageGetWidth(imageRef);
+  size_t original_height = CGImageGetHeight(imageRef);
+
+  double height_width_ratio = (double)original_height / original_width;
+  return original_width * pow(1 + height_width_ratio * height_width_ratio, 0.5);
+}
+
 void image_draw(struct image* image, CGContextRef context) {
   if ((!image->link && !image->image_ref)
       || (image->link && !image->link->image_ref)) return;
@@ -308,7 +393,15 @@ void image_draw(struct image* image, CGContextRef context) {
     CFRelease(path);
   }
   if (image->rotator) {
-    CGImageRef rotatedImage = create_rotated_image(image->rotator, image->link ? image->link->image_ref : image->image_ref);
+    CGImageRef source = image->link ? image->link->image_ref : image->image_ref;
+    CGFloat frame_size = rotated_context_size(source);
+    uint64_t frame_bytes = (uint64_t)(frame_size * frame_size)
+                           * CGImageGetBitsPerComponent(source) / 2;
+
+    CGImageRef rotatedImage = rotator_get_frame(image->rotator,
+                                                source,
+                                                frame_bytes,
+                                                create_rotated_image);
     CGContextSetInterpolationQuality(context, kCGInterpolationDefault); // high quality interpolation
     CGContextDrawImage(context,
                        image->bounds,
@@ -349,13 +442,11 @@ void image_draw(struct image* image, CGContextRef context) {
 
 void image_clear_pointers(struct image* image) {
   image->image_ref = NULL;
-  image->data_ref = NULL;
   image->path = NULL;
 }
 
 void image_destroy(struct image* image) {
   CGImageRelease(image->image_ref);
-  if (image->data_ref) CFRelease(image->data_ref);
   if (image->path) free(image->path);
   if (image->rotator) image_rotator_release(image);
   image_clear_pointers(image);
@@ -515,13 +606,14 @@ CGContextRef create_roated_bitmap_context(CGImageRef imageRef, CGFloat fixed_siz
 }
 
 // create roated image
-CGImageRef create_rotated_image(struct rotator* rotator, CGImageRef imageRef) {
+ROTATOR_RENDER_FUNCTION(create_rotated_image) {
+  CGImageRef imageRef = image_ref;
+
   // get original image size
   size_t original_width = CGImageGetWidth(imageRef);
   size_t original_height = CGImageGetHeight(imageRef);
 
-  double height_width_ratio = (double)original_height / original_width;
-  CGFloat rotate_context_size =  original_width * pow(1 + height_width_ratio * height_width_ratio, 0.5);
+  CGFloat rotate_context_size = rotated_context_size(imageRef);
 
 
   // calculate rotated canvas size
@@ -533,7 +625,7 @@ CGImageRef create_rotated_image(struct rotator* rotator, CGImageRef imageRef) {
   CGContextTranslateCTM(context, 
                         rotate_context_size/2.f, 
                         rotate_context_size/2.f);
-  CGContextRotateCTM(context, rotator->current_rotation * M_PI / 180.0);
+  CGContextRotateCTM(context, rotation * M_PI / 180.0);
   CGContextTranslateCTM(context, 
                         -1.0*original_width/2.f, 
                         -1.0*original_height/2.f);
@@ -2,8 +2,9 @@
 #include "shadow.h"
 #include "misc/defines.h"
 #include <CoreVideo/CoreVideo.h>
+#include "rotator.h"
 
-extern CGImageRef workspace_icon_for_app(char* app);
+extern CGImageRef workspace_icon_for_path(char* path);
 
 struct image {
   bool enabled;
@@ -15,7 +16,7 @@ struct image {
   char* path;
 
   CGImageRef image_ref;
-  CFDataRef data_ref;
+  uint64_t hash;
 
   struct shadow shadow;
 
@@ -37,6 +38,7 @@ void image_init(struct image* image);
 bool image_set_enabled(struct image* image, bool enabled);
 void image_copy(struct image* image, CGImageRef source);
 bool image_set_image(struct image* image, CGImageRef new_image_ref, CGRect bounds, bool forced);
+bool image_set_image_with_hash(struct image* image, CGImageRef new_image_ref, CGRect bounds, bool forced, uint64_t content_hash);
 bool image_load(struct image* image, char* path, FILE* rsp);
 bool image_set_scale(struct image* image, float scale);
 void image_set_rotate_rate(struct image* image, float radians);
@@ -51,7 +53,7 @@ void image_destroy(struct image* image);
 void image_serialize(struct image* image, char* indent, FILE* rsp);
 bool image_parse_sub_domain(struct image* image, FILE* rsp, struct token property, char* message);
 
-CGImageRef create_rotated_image(struct rotator *rotator, CGImageRef imageRef);
+ROTATOR_RENDER_FUNCTION(create_rotated_image);
 void image_rotator_start(struct image* image, bool forceFlush);
 void image_rotator_stop(struct image* image);
 void image_rotator_release(struct image* image);
@@ -0,0 +1,178 @@
+#include "image_cache.h"
+#include "misc/hash.h"
+
+static struct image_cache g_image_cache = { 0 };
+
+static uint64_t image_cache_hash(char* key) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (char* c = key; *c; c++) {
+    hash = (hash ^ (unsigned char)*c) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static void image_cache_unlink(struct image_cache_entry* entry) {
+  if (entry->prev) entry->prev->next = entry->next;
+  else g_image_cache.head = entry->next;
+
+  if (entry->next) entry->next->prev = entry->prev;
+  else g_image_cache.tail = entry->prev;
+
+  entry->prev = NULL;
+  entry->next = NULL;
+}
+
+static void image_cache_push_front(struct image_cache_entry* entry) {
+  entry->prev = NULL;
+  entry->next = g_image_cache.head;
+  if (g_image_cache.head) g_image_cache.head->prev = entry;
+  g_image_cache.head = entry;
+  if (!g_image_cache.tail) g_image_cache.tail = entry;
+}
+
+static void image_cache_entry_destroy(struct image_cache_entry* entry) {
+  struct image_cache_entry** link
+                           = &g_image_cache.buckets[entry->hash
+                                                    % IMAGE_CACHE_BUCKETS];
+  while (*link && *link != entry) link = &(*link)->chain;
+  if (*link) *link = entry->chain;
+
+  image_cache_unlink(entry);
+  g_image_cache.bytes -= entry->bytes;
+  g_image_cache.count--;
+
+  CGImageRelease(entry->image_ref);
+  free(entry->key);
+  free(entry);
+}
+
+// Hashes the decoded pixels while they are still in the bitmap context, the
+// seed matches the one used for uncached images in image.c.
+static CGImageRef image_cache_decode(CGImageRef image_ref, uint64_t* content_hash) {
+  size_t width = CGImageGetWidth(image_ref);
+  size_t height = CGImageGetHeight(image_ref);
+
+  // The decode keeps the color profile of the source, only sources outside
+  // of the RGB model, which bitmap contexts can not target, go to DeviceRGB.
+  CGColorSpaceRef source_space = CGImageGetColorSpace(image_ref);
+  CGColorSpaceRef color_space = source_space
+                                && CGColorSpaceGetModel(source_space)
+                                   == kCGColorSpaceModelRGB
+                                ? CGColorSpaceRetain(source_space)
+                                : CGColorSpaceCreateDeviceRGB();
+
+  CGContextRef context = CGBitmapContextCreate(NULL,
+                                               width,
+                                               height,
+                                               8,
+                                               0,
+                                               color_space,
+                                               kCGImageAlphaPremultipliedFirst
+                                               | kCGBitmapByteOrder32Little  );
+  CGColorSpaceRelease(color_space);
+  *content_hash = 0;
+  if (!context) return CGImageRetain(image_ref);
+
+  CGContextDrawImage(context, (CGRect){{0, 0}, {width, height}}, image_ref);
+  CGImageRef decoded_ref = CGBitmapContextCreateImage(context);
+  if (decoded_ref && CGBitmapContextGetData(context)) {
+    *content_hash = hash_xxh64(CGBitmapContextGetData(context),
+                               CGBitmapContextGetBytesPerRow(context)
+                               * height,
+                               ((uint64_t)width << 32) | height      );
+  }
+  CGContextRelease(context);
+
+  g_image_cache.decoded++;
+  return decoded_ref ? decoded_ref : CGImageRetain(image_ref);
+}
+
+CGImageRef image_cache_lookup(char* key, int64_t mtime, int64_t size, uint64_t* content_hash) {
+  if (!key) return NULL;
+
+  uint64_t hash = image_cache_hash(key);
+  struct image_cache_entry* entry = g_image_cache.buckets[hash
+                                                          % IMAGE_CACHE_BUCKETS];
+  while (entry) {
+    if (entry->hash == hash && string_equals(entry->key, key)) break;
+    entry = entry->chain;
+  }
+
+  if (!entry) {
+    g_image_cache.misses++;
+    return NULL;
+  }
+
+  if (entry->mtime != mtime || entry->size != size) {
+    image_cache_entry_destroy(entry);
+    g_image_cache.misses++;
+    return NULL;
+  }
+
+  if (entry != g_image_cache.head) {
+    image_cache_unlink(entry);
+    image_cache_push_front(entry);
+  }
+
+  g_image_cache.hits++;
+  *content_hash = entry->content_hash;
+  return CGImageRetain(entry->image_ref);
+}
+
+CGImageRef image_cache_insert(char* key, int64_t mtime, int64_t size, CGImageRef image_ref, uint64_t* content_hash) {
+  *content_hash = 0;
+  if (!key || !image_ref) return image_ref;
+
+  CGImageRef decoded_ref = image_cache_decode(image_ref, content_hash);
+  CGImageRelease(image_ref);
+
+  uint64_t bytes = CGImageGetBytesPerRow(decoded_ref)
+                   * CGImageGetHeight(decoded_ref);
+  if (bytes > IMAGE_CACHE_MAX_BYTES) return decoded_ref;
+
+  while (g_image_cache.tail
+         && g_image_cache.bytes + bytes > IMAGE_CACHE_MAX_BYTES) {
+    image_cache_entry_destroy(g_image_cache.tail);
+    g_image_cache.evictions++;
+  }
+
+  struct image_cache_entry* entry = malloc(sizeof(struct image_cache_entry));
+  memset(entry, 0, sizeof(struct image_cache_entry));
+  entry->hash = image_cache_hash(key);
+  entry->key = string_copy(key);
+  entry->mtime = mtime;
+  entry->size = size;
+  entry->image_ref = CGImageRetain(decoded_ref);
+  entry->content_hash = *content_hash;
+  entry->bytes = bytes;
+
+  uint32_t bucket = entry->hash % IMAGE_CACHE_BUCKETS;
+  entry->chain = g_image_cache.buckets[bucket];
+  g_image_cache.buckets[bucket] = entry;
+  image_cache_push_front(entry);
+  g_image_cache.count++;
+  g_image_cache.bytes += bytes;
+
+  return decoded_ref;
+}
+
+void image_cache_flush() {
+  while (g_image_cache.tail) image_cache_entry_destroy(g_image_cache.tail);
+}
+
+void image_cache_serialize(char* indent, FILE* rsp) {
+  fprintf(rsp, "%s\"entries\": %u,\n"
+               "%s\"bytes\": %llu,\n"
+               "%s\"max_bytes\": %u,\n"
+               "%s\"hits\": %llu,\n"
+               "%s\"misses\": %llu,\n"
+               "%s\"evictions\": %llu,\n"
+               "%s\"decoded\": %llu",
+               indent, g_image_cache.count,
+               indent, g_image_cache.bytes,
+               indent, IMAGE_CACHE_MAX_BYTES,
+               indent, g_image_cache.hits,
+               indent, g_image_cache.misses,
+               indent, g_image_cache.evictions,
+               indent, g_image_cache.decoded    );
+}
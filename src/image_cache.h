@@ -0,0 +1,44 @@
+#pragma once
+#include "misc/helpers.h"
+
+#define IMAGE_CACHE_MAX_BYTES (64 * 1024 * 1024)
+#define IMAGE_CACHE_BUCKETS   256
+
+// Decoded images are shared by all items loading the same file, keyed by the
+// resolved path together with its modification time and size. App icons are
+// keyed by their bundle path and validated against its Info.plist. Entries are
+// evicted least recently used first once the pixel budget is exceeded. The
+// content hash of the pixels is taken once while the image is decoded.
+struct image_cache_entry {
+  uint64_t hash;
+  char* key;
+  int64_t mtime;
+  int64_t size;
+
+  CGImageRef image_ref;
+  uint64_t content_hash;
+  uint64_t bytes;
+
+  struct image_cache_entry* chain;
+  struct image_cache_entry* prev;
+  struct image_cache_entry* next;
+};
+
+struct image_cache {
+  struct image_cache_entry* buckets[IMAGE_CACHE_BUCKETS];
+  struct image_cache_entry* head;
+  struct image_cache_entry* tail;
+  uint32_t count;
+  uint64_t bytes;
+
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t decoded;
+};
+
+CGImageRef image_cache_lookup(char* key, int64_t mtime, int64_t size, uint64_t* content_hash);
+CGImageRef image_cache_insert(char* key, int64_t mtime, int64_t size, CGImageRef image_ref, uint64_t* content_hash);
+void image_cache_flush();
+
+void image_cache_serialize(char* indent, FILE* rsp);
@@ -0,0 +1,120 @@
+#include "item_store.h"
+#include "bar_item.h"
+
+static inline item_handle item_store_make_handle(uint32_t index, uint32_t generation) {
+  return ((item_handle)generation << ITEM_HANDLE_INDEX_BITS) | (index + 1);
+}
+
+static inline struct bar_item* item_store_slot_item(struct item_store* store, uint32_t index) {
+  return &store->pages[index / ITEM_STORE_PAGE_ITEMS][index
+                                                      % ITEM_STORE_PAGE_ITEMS];
+}
+
+void item_store_init(struct item_store* store) {
+  memset(store, 0, sizeof(struct item_store));
+}
+
+static bool item_store_grow(struct item_store* store) {
+  if ((uint64_t)store->capacity + ITEM_STORE_PAGE_ITEMS > ITEM_HANDLE_INDEX_MASK)
+    return false;
+
+  struct bar_item* page = malloc(sizeof(struct bar_item)
+                                 * ITEM_STORE_PAGE_ITEMS);
+  if (!page) return false;
+
+  store->pages = realloc(store->pages,
+                         sizeof(struct bar_item*) * (store->page_count + 1));
+  store->pages[store->page_count++] = page;
+
+  store->slots = realloc(store->slots,
+                         sizeof(struct item_slot)
+                         * (store->capacity + ITEM_STORE_PAGE_ITEMS));
+
+  // The free list is empty when growing, the new slots form it in order
+  for (uint32_t i = 0; i < ITEM_STORE_PAGE_ITEMS; i++) {
+    struct item_slot* slot = &store->slots[store->capacity + i];
+    slot->generation = 1;
+    slot->used = false;
+    slot->next_free = i < ITEM_STORE_PAGE_ITEMS - 1
+                      ? store->capacity + i + 2
+                      : 0;
+  }
+  store->free_head = store->capacity + 1;
+  store->free_tail = store->capacity + ITEM_STORE_PAGE_ITEMS;
+  store->capacity += ITEM_STORE_PAGE_ITEMS;
+  return true;
+}
+
+struct bar_item* item_store_acquire(struct item_store* store, item_handle* handle) {
+  if (!store->free_head && !item_store_grow(store)) return NULL;
+
+  uint32_t index = store->free_head - 1;
+  struct item_slot* slot = &store->slots[index];
+  store->free_head = slot->next_free;
+  if (!store->free_head) store->free_tail = 0;
+  slot->next_free = 0;
+  slot->used = true;
+  store->count++;
+
+  struct bar_item* bar_item = item_store_slot_item(store, index);
+  memset(bar_item, 0, sizeof(struct bar_item));
+  *handle = item_store_make_handle(index, slot->generation);
+  return bar_item;
+}
+
+void item_store_release(struct item_store* store, item_handle handle) {
+  if (!item_store_get(store, handle)) return;
+
+  uint32_t index = (handle & ITEM_HANDLE_INDEX_MASK) - 1;
+  struct item_slot* slot = &store->slots[index];
+  slot->used = false;
+  store->count--;
+
+  // A slot which would reissue a used generation is never handed out again
+  if (++slot->generation == ITEM_SLOT_RETIRED) return;
+
+  slot->next_free = 0;
+  if (store->free_tail) store->slots[store->free_tail - 1].next_free = index + 1;
+  else store->free_head = index + 1;
+  store->free_tail = index + 1;
+}
+
+struct bar_item* item_store_get(struct item_store* store, item_handle handle) {
+  uint32_t index = (uint32_t)(handle & ITEM_HANDLE_INDEX_MASK);
+  if (index-- == 0 || index >= store->capacity) return NULL;
+
+  struct item_slot* slot = &store->slots[index];
+  if (!slot->used
+      || slot->generation != (uint32_t)(handle >> ITEM_HANDLE_INDEX_BITS)) {
+    return NULL;
+  }
+  return item_store_slot_item(store, index);
+}
+
+// Resolves the item containing the given address, e.g. the target of an
+// animation, or ITEM_HANDLE_NULL if it does not point into a live item.
+item_handle item_store_handle_for_address(struct item_store* store, void* address) {
+  for (uint32_t i = 0; i < store->page_count; i++) {
+    char* page = (char*)store->pages[i];
+    if ((char*)address < page
+        || (char*)address >= page + sizeof(struct bar_item)
+                                    * ITEM_STORE_PAGE_ITEMS) {
+      continue;
+    }
+
+    uint32_t index = i * ITEM_STORE_PAGE_ITEMS
+                     + ((char*)address - page) / sizeof(struct bar_item);
+
+    struct item_slot* slot = &store->slots[index];
+    if (!slot->used) return ITEM_HANDLE_NULL;
+    return item_store_make_handle(index, slot->generation);
+  }
+  return ITEM_HANDLE_NULL;
+}
+
+void item_store_destroy(struct item_store* store) {
+  for (uint32_t i = 0; i < store->page_count; i++) free(store->pages[i]);
+  if (store->pages) free(store->pages);
+  if (store->slots) free(store->slots);
+  item_store_init(store);
+}
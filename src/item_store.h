@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ITEM_HANDLE_NULL       0
+#define ITEM_HANDLE_INDEX_BITS 32
+#define ITEM_HANDLE_INDEX_MASK ((1ull << ITEM_HANDLE_INDEX_BITS) - 1)
+#define ITEM_SLOT_RETIRED      UINT32_MAX
+#define ITEM_STORE_PAGE_ITEMS  64
+
+// The lower 32 bits of a handle hold the slot index + 1, the upper 32 bits
+// the generation of the slot when the handle was issued. A handle of a
+// removed item thus resolves to NULL, even once its slot has been reused:
+// released slots are reused in FIFO order and a slot whose generation is
+// exhausted is retired for good instead of wrapping around.
+typedef uint64_t item_handle;
+
+struct bar_item;
+
+struct item_slot {
+  uint32_t generation;
+  uint32_t next_free;
+  bool used;
+};
+
+// Items are allocated from fixed size pages which are never moved, such that
+// item addresses stay stable and released slots are reused before the store
+// grows, the least recently released one first.
+struct item_store {
+  struct bar_item** pages;
+  uint32_t page_count;
+
+  struct item_slot* slots;
+  uint32_t capacity;
+  uint32_t free_head;
+  uint32_t free_tail;
+  uint32_t count;
+};
+
+void item_store_init(struct item_store* store);
+struct bar_item* item_store_acquire(struct item_store* store, item_handle* handle);
+void item_store_release(struct item_store* store, item_handle handle);
+struct bar_item* item_store_get(struct item_store* store, item_handle handle);
+item_handle item_store_handle_for_address(struct item_store* store, void* address);
+void item_store_destroy(struct item_store* store);
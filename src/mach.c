@@ -124,6 +124,36 @@ char* mach_send_message(mach_port_t port, char* message, uint32_t len, bool awai
   return NULL;
 }
 
+// Never blocks, a full queue of the receiver is reported as MACH_SEND_TIMED_OUT
+// and a vanished receiver as MACH_SEND_INVALID_DEST.
+mach_msg_return_t mach_try_send_message(mach_port_t port, char* message, uint32_t len) {
+  if (!message || !port) return MACH_SEND_INVALID_DEST;
+
+  struct mach_message msg = { 0 };
+  msg.header.msgh_remote_port = port;
+  msg.header.msgh_bits = MACH_MSGH_BITS_SET(MACH_MSG_TYPE_COPY_SEND
+                                            & MACH_MSGH_BITS_REMOTE_MASK,
+                                            0,
+                                            0,
+                                            MACH_MSGH_BITS_COMPLEX       );
+  msg.header.msgh_size = sizeof(struct mach_message);
+
+  msg.msgh_descriptor_count = 1;
+  msg.descriptor.address = message;
+  msg.descriptor.size = len * sizeof(char);
+  msg.descriptor.copy = MACH_MSG_VIRTUAL_COPY;
+  msg.descriptor.deallocate = false;
+  msg.descriptor.type = MACH_MSG_OOL_DESCRIPTOR;
+
+  return mach_msg(&msg.header,
+                  MACH_SEND_MSG | MACH_SEND_TIMEOUT,
+                  sizeof(struct mach_message),
+                  0,
+                  MACH_PORT_NULL,
+                  0,
+                  MACH_PORT_NULL                    );
+}
+
 void mach_message_callback(CFMachPortRef port, void* message, CFIndex size, void* context) {
   struct mach_server* mach_server = context;
   struct mach_buffer buffer;
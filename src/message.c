@@ -8,6 +8,11 @@
 #include "media.h"
 #include "wifi.h"
 #include "power.h"
+#include "image_cache.h"
+#include "trace.h"
+#include "snapshot.h"
+#include "startup.h"
+#include "query.h"
 
 extern struct bar_manager g_bar_manager;
 
@@ -50,6 +55,7 @@ static struct bar_item** get_bar_items_for_regex(struct token reg, FILE* rsp, ui
 }
 
 static void handle_domain_subscribe(FILE* rsp, struct token domain, char* message) {
+  char* line = message;
   struct token name = get_token(&message);
 
   int item_index_for_name = bar_manager_get_item_index_for_name(&g_bar_manager,
@@ -59,6 +65,14 @@ static void handle_domain_subscribe(FILE* rsp, struct token domain, char* messag
     return;
   }
   struct bar_item* bar_item = g_bar_manager.bar_items[item_index_for_name];
+  if (!bar_manager_record_config(&g_bar_manager,
+                                 bar_item,
+                                 DOMAIN_SUBSCRIBE,
+                                 NULL,
+                                 line,
+                                 config_token_list_length(line))) {
+    return;
+  }
 
   bar_item_parse_subscribe_message(bar_item, message, rsp);
 }
@@ -100,6 +114,177 @@ static void handle_domain_trigger(FILE* rsp, struct token domain, char* message)
   env_vars_destroy(&env_vars);
 }
 
+static void handle_domain_channel(FILE* rsp, struct token domain, char* message) {
+  struct token name = get_token(&message);
+  struct token state = get_token(&message);
+  if (!name.text || name.length == 0) {
+    respond(rsp, "[!] Channel: Missing item name\n");
+    return;
+  }
+
+  if (!channel_name_valid(name.text)) {
+    respond(rsp, "[!] Channel: Invalid name '%s', only letters, digits, "
+                 "'.', '_' and '-' are allowed\n", name.text);
+    return;
+  }
+
+  if (state.length > 0 && !evaluate_boolean_state(state, true)) {
+    channel_manager_close(&g_bar_manager.channel_manager, name.text);
+    return;
+  }
+
+  struct channel* channel = channel_manager_open(&g_bar_manager.channel_manager,
+                                                 name.text                     );
+  if (!channel) {
+    respond(rsp, "[!] Channel: Could not create channel '%s'\n", name.text);
+    return;
+  }
+  fprintf(rsp, "%s\n", channel->path);
+}
+
+static void handle_domain_trace(FILE* rsp, struct token domain, char* message) {
+  struct token command = get_token(&message);
+  struct token path = get_token(&message);
+  char* path_copy = path.length > 0 ? token_to_string(path) : NULL;
+
+  if (token_equals(command, COMMAND_TRACE_START)) {
+    trace_start(path_copy);
+  } else if (token_equals(command, COMMAND_TRACE_STOP)) {
+    join_render_threads();
+    trace_stop(path_copy, rsp);
+  } else {
+    respond(rsp, "[!] Trace: Invalid command '%s'\n", command.text);
+    if (path_copy) free(path_copy);
+  }
+}
+
+static void handle_domain_snapshot(FILE* rsp, struct token domain, char* message) {
+  struct token command = get_token(&message);
+  struct token argument = get_token(&message);
+
+  if (token_equals(command, COMMAND_SNAPSHOT_AUTO)) {
+    snapshot_set_automatic(evaluate_boolean_state(argument,
+                                                  snapshot_get_automatic()));
+  } else if (argument.length == 0) {
+    respond(rsp, "[!] Snapshot: No file given\n");
+  } else if (token_equals(command, COMMAND_SNAPSHOT_SAVE)) {
+    snapshot_save(argument.text, rsp);
+  } else if (token_equals(command, COMMAND_SNAPSHOT_LOAD)) {
+    snapshot_load(argument.text, rsp);
+  } else {
+    respond(rsp, "[!] Snapshot: Invalid command '%s'\n", command.text);
+  }
+}
+
+// Reads a command file into the message grammar. Each line holds the
+// arguments of one client call and is split into tokens like the shell splits
+// them: at unquoted whitespace, with '...' taken literally, backslash escapes
+// outside of and within "...", and a '#' at the start of a word commenting
+// out the rest of the line. A backslash at the end of a line continues it.
+static char* read_command_file(char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  char* file = info.st_size > 0
+               ? mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0)
+               : NULL;
+  close(fd);
+  if (file == MAP_FAILED) return NULL;
+
+  char* message = malloc(info.st_size + 2);
+  size_t length = 0;
+  bool in_token = false;
+  char quote = '\0';
+  for (off_t i = 0; i < info.st_size; i++) {
+    char c = file[i];
+    if (quote == '\'') {
+      if (c == '\'') quote = '\0';
+      else message[length++] = c;
+      continue;
+    }
+
+    if (c == '\\' && i + 1 < info.st_size) {
+      char next = file[++i];
+      if (next == '\n') continue;
+      if (quote == '"' && next != '"' && next != '\\' && next != '$'
+          && next != '`') {
+        message[length++] = c;
+      }
+      message[length++] = next;
+      in_token = true;
+      continue;
+    }
+
+    if (quote == '"') {
+      if (c == '"') quote = '\0';
+      else message[length++] = c;
+      continue;
+    }
+
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\0') {
+      // Empty quoted words are dropped, an empty token would end the message
+      if (in_token && length > 0 && message[length - 1] != '\0')
+        message[length++] = '\0';
+      in_token = false;
+    } else if (c == '#' && !in_token) {
+      while (i + 1 < info.st_size && file[i + 1] != '\n') i++;
+    } else {
+      if (c == '\'' || c == '"') quote = c;
+      else message[length++] = c;
+      in_token = true;
+    }
+  }
+
+  if (in_token && length > 0 && message[length - 1] != '\0')
+    message[length++] = '\0';
+  message[length] = '\0';
+  if (file) munmap(file, info.st_size);
+  return message;
+}
+
+static void handle_domain_load(FILE* rsp, struct token domain, char* message) {
+  // A file that loads itself, directly or through others, ends here
+  static uint32_t depth = 0;
+  if (depth >= LOAD_MAX_DEPTH) {
+    respond(rsp, "[!] Load: Files nested deeper than %d levels\n",
+                 LOAD_MAX_DEPTH                                     );
+    return;
+  }
+
+  struct token token = get_token(&message);
+  char* path = resolve_path(token_to_string(token));
+  if (!path || !*path) {
+    respond(rsp, "[!] Load: No file given\n");
+    if (path) free(path);
+    return;
+  }
+
+  char* commands = read_command_file(path);
+  if (!commands) {
+    respond(rsp, "[!] Load: Could not read '%s'\n", path);
+    free(path);
+    return;
+  }
+
+  // Applied as part of the current transaction, the bar is refreshed once
+  // after all commands of the file have been handled. The message holding
+  // the --load is journaled, not the commands of the file.
+  TRACE_BEGIN(load);
+  depth++;
+  handle_message(commands, rsp);
+  depth--;
+  TRACE_END(load);
+
+  free(commands);
+  free(path);
+}
+
 static void handle_domain_push(FILE* rsp, struct token domain, char* message) {
   struct token name = get_token(&message);
 
@@ -117,10 +302,11 @@ static void handle_domain_push(FILE* rsp, struct token domain, char* message) {
   }
   struct token y = get_token(&message);
   while (y.text && y.length > 0) {
-    graph_push_back(&bar_item->graph, token_to_float(y));
+    graph_push_back_token(&bar_item->graph, y);
     y = get_token(&message);
   }
   bar_item_needs_update(bar_item);
+  change_log_record(&g_bar_manager.change_log, bar_item, CHANGE_GRAPH);
 }
 
 static void handle_domain_rename(FILE* rsp, struct token domain, char* message) {
@@ -135,11 +321,17 @@ static void handle_domain_rename(FILE* rsp, struct token domain, char* message)
                                                                   new_name.text);
     return;
   }
-  bar_item_set_name(g_bar_manager.bar_items[item_index_for_old_name],
-                    token_to_string(new_name)                        );
+  // Clients keyed by name see the old name removed and the item as new. The
+  // staged messages of the item refer to it by its old name.
+  struct bar_item* bar_item = g_bar_manager.bar_items[item_index_for_old_name];
+  bar_manager_commit_stage(&g_bar_manager, bar_item);
+  change_log_record_removal(&g_bar_manager.change_log, bar_item);
+  bar_item_set_name(bar_item, token_to_string(new_name));
+  change_log_record(&g_bar_manager.change_log, bar_item, CHANGE_ITEM);
 }
 
 static void handle_domain_clone(FILE* rsp, struct token domain, char* message) {
+  char* line = message;
   struct token name = get_token(&message);
   struct token parent = get_token(&message);
   struct token modifier = get_token(&message);
@@ -155,12 +347,35 @@ static void handle_domain_clone(FILE* rsp, struct token domain, char* message) {
     return;
   }
 
-  if (bar_manager_get_item_index_for_name(&g_bar_manager, name.text) >= 0) {
-    respond(rsp, "[?] Clone: Item '%s' already exists\n", name.text);
+  // The clone copies the parent as this run configured it
+  bar_manager_commit_stage(&g_bar_manager, parent_item);
+
+  struct bar_item* bar_item = NULL;
+  int item_index = bar_manager_get_item_index_for_name(&g_bar_manager,
+                                                       name.text      );
+  if (item_index >= 0) {
+    bar_item = g_bar_manager.bar_items[item_index];
+    if (!bar_manager_reconcile_item(&g_bar_manager,
+                                    bar_item,
+                                    parent_item,
+                                    parent_item->config_hash)) {
+      respond(rsp, "[?] Clone: Item '%s' already exists\n", name.text);
+      return;
+    }
+  } else {
+    bar_item = bar_manager_create_item(&g_bar_manager);
+    bar_item_inherit_from_item(bar_item, parent_item);
+    bar_item->config_hash = parent_item->config_hash;
+  }
+
+  if (!bar_manager_record_config(&g_bar_manager,
+                                 bar_item,
+                                 DOMAIN_CLONE,
+                                 NULL,
+                                 line,
+                                 config_token_list_length(line))) {
     return;
   }
-  struct bar_item* bar_item = bar_manager_create_item(&g_bar_manager);
-  bar_item_inherit_from_item(bar_item, parent_item);
   bar_item_set_name(bar_item, token_to_string(name));
   if (token_equals(modifier, ARGUMENT_COMMON_VAL_BEFORE))
     bar_manager_move_item(&g_bar_manager, bar_item, parent_item, true);
@@ -170,6 +385,7 @@ static void handle_domain_clone(FILE* rsp, struct token domain, char* message) {
 }
 
 static void handle_domain_add(FILE* rsp, struct token domain, char* message) {
+  char* line = message;
   struct token command  = get_token(&message);
 
   if (token_equals(command, COMMAND_ADD_EVENT)) {
@@ -187,11 +403,30 @@ static void handle_domain_add(FILE* rsp, struct token domain, char* message) {
   struct token name = get_token(&message);
   struct token position = get_token(&message);
 
-  if (bar_manager_get_item_index_for_name(&g_bar_manager, name.text) >= 0) {
-    respond(rsp, "[?] Add: Item '%s' already exists\n", name.text);
+  struct bar_item* bar_item = NULL;
+  int item_index = bar_manager_get_item_index_for_name(&g_bar_manager,
+                                                       name.text      );
+  if (item_index >= 0) {
+    bar_item = g_bar_manager.bar_items[item_index];
+    if (!bar_manager_reconcile_item(&g_bar_manager,
+                                    bar_item,
+                                    &g_bar_manager.default_item,
+                                    g_bar_manager.defaults_hash )) {
+      respond(rsp, "[?] Add: Item '%s' already exists\n", name.text);
+      return;
+    }
+  } else {
+    bar_item = bar_manager_create_item(&g_bar_manager);
+  }
+
+  if (!bar_manager_record_config(&g_bar_manager,
+                                 bar_item,
+                                 DOMAIN_ADD,
+                                 NULL,
+                                 line,
+                                 config_token_list_length(line))) {
     return;
   }
-  struct bar_item* bar_item = bar_manager_create_item(&g_bar_manager);
 
   if (!bar_item_set_type(bar_item, command.text)) {
     respond(rsp, "[?] Add %s: Invalid type '%s', assuming 'item'\n",
@@ -276,8 +511,9 @@ static void handle_domain_add(FILE* rsp, struct token domain, char* message) {
         if (bar_items && count > 0) {
           for (int i = 0; i < count; i++) {
             if (first) {
-              if (bar_items[i]->position == POSITION_POPUP) {
-                popup_add_item(&bar_items[i]->parent->popup, bar_item);
+              struct bar_item* parent = bar_item_get_parent(bar_items[i]);
+              if (bar_items[i]->position == POSITION_POPUP && parent) {
+                popup_add_item(&parent->popup, bar_item);
                 bar_item->position = POSITION_POPUP;
               }
               first = false;
@@ -338,7 +574,7 @@ static bool handle_domain_bar(FILE *rsp, struct token domain, char *message) {
     struct token token = get_token(&message);
     ANIMATE(bar_manager_set_y_offset,
             &g_bar_manager,
-            g_bar_manager.background.y_offset,
+            g_bar_manager.background.style->y_offset,
             token_to_int(token)      );
 
   } else if (token_equals(command, PROPERTY_BLUR_RADIUS)) {
@@ -487,20 +723,85 @@ static char* get_batch_line(char** message) {
   return rbr_msg;
 }
 
+static void serialize_caches(FILE* rsp) {
+  fprintf(rsp, "{\n\t\"text\": {\n");
+  text_cache_serialize("\t\t", rsp);
+  fprintf(rsp, "\n\t},\n\t\"fonts\": {\n");
+  font_registry_serialize("\t\t", rsp);
+  fprintf(rsp, "\n\t},\n\t\"images\": {\n");
+  image_cache_serialize("\t\t", rsp);
+  fprintf(rsp, "\n\t},\n\t\"styles\": {\n");
+  background_styles_serialize("\t\t",
+                              rsp,
+                              g_bar_manager.bar_item_count,
+                              sizeof(struct bar_item),
+                              BAR_ITEM_BACKGROUNDS         );
+  fprintf(rsp, "\n\t}\n}\n");
+}
+
+// Queries any number of items given by name or regex in one round trip,
+// optionally projected to the properties selected with fields=...
+static void handle_query_items(FILE* rsp, char* message) {
+  struct bar_item** bar_items = NULL;
+  uint32_t count = 0;
+  bool keyed = false;
+  struct query_projection projection = { 0 };
+  bool projected = false;
+
+  struct token name = get_token(&message);
+  while (name.text && name.length > 0) {
+    if (strncmp(name.text, QUERY_FIELDS_PREFIX,
+                           strlen(QUERY_FIELDS_PREFIX)) == 0) {
+      query_projection_destroy(&projection);
+      projected = query_projection_parse(&projection,
+                                         name.text
+                                         + strlen(QUERY_FIELDS_PREFIX),
+                                         rsp                           );
+      if (!projected) {
+        if (bar_items) free(bar_items);
+        return;
+      }
+    } else if (name.length > 1 && name.text[0] == REGEX_DELIMITER
+               && name.text[name.length - 1] == REGEX_DELIMITER  ) {
+      uint32_t regex_count = 0;
+      struct bar_item** matches = get_bar_items_for_regex(name,
+                                                          rsp,
+                                                          &regex_count);
+      if (matches) {
+        bar_items = realloc(bar_items, sizeof(struct bar_item*)
+                                       * (count + regex_count));
+        memcpy(bar_items + count, matches, sizeof(struct bar_item*)
+                                           * regex_count          );
+        count += regex_count;
+        free(matches);
+      }
+      keyed = true;
+    } else {
+      int item_index_for_name = bar_manager_get_item_index_for_name(&g_bar_manager,
+                                                                    name.text      );
+      if (item_index_for_name < 0) {
+        respond(rsp, "[!] Query: Item '%s' not found\n", name.text);
+      } else {
+        bar_items = realloc(bar_items, sizeof(struct bar_item*)*(count + 1));
+        bar_items[count++] = g_bar_manager.bar_items[item_index_for_name];
+      }
+      keyed |= count > 1;
+    }
+    name = get_token(&message);
+  }
+
+  query_items(bar_items, count, keyed, projected ? &projection : NULL, rsp);
+  query_projection_destroy(&projection);
+  if (bar_items) free(bar_items);
+}
+
 static void handle_domain_query(FILE* rsp, struct token domain, char* message) {
   struct token token = get_token(&message);
 
   if (token_equals(token, COMMAND_QUERY_DEFAULT_ITEMS)) {
     print_all_menu_items(rsp);
   } else if (token_equals(token, COMMAND_QUERY_ITEM)) {
-    struct token name  = get_token(&message);
-    int item_index_for_name = bar_manager_get_item_index_for_name(&g_bar_manager,
-                                                                  name.text      );
-    if (item_index_for_name < 0) {
-      respond(rsp, "[!] Query: Item '%s' not found\n", name.text);
-      return;
-    }
-    bar_item_serialize(g_bar_manager.bar_items[item_index_for_name], rsp);
+    handle_query_items(rsp, message);
   } else if (token_equals(token, COMMAND_QUERY_BAR)) {
     bar_manager_serialize(&g_bar_manager, rsp);
   } else if (token_equals(token, COMMAND_QUERY_DEFAULTS)) {
@@ -509,6 +810,26 @@ static void handle_domain_query(FILE* rsp, struct token domain, char* message) {
     custom_events_serialize(&g_bar_manager.custom_events, rsp);
   } else if (token_equals(token, COMMAND_QUERY_DISPLAYS)) {
     display_serialize(rsp);
+  } else if (token_equals(token, COMMAND_QUERY_CACHES)) {
+    serialize_caches(rsp);
+  } else if (token_equals(token, COMMAND_QUERY_CHANNELS)) {
+    channel_manager_serialize(&g_bar_manager.channel_manager, rsp);
+  } else if (token_equals(token, COMMAND_QUERY_CHANGES)) {
+    struct token since = get_token(&message);
+    uint64_t seq = 0;
+    if (strncmp(since.text, CHANGES_SINCE_PREFIX,
+                            strlen(CHANGES_SINCE_PREFIX)) == 0) {
+      seq = strtoull(since.text + strlen(CHANGES_SINCE_PREFIX), NULL, 10);
+    } else if (since.length > 0) {
+      respond(rsp, "[!] Query: Expected 'since=<seq>', but got '%s'\n",
+                   since.text                                        );
+      return;
+    }
+    change_log_serialize(&g_bar_manager.change_log, seq, rsp);
+  } else if (token_equals(token, COMMAND_QUERY_WATCHES)) {
+    watch_registry_serialize(&g_bar_manager.watch_registry, rsp);
+  } else if (token_equals(token, COMMAND_QUERY_STARTUP)) {
+    startup_serialize(rsp);
   } else {
     struct token name = token;
     int item_index_for_name = bar_manager_get_item_index_for_name(&g_bar_manager,
@@ -566,44 +887,71 @@ static void handle_domain_move(FILE* rsp, struct token domain, char* message) {
                         g_bar_manager.bar_items[item_index],
                         g_bar_manager.bar_items[reference_item_index],
                         token_equals(direction, ARGUMENT_COMMON_VAL_BEFORE));
-
-  bar_item_needs_update(g_bar_manager.bar_items[item_index]);
 }
 
 static void handle_domain_order(FILE* rsp, struct token domain, char* message) {
-  struct bar_item* ordering[g_bar_manager.bar_item_count];
-  memset(ordering, 0, sizeof(struct bar_item*)*g_bar_manager.bar_item_count);
-
+  uint32_t capacity = 16;
   uint32_t count = 0;
+  char** names = malloc(sizeof(char*) * capacity);
+
   struct token name = get_token(&message);
   while (name.text && name.length > 0) {
-    int index = bar_manager_get_item_index_for_name(&g_bar_manager, name.text);
-    if (index < 0) {
-      respond(rsp, "[!] Order: Item '%s' not found\n", name.text);
-      name = get_token(&message);
-      continue;
+    if (count == capacity) {
+      capacity *= 2;
+      names = realloc(names, sizeof(char*) * capacity);
     }
-    ordering[count] = g_bar_manager.bar_items[index];
-    count++;
-
+    names[count++] = name.text;
     name = get_token(&message);
   }
 
+  struct bar_item** ordering = malloc(sizeof(struct bar_item*) * count);
+  bar_manager_get_items_for_names(&g_bar_manager, names, count, ordering);
+  for (uint32_t i = 0; i < count; i++) {
+    if (!ordering[i]) respond(rsp, "[!] Order: Item '%s' not found\n", names[i]);
+  }
+
+  bar_manager_apply_claimed_order(&g_bar_manager);
   bar_manager_sort(&g_bar_manager, ordering, count);
   bar_manager_refresh(&g_bar_manager, false, false);
+  free(ordering);
+  free(names);
 }
 
-void handle_message_mach(struct mach_buffer* buffer) {
-  if (!buffer->message.descriptor.address) return;
-  char* message = buffer->message.descriptor.address;
-  char* response = NULL;
-  size_t length = 0;
-  FILE* rsp = open_memstream(&response, &length);
-  fprintf(rsp, "");
+// Applies a full message in one frozen transaction. Messages applied from
+// within another message (e.g. a snapshot replay) join the outer transaction.
+// Messages nest through --load and batches, the bar is frozen by the
+// outermost one and refreshed once it has been handled.
+static uint32_t g_message_depth = 0;
 
+static void message_reset_animation() {
   g_bar_manager.animator.interp_function = '\0';
   g_bar_manager.animator.duration = 0;
-  bar_manager_freeze(&g_bar_manager);
+}
+
+void handle_message_batch_begin() {
+  if (g_message_depth++ == 0) {
+    message_reset_animation();
+    bar_manager_freeze(&g_bar_manager);
+  }
+}
+
+void handle_message_batch_end() {
+  if (--g_message_depth > 0) return;
+  animator_lock(&g_bar_manager.animator);
+  bar_manager_unfreeze(&g_bar_manager);
+  bar_manager_refresh(&g_bar_manager, false, false);
+}
+
+// Handles a message that was sent on its own as part of a batch, e.g. the
+// journal of a snapshot. Its --animate does not carry over to the next one.
+void handle_message_in_batch(char* message, FILE* rsp) {
+  message_reset_animation();
+  handle_message(message, rsp);
+}
+
+void handle_message(char* message, FILE* rsp) {
+  handle_message_batch_begin();
+
   struct token command = get_token(&message);
   bool bar_needs_refresh = false;
 
@@ -634,6 +982,15 @@ void handle_message_mach(struct mach_buffer* buffer) {
         struct token token = get_token(&message);
         while (token.text && token.length > 0) {
           for (int i = 0; i < count; i++) {
+            if (!bar_manager_record_config(&g_bar_manager,
+                                           bar_items[i],
+                                           DOMAIN_SET,
+                                           bar_items[i]->name,
+                                           token.text,
+                                           token.length + 1   )) {
+              continue;
+            }
+
             struct token tmp = {string_copy(token.text), token.length};
             char* rbr_msg = reformat_batch_key_value_pair(tmp);
             free(tmp.text);
@@ -652,6 +1009,12 @@ void handle_message_mach(struct mach_buffer* buffer) {
     } else if (token_equals(command, DOMAIN_DEFAULT)) {
       struct token token = get_token(&message);
       while (token.text && token.length > 0) {
+        g_bar_manager.defaults_hash = config_hash_append(
+                                                   g_bar_manager.defaults_hash,
+                                                   DOMAIN_DEFAULT,
+                                                   NULL,
+                                                   token.text,
+                                                   token.length + 1           );
         char* rbr_msg = reformat_batch_key_value_pair(token);
           if (!rbr_msg) {
             respond(rsp, "[!] Set (default): Expected <key>=<value> pair, but got: '%s'\n", token.text);
@@ -673,7 +1036,11 @@ void handle_message_mach(struct mach_buffer* buffer) {
           respond(rsp, "[!] Bar: Expected <key>=<value> pair, but got: '%s'\n", token.text);
           break;
         }
+        bar_manager_record_bar_config(&g_bar_manager,
+                                      token.text,
+                                      token.length + 1);
         bar_needs_refresh |= handle_domain_bar(rsp, command, rbr_msg);
+        change_log_record(&g_bar_manager.change_log, NULL, CHANGE_BAR);
         free(rbr_msg);
         if (message && *message == '-') break;
         token = get_token(&message);
@@ -694,6 +1061,28 @@ void handle_message_mach(struct mach_buffer* buffer) {
       char* rbr_msg = get_batch_line(&message);
       handle_domain_push(rsp, command, rbr_msg);
       free(rbr_msg);
+    } else if (token_equals(command, DOMAIN_CHANNEL)) {
+      char* rbr_msg = get_batch_line(&message);
+      handle_domain_channel(rsp, command, rbr_msg);
+      free(rbr_msg);
+    } else if (token_equals(command, DOMAIN_TRACE)) {
+      char* rbr_msg = get_batch_line(&message);
+      handle_domain_trace(rsp, command, rbr_msg);
+      free(rbr_msg);
+    } else if (token_equals(command, DOMAIN_LOAD)) {
+      char* rbr_msg = get_batch_line(&message);
+      handle_domain_load(rsp, command, rbr_msg);
+      free(rbr_msg);
+    } else if (token_equals(command, DOMAIN_SNAPSHOT)) {
+      char* rbr_msg = get_batch_line(&message);
+      handle_domain_snapshot(rsp, command, rbr_msg);
+      free(rbr_msg);
+    } else if (token_equals(command, DOMAIN_WATCH)) {
+      char* rbr_msg = get_batch_line(&message);
+      watch_registry_parse_message(&g_bar_manager.watch_registry,
+                                   rbr_msg,
+                                   rsp                          );
+      free(rbr_msg);
     } else if (token_equals(command, DOMAIN_UPDATE)) {
       bar_manager_update(&g_bar_manager, true);
       bar_needs_refresh = true;
@@ -762,9 +1151,21 @@ void handle_message_mach(struct mach_buffer* buffer) {
     g_bar_manager.bar_needs_update = true;
   }
 
-  animator_lock(&g_bar_manager.animator);
-  bar_manager_unfreeze(&g_bar_manager);
-  bar_manager_refresh(&g_bar_manager, false, false);
+  handle_message_batch_end();
+}
+
+void handle_message_mach(struct mach_buffer* buffer) {
+  if (!buffer->message.descriptor.address) return;
+  TRACE_BEGIN(handle_message_mach);
+  char* message = buffer->message.descriptor.address;
+  char* response = NULL;
+  size_t length = 0;
+  FILE* rsp = open_memstream(&response, &length);
+  fprintf(rsp, "");
+
+  startup_mark(STARTUP_FIRST_MESSAGE);
+  snapshot_record(message);
+  handle_message(message, rsp);
 
   if (rsp) fclose(rsp);
 
@@ -773,6 +1174,7 @@ void handle_message_mach(struct mach_buffer* buffer) {
                                                              length + 1,
                                                              false      );
   if (response) free(response);
+  TRACE_END(handle_message_mach);
 }
 
 MACH_HANDLER(mach_message_handler) {
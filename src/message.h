@@ -13,6 +13,11 @@
 #include "misc/helpers.h"
 #include "misc/defines.h"
 
+#define LOAD_MAX_DEPTH 16
 
 MACH_HANDLER(mach_message_handler);
+void handle_message(char* message, FILE* rsp);
+void handle_message_batch_begin();
+void handle_message_batch_end();
+void handle_message_in_batch(char* message, FILE* rsp);
 void handle_message_mach(struct mach_buffer* buffer);
@@ -33,6 +33,20 @@
 #define DOMAIN_HOTLOAD                         "--hotload"
 #define DOMAIN_RELOAD                          "--reload"
 #define DOMAIN_ADD_FONT                        "--load-font"
+#define DOMAIN_LOAD                            "--load"
+
+#define DOMAIN_CHANNEL                         "--channel"
+
+#define DOMAIN_WATCH                           "--watch"
+
+#define DOMAIN_TRACE                           "--trace"
+#define COMMAND_TRACE_START                    "start"
+#define COMMAND_TRACE_STOP                     "stop"
+
+#define DOMAIN_SNAPSHOT                        "--snapshot"
+#define COMMAND_SNAPSHOT_SAVE                  "save"
+#define COMMAND_SNAPSHOT_LOAD                  "load"
+#define COMMAND_SNAPSHOT_AUTO                  "auto"
 
 #define SUB_DOMAIN_ICON                        "icon"
 #define SUB_DOMAIN_LABEL                       "label"
@@ -101,6 +115,10 @@
 #define PROPERTY_EVENT_PORT                    "mach_helper"
 #define PROPERTY_PERCENTAGE                    "percentage"
 #define PROPERTY_MAX_CHARS                     "max_chars"
+#define PROPERTY_INCREMENTAL                   "incremental"
+#define PROPERTY_SERIES                        "series"
+#define PROPERTY_STORAGE                       "storage"
+#define PROPERTY_COLORS                        "colors"
 
 #define DOMAIN_BAR                             "--bar"
 #define PROPERTY_POSITION                      "position"
@@ -146,6 +164,11 @@
 #define COMMAND_QUERY_BAR                      "bar"
 #define COMMAND_QUERY_EVENTS                   "events"
 #define COMMAND_QUERY_DISPLAYS                 "displays"
+#define COMMAND_QUERY_CACHES                   "caches"
+#define COMMAND_QUERY_CHANNELS                 "channels"
+#define COMMAND_QUERY_STARTUP                  "startup"
+#define COMMAND_QUERY_CHANGES                  "changes"
+#define COMMAND_QUERY_WATCHES                  "watches"
 
 #define ARGUMENT_COMMON_VAL_ON                 "on"
 #define ARGUMENT_COMMON_VAL_NOT_OFF            "!off"
@@ -10,6 +10,9 @@ extern CGError DisplayServicesGetBrightness(uint32_t did, float* brightness);
 extern CGError DisplayServicesCanChangeBrightness(uint32_t did);
 extern CGError DisplayServicesAmbientLightCompensationEnabled(uint32_t did, bool* out);
 
+extern const void* CGDataProviderRetainBytePtr(CGDataProviderRef provider);
+extern void CGDataProviderReleaseBytePtr(CGDataProviderRef provider);
+
 extern CFArrayRef SLSCopyManagedDisplaySpaces(int cid);
 extern uint32_t SLSGetActiveSpace(int cid);
 extern CFStringRef SLSCopyManagedDisplayForSpace(int cid, uint64_t sid);
@@ -0,0 +1,96 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+// XXH64 content hash. The four accumulator lanes are independent, which
+// lets the compiler keep them in vector registers for large buffers.
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t xxh_rotl64(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t xxh_read64(const unsigned char* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(uint64_t));
+  return value;
+}
+
+static inline uint32_t xxh_read32(const unsigned char* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(uint32_t));
+  return value;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+  acc += input * XXH_PRIME64_2;
+  acc = xxh_rotl64(acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxh_merge_round(uint64_t acc, uint64_t val) {
+  acc ^= xxh_round(0, val);
+  return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static inline uint64_t hash_xxh64(const void* data, size_t len, uint64_t seed) {
+  const unsigned char* p = data;
+  const unsigned char* end = p + len;
+  uint64_t hash;
+
+  if (len >= 32) {
+    uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    uint64_t v2 = seed + XXH_PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - XXH_PRIME64_1;
+
+    const unsigned char* limit = end - 32;
+    do {
+      v1 = xxh_round(v1, xxh_read64(p));
+      v2 = xxh_round(v2, xxh_read64(p + 8));
+      v3 = xxh_round(v3, xxh_read64(p + 16));
+      v4 = xxh_round(v4, xxh_read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    hash = xxh_rotl64(v1, 1) + xxh_rotl64(v2, 7)
+           + xxh_rotl64(v3, 12) + xxh_rotl64(v4, 18);
+    hash = xxh_merge_round(hash, v1);
+    hash = xxh_merge_round(hash, v2);
+    hash = xxh_merge_round(hash, v3);
+    hash = xxh_merge_round(hash, v4);
+  } else {
+    hash = seed + XXH_PRIME64_5;
+  }
+
+  hash += (uint64_t)len;
+
+  while (p + 8 <= end) {
+    hash ^= xxh_round(0, xxh_read64(p));
+    hash = xxh_rotl64(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    p += 8;
+  }
+
+  if (p + 4 <= end) {
+    hash ^= (uint64_t)xxh_read32(p) * XXH_PRIME64_1;
+    hash = xxh_rotl64(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    p += 4;
+  }
+
+  while (p < end) {
+    hash ^= (*p) * XXH_PRIME64_5;
+    hash = xxh_rotl64(hash, 11) * XXH_PRIME64_1;
+    p++;
+  }
+
+  hash ^= hash >> 33;
+  hash *= XXH_PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= XXH_PRIME64_3;
+  hash ^= hash >> 32;
+  return hash;
+}
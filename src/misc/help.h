@@ -27,6 +27,8 @@ static const char help_str[] = {
   "                                  \tAdd graph component\n"
   "      --push <name> <data point> ... <data point>\n"
   "                                  \tPush data points to a graph\n"
+  "      --channel <name> [on/off]   \tOpen a shared memory sample channel\n"
+  "      --trace start|stop <file>   \tRecord a trace in Chrome trace format\n"
   "      --add space <name> <position>\tAdd space component\n"
   "      --add bracket <name> <member name> ... <member name>\n"
   "                                  \tAdd bracket component\n"
@@ -44,9 +46,16 @@ static const char help_str[] = {
   "Querying information, see https://felixkratz.github.io/SketchyBar/config/querying\n"
   "      --query bar               \tQuery bar properties\n"
   "      --query <name>            \tQuery item properties\n"
+  "      --query item <name|/regex/>... [fields=<path>,...]\n"
+  "                                  \tQuery selected properties of several items\n"
   "      --query defaults          \tQuery default properties\n"
   "      --query events            \tQuery events\n"
-  "      --query default_menu_items\tQuery names of available items for aliases\n\n"
+  "      --query startup           \tQuery the startup timeline\n"
+  "      --query changes [since=<seq>]\tQuery the items changed since <seq>\n"
+  "      --query watches           \tQuery the watch subscribers\n"
+  "      --query default_menu_items\tQuery names of available items for aliases\n"
+  "      --watch <port> <name|/regex/>... [fields=<path>,...]\n"
+  "                                  \tPush item changes to a bootstrap port\n\n"
   "Animations, see https://felixkratz.github.io/SketchyBar/config/animations\n"
   "      --animate <linear|quadratic|tanh|sin|exp|circ> <duration> \\\n"
   "                --bar <property=value> ... <property=value>\\\n"
@@ -54,5 +63,8 @@ static const char help_str[] = {
   "                         \tAnimate from given source to target property values\n\n"
   "Reloading the config\n"
   "      --hotload <boolean>        \tEnable or disable the config hotloader\n"
-  "      --reload [optional: <path>]\tReload the current or the given config\n\n"
+  "      --reload [optional: <path>]\tReload the current or the given config\n"
+  "      --load <file>              \tApply a file of commands, one call per line\n"
+  "      --snapshot save|load <file>\tSave or replay the state built by the config\n"
+  "      --snapshot auto <boolean>  \tRestore the state on startup, then reconcile\n\n"
 };
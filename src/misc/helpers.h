@@ -4,6 +4,8 @@
 #include <ApplicationServices/ApplicationServices.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <time.h>
 #include "env_vars.h"
 #include "defines.h"
@@ -117,7 +119,7 @@ static inline void respond(FILE* rsp, char* response, ...) {
   va_list args_stdout;
   va_start(args_rsp, response);
   va_copy(args_stdout, args_rsp);
-  vfprintf(rsp, response, args_rsp);
+  if (rsp) vfprintf(rsp, response, args_rsp);
   vfprintf(stdout, response, args_stdout);
   va_end(args_rsp);
   va_end(args_stdout);
@@ -428,6 +430,37 @@ static inline bool ensure_executable_permission(char *filename) {
   return true;
 }
 
+// The per user temporary directory is only accessible by its owner, unlike
+// the shared /tmp. The directory is written with a trailing slash.
+static inline bool get_user_temp_dir(char* buffer, size_t size) {
+  size_t length = confstr(_CS_DARWIN_USER_TEMP_DIR, buffer, size);
+  if (length == 0 || length > size) {
+    char* tmpdir = getenv("TMPDIR");
+    if (!tmpdir || !*tmpdir) return false;
+    length = snprintf(buffer, size, "%s", tmpdir) + 1;
+    if (length > size) return false;
+  }
+
+  if (buffer[length - 2] != '/') {
+    if (length >= size) return false;
+    buffer[length - 1] = '/';
+    buffer[length] = '\0';
+  }
+  return true;
+}
+
+// Creates a file that only the owner can access and never follows a
+// symlink. A leftover file of the same name is replaced, hence the file must
+// live in a directory that only the owner can write to.
+static inline int create_private_file(char* path, int flags) {
+  flags |= O_CREAT | O_EXCL | O_NOFOLLOW;
+  int fd = open(path, flags, 0600);
+  if (fd < 0 && errno == EEXIST && unlink(path) == 0) {
+    fd = open(path, flags, 0600);
+  }
+  return fd;
+}
+
 static inline bool sync_exec(char *command, struct env_vars *env_vars) {
   if (env_vars) {
     for (int i = 0; i < env_vars->count; i++) {
@@ -441,14 +474,17 @@ static inline bool sync_exec(char *command, struct env_vars *env_vars) {
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
-static inline bool fork_exec(char *command, struct env_vars* env_vars) {
+static inline pid_t fork_exec_pid(char *command, struct env_vars* env_vars) {
   int pid = vfork();
-  if (pid == -1) return false;
-  if (pid !=  0) return true;
+  if (pid != 0) return pid;
 
   alarm(FORK_TIMEOUT);
   exit(sync_exec(command, env_vars));
 }
+
+static inline bool fork_exec(char *command, struct env_vars* env_vars) {
+  return fork_exec_pid(command, env_vars) != -1;
+}
 #pragma clang diagnostic pop
 
 static inline int mission_control_index(uint64_t sid) {
@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+// Single producer, single consumer sample ring shared through a memory
+// mapped file. This header has no further dependencies, such that producers
+// can include it directly: map the file printed by `--channel <name> on` and
+// write samples with ring_write_values or ring_write_text. The server drains
+// the ring once per display frame.
+#define RING_MAGIC       0x53424348
+#define RING_VERSION     1
+#define RING_CAPACITY    4096
+#define RING_MAX_VALUES  15
+#define RING_TEXT_LENGTH 60
+
+struct ring_sample {
+  // The number of values in the sample, zero marks a text sample
+  uint32_t count;
+  union {
+    float values[RING_MAX_VALUES];
+    char text[RING_TEXT_LENGTH];
+  };
+};
+
+// The write and read cursors live on separate cache lines to keep the
+// producer and the server from invalidating each others line on every
+// sample.
+struct ring_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t sample_size;
+  char padding_head[48];
+
+  uint64_t head;
+  uint64_t dropped;
+  char padding_tail[48];
+
+  uint64_t tail;
+  char padding_end[56];
+
+  struct ring_sample samples[];
+};
+
+static inline size_t ring_size(uint32_t capacity) {
+  return sizeof(struct ring_header) + sizeof(struct ring_sample) * capacity;
+}
+
+static inline void ring_init(struct ring_header* ring, uint32_t capacity) {
+  memset(ring, 0, sizeof(struct ring_header));
+  ring->capacity = capacity;
+  ring->sample_size = sizeof(struct ring_sample);
+  ring->version = RING_VERSION;
+  __atomic_store_n(&ring->magic, RING_MAGIC, __ATOMIC_RELEASE);
+}
+
+static inline struct ring_sample* ring_reserve(struct ring_header* ring) {
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  if (head - tail >= ring->capacity) {
+    __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  return &ring->samples[head % ring->capacity];
+}
+
+static inline void ring_commit(struct ring_header* ring) {
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static inline int ring_write_values(struct ring_header* ring, float* values, uint32_t count) {
+  if (count < 1) return 0;
+  struct ring_sample* sample = ring_reserve(ring);
+  if (!sample) return 0;
+
+  if (count > RING_MAX_VALUES) count = RING_MAX_VALUES;
+  memcpy(sample->values, values, sizeof(float) * count);
+  sample->count = count;
+  ring_commit(ring);
+  return 1;
+}
+
+static inline int ring_write_text(struct ring_header* ring, const char* text) {
+  struct ring_sample* sample = ring_reserve(ring);
+  if (!sample) return 0;
+
+  strncpy(sample->text, text, RING_TEXT_LENGTH - 1);
+  sample->text[RING_TEXT_LENGTH - 1] = '\0';
+  sample->count = 0;
+  ring_commit(ring);
+  return 1;
+}
@@ -23,8 +23,10 @@ void popup_init(struct popup* popup, struct bar_item* host) {
   popup->host = host;
   background_init(&popup->background);
   window_init(&popup->window);
-  color_set_hex(&popup->background.border_color, 0xffff0000);
-  color_set_hex(&popup->background.color, 0x44000000);
+
+  struct background_style* style = background_style_mut(&popup->background);
+  color_set_hex(&style->border_color, 0xffff0000);
+  color_set_hex(&style->color, 0x44000000);
 }
 
 static CGRect popup_get_frame(struct popup* popup) {
@@ -40,6 +42,11 @@ static bool popup_set_blur_radius(struct popup* popup, uint32_t radius) {
   return false;
 }
 
+// Stale handles of removed items resolve to NULL and are skipped
+static struct bar_item* popup_get_item(struct popup* popup, uint32_t index) {
+  return bar_manager_get_item(&g_bar_manager, popup->items[index]);
+}
+
 static void popup_order_windows(struct popup* popup) {
   int level = popup->topmost
               ? (kCGPopUpMenuWindowLevel)
@@ -50,7 +57,8 @@ static void popup_order_windows(struct popup* popup) {
   struct window* previous_window = NULL;
   struct window* first_window = NULL;
   for (int i = 0; i < popup->num_items; i++) {
-    struct bar_item* bar_item = popup->items[i];
+    struct bar_item* bar_item = popup_get_item(popup, i);
+    if (!bar_item) continue;
 
     struct window* window = bar_item_get_window(bar_item, popup->adid);
     window_set_level(window, level);
@@ -86,7 +94,7 @@ static void popup_calculate_popup_anchor_for_bar_item(struct popup* popup, struc
       anchor.x += (window->frame.size.width
                    - bar_item->popup.background.bounds.size.width) / 2;
     } else if (bar_item->popup.align == POSITION_LEFT) {
-      anchor.x -= bar_item->background.padding_left;
+      anchor.x -= bar_item->background.style->padding_left;
     } else {
       anchor.x += window->frame.size.width
                   - bar_item->popup.background.bounds.size.width;
@@ -94,8 +102,8 @@ static void popup_calculate_popup_anchor_for_bar_item(struct popup* popup, struc
     anchor.y += (g_bar_manager.position == POSITION_BOTTOM
                 ? (- bar_item->popup.background.bounds.size.height)
                 : window->frame.size.height);
-  } else if (bar_item->parent) {
-    struct popup* host = &bar_item->parent->popup;
+  } else if (bar_item_get_parent(bar_item)) {
+    struct popup* host = &bar_item_get_parent(bar_item)->popup;
     anchor.x = host->window.origin.x;
     if (bar_item->popup.align == POSITION_LEFT) {
       anchor.x -= bar_item->popup.background.bounds.size.width;
@@ -103,13 +111,13 @@ static void popup_calculate_popup_anchor_for_bar_item(struct popup* popup, struc
     else {
       anchor.x += host->window.frame.size.width;
     }
-    anchor.y -= host->background.border_width;
+    anchor.y -= host->background.style->border_width;
   }
   popup_set_anchor(&bar_item->popup, anchor, popup->adid);
 }
 
 void popup_calculate_bounds(struct popup* popup, struct bar* bar) {
-  uint32_t y = popup->background.border_width;
+  uint32_t y = popup->background.style->border_width;
   uint32_t x = 0;
   uint32_t total_item_width = 0;
   uint32_t width = 0;
@@ -118,19 +126,19 @@ void popup_calculate_bounds(struct popup* popup, struct bar* bar) {
   if (popup->background.enabled
       && popup->background.image.enabled) {
     uint32_t image_width = image_get_size(&popup->background.image).width;
-    width = image_width + 2*popup->background.border_width;
+    width = image_width + 2*popup->background.style->border_width;
   }
 
   if (popup->horizontal) {
     for (int j = 0; j < popup->num_items; j++) {
-      struct bar_item* bar_item = popup->items[j];
-      if (!bar_item->drawing) continue;
+      struct bar_item* bar_item = popup_get_item(popup, j);
+      if (!bar_item || !bar_item->drawing) continue;
       if (bar_item->type == BAR_COMPONENT_GROUP) continue;
       uint32_t cell_height = max(bar_item_get_height(bar_item),
                                  popup->cell_size              );
 
-      total_item_width += bar_item->background.padding_right
-                          + bar_item->background.padding_left
+      total_item_width += bar_item->background.style->padding_right
+                          + bar_item->background.style->padding_left
                           + bar_item_get_length(bar_item, false);
 
       if (cell_height > height && popup->horizontal) height = cell_height;
@@ -146,20 +154,19 @@ void popup_calculate_bounds(struct popup* popup, struct bar* bar) {
   }
 
   for (int j = 0; j < popup->num_items; j++) {
-    struct bar_item* bar_item = NULL;
-    bar_item = popup->items[j];
-    if (!bar_item->drawing) continue;
+    struct bar_item* bar_item = popup_get_item(popup, j);
+    if (!bar_item || !bar_item->drawing) continue;
     if (bar_item->type == BAR_COMPONENT_GROUP) continue;
 
     uint32_t cell_height = max(bar_item_get_height(bar_item),
                                popup->cell_size              );
 
-    uint32_t item_x = max((int)x + bar_item->background.padding_left, 0);
+    uint32_t item_x = max((int)x + bar_item->background.style->padding_left, 0);
     uint32_t item_height = popup->horizontal ? height : cell_height;
     uint32_t item_y = item_height / 2;
 
-    uint32_t item_width = bar_item->background.padding_right
-                          + bar_item->background.padding_left
+    uint32_t item_width = bar_item->background.style->padding_right
+                          + bar_item->background.style->padding_left
                           + bar_item_calculate_bounds(bar_item,
                                                       item_height,
                                                       0,
@@ -185,15 +192,16 @@ void popup_calculate_bounds(struct popup* popup, struct bar* bar) {
 
   for (int j = 0; j < popup->num_items; j++) {
     if (popup->adid <= 0) break;
-    struct bar_item* bar_item = NULL;
-    bar_item = popup->items[j];
-    if (!bar_item->drawing) continue;
+    struct bar_item* bar_item = popup_get_item(popup, j);
+    if (!bar_item || !bar_item->drawing) continue;
     if (bar_item->type != BAR_COMPONENT_GROUP) continue;
 
     uint32_t cell_height = popup->cell_size;
-    if (bar_item->group->num_members > 2) {
-      cell_height = max(bar_item_get_height(bar_item->group->members[1]),
-                        popup->cell_size                                 );
+    struct bar_item* member = bar_item->group->num_members > 2
+                              ? group_get_member(bar_item->group, 1)
+                              : NULL;
+    if (member) {
+      cell_height = max(bar_item_get_height(member), popup->cell_size);
     }
 
     uint32_t item_height = popup->horizontal ? height : cell_height;
@@ -201,29 +209,28 @@ void popup_calculate_bounds(struct popup* popup, struct bar* bar) {
 
     group_calculate_bounds(bar_item->group, bar, item_y);
 
-    window_set_frame(bar_item_get_window(bar_item->group->members[0],
-                                         popup->adid                 ),
-                     bar_item->group->bounds                           );
+    window_set_frame(bar_item_get_window(bar_item, popup->adid),
+                     bar_item->group->bounds                    );
   }
 
 
   if (popup->horizontal) {
     if (!popup->background.enabled || !popup->background.image.enabled) {
-      width = x + popup->background.border_width;
+      width = x + popup->background.style->border_width;
     }
     y += height;
   }
   else if (!popup->background.enabled || !popup->background.image.enabled) {
-    width += popup->background.border_width;
+    width += popup->background.style->border_width;
   }
-  y += popup->background.border_width;
+  y += popup->background.style->border_width;
 
   popup->background.bounds.size.width = width;
   popup->background.bounds.size.height = y;
 
   image_calculate_bounds(&popup->background.image,
-                         popup->background.border_width,
-                         popup->background.border_width
+                         popup->background.style->border_width,
+                         popup->background.style->border_width
                          + popup->background.image.bounds.size.height / 2);
 
   if (popup->adid > 0)
@@ -239,7 +246,7 @@ static void popup_create_window(struct popup* popup) {
                                       {popup->background.bounds.size.width,
                                        popup->background.bounds.size.height}});
 
-  if (!popup->background.shadow.enabled)
+  if (!popup->background.style->shadow.enabled)
     window_disable_shadow(&popup->window);
 
   CGContextSetInterpolationQuality(popup->window.context,
@@ -259,21 +266,21 @@ static void popup_close_window(struct popup* popup) {
 
 static bool popup_contains_item(struct popup* popup, struct bar_item* bar_item) {
   for (int i = 0; i < popup->num_items; i++) {
-    if (popup->items[i] == bar_item) return true;
+    if (popup->items[i] == bar_item->handle) return true;
   }
   return false;
 }
 
 void popup_add_item(struct popup* popup, struct bar_item* bar_item) {
   if (popup_contains_item(popup, bar_item)) return;
-  if (bar_item->parent) {
-    popup_remove_item(&bar_item->parent->popup, bar_item);
-  }
+  struct bar_item* parent = bar_item_get_parent(bar_item);
+  if (parent) popup_remove_item(&parent->popup, bar_item);
+
   popup->num_items++;
   popup->items = realloc(popup->items,
-                         sizeof(struct bar_item*)*popup->num_items);
-  popup->items[popup->num_items - 1] = bar_item;
-  bar_item->parent = popup->host;
+                         sizeof(item_handle)*popup->num_items);
+  popup->items[popup->num_items - 1] = bar_item->handle;
+  bar_item->parent = popup->host->handle;
   popup->needs_ordering = true;
   if (popup->num_items == 1){
     popup_draw(popup);
@@ -291,16 +298,13 @@ void popup_remove_item(struct popup* popup, struct bar_item* bar_item) {
     return;
   }
 
-  struct bar_item* tmp[popup->num_items - 1];
-  int count = 0;
+  uint32_t count = 0;
   for (int i = 0; i < popup->num_items; i++) {
-    if (popup->items[i] == bar_item) continue;
-    tmp[count++] = popup->items[i];
+    if (popup->items[i] == bar_item->handle) continue;
+    popup->items[count++] = popup->items[i];
   }
-  popup->num_items--;
-  popup->items = realloc(popup->items,
-                         sizeof(struct bar_item*)*popup->num_items);
-  memcpy(popup->items, tmp, sizeof(struct bar_item*)*popup->num_items);
+  popup->num_items = count;
+  popup->items = realloc(popup->items, sizeof(item_handle)*popup->num_items);
 }
 
 void popup_set_anchor(struct popup* popup, CGPoint anchor, uint32_t adid) {
@@ -310,7 +314,8 @@ void popup_set_anchor(struct popup* popup, CGPoint anchor, uint32_t adid) {
   if ((popup->adid != adid)) {
     popup->needs_ordering = true;
     for (int i = 0; i < popup->num_items; i++) {
-      bar_item_needs_update(popup->items[i]);
+      struct bar_item* bar_item = popup_get_item(popup, i);
+      if (bar_item) bar_item_needs_update(bar_item);
     }
   }
 
@@ -329,6 +334,7 @@ bool popup_set_drawing(struct popup* popup, bool drawing) {
   if (!drawing) popup_close_window(popup);
   popup->drawing = drawing;
   popup->adid = 0;
+  g_window_generation++;
   return true;
 }
 
@@ -345,10 +351,7 @@ void popup_draw(struct popup* popup) {
 
   window_assign_mouse_tracking_area(&popup->window, popup->window.frame);
 
-  bool shadow = popup->background.shadow.enabled;
-  popup->background.shadow.enabled = false;
-  background_draw(&popup->background, popup->window.context);
-  popup->background.shadow.enabled = shadow;
+  background_draw_without_shadow(&popup->background, popup->window.context);
 
   CGContextFlush(popup->window.context);
   window_flush(&popup->window);
@@ -361,8 +364,8 @@ void popup_draw(struct popup* popup) {
 
 void popup_change_space(struct popup* popup, uint64_t dsid, uint32_t adid) {
   for (int i = 0; i < popup->num_items; i++) {
-    struct bar_item* bar_item = popup->items[i];
-    bar_item_change_space(bar_item, dsid, adid);
+    struct bar_item* bar_item = popup_get_item(popup, i);
+    if (bar_item) bar_item_change_space(bar_item, dsid, adid);
   }
 
   if (popup->drawing) {
@@ -371,37 +374,34 @@ void popup_change_space(struct popup* popup, uint64_t dsid, uint32_t adid) {
 }
 
 void popup_destroy(struct popup* popup) {
-  for (int i = 0; i < popup->num_items; i++) {
-    bar_manager_remove_item(&g_bar_manager, popup->items[i]);
+  // Removing an item also removes it from this popup, hence the members are
+  // detached before they are removed
+  item_handle* items = popup->items;
+  uint32_t num_items = popup->num_items;
+  popup->items = NULL;
+  popup->num_items = 0;
+
+  for (int i = 0; i < num_items; i++) {
+    bar_manager_remove_item(&g_bar_manager,
+                            bar_manager_get_item(&g_bar_manager, items[i]));
   }
-  if (popup->items) free(popup->items);
+  if (items) free(items);
   background_destroy(&popup->background);
   popup_close_window(popup);
 }
 
-void popup_serialize(struct popup* popup, char* indent, FILE* rsp) {
-  char align[32] = { 0 };
+const char* popup_align_name(struct popup* popup) {
   switch (popup->align) {
-    case POSITION_LEFT:
-      snprintf(align, 32, "left");
-      break;
-    case POSITION_RIGHT:
-      snprintf(align, 32, "right");
-      break;
-    case POSITION_CENTER:
-      snprintf(align, 32, "center");
-      break;
-    case POSITION_BOTTOM:
-      snprintf(align, 32, "bottom");
-      break;
-    case POSITION_TOP:
-      snprintf(align, 32, "top");
-      break;
-    default:
-      snprintf(align, 32, "invalid");
-      break;
+    case POSITION_LEFT: return "left";
+    case POSITION_RIGHT: return "right";
+    case POSITION_CENTER: return "center";
+    case POSITION_BOTTOM: return "bottom";
+    case POSITION_TOP: return "top";
+    default: return "invalid";
   }
+}
 
+void popup_serialize(struct popup* popup, char* indent, FILE* rsp) {
   fprintf(rsp, "%s\"drawing\": \"%s\",\n"
                "%s\"horizontal\": \"%s\",\n"
                "%s\"height\": %d,\n"
@@ -414,16 +414,19 @@ void popup_serialize(struct popup* popup, char* indent, FILE* rsp) {
                indent, popup->overrides_cell_size ? popup->cell_size : -1,
                indent, popup->blur_radius,
                indent, popup->y_offset,
-               indent, align, indent                                      );
+               indent, popup_align_name(popup), indent                    );
 
   char deeper_indent[strlen(indent) + 2];
   snprintf(deeper_indent, strlen(indent) + 2, "%s\t", indent);
   background_serialize(&popup->background, deeper_indent, rsp, true);
 
   fprintf(rsp, "\n%s},\n%s\"items\": [\n", indent, indent);
+  int counter = 0;
   for (int i = 0; i < popup->num_items; i++) {
-    fprintf(rsp, "%s\t \"%s\"", indent, popup->items[i]->name);
-    if (i < popup->num_items - 1) fprintf(rsp, ",\n");
+    struct bar_item* bar_item = popup_get_item(popup, i);
+    if (!bar_item) continue;
+    if (counter++ > 0) fprintf(rsp, ",\n");
+    fprintf(rsp, "%s\t \"%s\"", indent, bar_item->name);
   }
   fprintf(rsp, "\n%s]", indent);
 }
@@ -2,6 +2,7 @@
 #include "background.h"
 #include "misc/helpers.h"
 #include "window.h"
+#include "item_store.h"
 
 struct bar_item;
 struct bar;
@@ -25,7 +26,7 @@ struct popup {
   struct window window;
 
   struct bar_item* host;
-  struct bar_item** items;
+  item_handle* items;
   uint32_t num_items;
 
   struct background background;
@@ -45,5 +46,6 @@ void popup_draw(struct popup* popup);
 void popup_destroy(struct popup* popup);
 
 void popup_change_space(struct popup* popup, uint64_t dsid, uint32_t adid);
+const char* popup_align_name(struct popup* popup);
 void popup_serialize(struct popup* popup, char* indent, FILE* rsp);
 bool popup_parse_sub_domain(struct popup* popup, FILE* rsp, struct token property, char* message);
@@ -0,0 +1,644 @@
+#include "query.h"
+#include "bar_item.h"
+#include "bar_manager.h"
+#include <stddef.h>
+#include <stdarg.h>
+
+enum query_field_type {
+  QUERY_FIELD_STRING,
+  QUERY_FIELD_BOOL,
+  QUERY_FIELD_INT,
+  QUERY_FIELD_UINT,
+  QUERY_FIELD_UINT64,
+  QUERY_FIELD_FLOAT,
+  QUERY_FIELD_QUOTED_INT,
+  QUERY_FIELD_QUOTED_FLOAT,
+  QUERY_FIELD_HEX,
+  QUERY_FIELD_STYLE_BOOL,
+  QUERY_FIELD_STYLE_INT,
+  QUERY_FIELD_STYLE_UINT,
+  QUERY_FIELD_STYLE_HEX,
+  QUERY_FIELD_BACKGROUND_HEIGHT,
+  QUERY_FIELD_FONT,
+  QUERY_FIELD_ALIGN,
+  QUERY_FIELD_TYPE,
+  QUERY_FIELD_POSITION,
+  QUERY_FIELD_WIDTH,
+  QUERY_FIELD_UPDATES,
+  QUERY_FIELD_BOUNDING_RECTS,
+  QUERY_FIELD_POPUP_HEIGHT,
+  QUERY_FIELD_POPUP_ALIGN,
+  QUERY_FIELD_POPUP_ITEMS,
+  QUERY_FIELD_BRACKET,
+  QUERY_FIELD_GRAPH_WIDTH,
+  QUERY_FIELD_GRAPH_STORAGE,
+  QUERY_FIELD_GRAPH_COLORS,
+  QUERY_FIELD_GRAPH_DATA,
+  QUERY_FIELD_SLIDER_WIDTH
+};
+
+// The offset locates the property within the item, style fields are
+// additionally located within the shared style of the background at offset.
+struct query_field {
+  const char* path;
+  enum query_field_type type;
+  size_t offset;
+  size_t style_offset;
+};
+
+#define FIELD(path, type, member) \
+  { path, type, offsetof(struct bar_item, member), 0 }
+
+#define STYLE_FIELD(path, type, background, member) \
+  { path, type, offsetof(struct bar_item, background), \
+                offsetof(struct background_style, member) }
+
+#define SHADOW_FIELDS(prefix, shadow) \
+  FIELD(prefix "drawing", QUERY_FIELD_BOOL, shadow.enabled), \
+  FIELD(prefix "color", QUERY_FIELD_HEX, shadow.color.hex), \
+  FIELD(prefix "angle", QUERY_FIELD_UINT, shadow.angle), \
+  FIELD(prefix "distance", QUERY_FIELD_UINT, shadow.distance)
+
+#define IMAGE_FIELDS(prefix, image) \
+  FIELD(prefix "value", QUERY_FIELD_STRING, image.path), \
+  FIELD(prefix "drawing", QUERY_FIELD_BOOL, image.enabled), \
+  FIELD(prefix "scale", QUERY_FIELD_FLOAT, image.scale)
+
+#define BACKGROUND_FIELDS(prefix, background) \
+  FIELD(prefix "drawing", QUERY_FIELD_BOOL, background.enabled), \
+  STYLE_FIELD(prefix "color", QUERY_FIELD_STYLE_HEX, background, color.hex), \
+  STYLE_FIELD(prefix "border_color", QUERY_FIELD_STYLE_HEX, background, \
+                                                      border_color.hex), \
+  STYLE_FIELD(prefix "border_width", QUERY_FIELD_STYLE_UINT, background, \
+                                                         border_width), \
+  FIELD(prefix "height", QUERY_FIELD_BACKGROUND_HEIGHT, background), \
+  STYLE_FIELD(prefix "corner_radius", QUERY_FIELD_STYLE_UINT, background, \
+                                                          corner_radius), \
+  STYLE_FIELD(prefix "padding_left", QUERY_FIELD_STYLE_INT, background, \
+                                                        padding_left), \
+  STYLE_FIELD(prefix "padding_right", QUERY_FIELD_STYLE_INT, background, \
+                                                         padding_right), \
+  STYLE_FIELD(prefix "y_offset", QUERY_FIELD_STYLE_INT, background, y_offset), \
+  FIELD(prefix "clip", QUERY_FIELD_FLOAT, background.clip), \
+  IMAGE_FIELDS(prefix "image.", background.image)
+
+// The shadow of a background is part of its shared style
+#define DETAILED_BACKGROUND_FIELDS(prefix, background) \
+  BACKGROUND_FIELDS(prefix, background), \
+  STYLE_FIELD(prefix "shadow.drawing", QUERY_FIELD_STYLE_BOOL, background, \
+                                                           shadow.enabled), \
+  STYLE_FIELD(prefix "shadow.color", QUERY_FIELD_STYLE_HEX, background, \
+                                                      shadow.color.hex), \
+  STYLE_FIELD(prefix "shadow.angle", QUERY_FIELD_STYLE_UINT, background, \
+                                                         shadow.angle), \
+  STYLE_FIELD(prefix "shadow.distance", QUERY_FIELD_STYLE_UINT, background, \
+                                                            shadow.distance)
+
+#define TEXT_FIELDS(prefix, text) \
+  FIELD(prefix "value", QUERY_FIELD_STRING, text.string), \
+  FIELD(prefix "drawing", QUERY_FIELD_BOOL, text.drawing), \
+  FIELD(prefix "highlight", QUERY_FIELD_BOOL, text.highlight), \
+  FIELD(prefix "color", QUERY_FIELD_HEX, text.color.hex), \
+  FIELD(prefix "highlight_color", QUERY_FIELD_HEX, text.highlight_color.hex), \
+  FIELD(prefix "padding_left", QUERY_FIELD_INT, text.padding_left), \
+  FIELD(prefix "padding_right", QUERY_FIELD_INT, text.padding_right), \
+  FIELD(prefix "y_offset", QUERY_FIELD_INT, text.y_offset), \
+  FIELD(prefix "font", QUERY_FIELD_FONT, text.font), \
+  FIELD(prefix "width", QUERY_FIELD_UINT, text.custom_width), \
+  FIELD(prefix "scroll_duration", QUERY_FIELD_UINT, text.scroll_duration), \
+  FIELD(prefix "align", QUERY_FIELD_ALIGN, text), \
+  DETAILED_BACKGROUND_FIELDS(prefix "background.", text.background), \
+  SHADOW_FIELDS(prefix "shadow.", text.shadow)
+
+// Mirrors the layout of bar_item_serialize, the paths of a sub object have
+// to be contiguous. The trailing sub objects only exist for some items, see
+// query_field_present.
+static const struct query_field g_query_fields[] = {
+  FIELD("name", QUERY_FIELD_STRING, name),
+  FIELD("type", QUERY_FIELD_TYPE, type),
+  FIELD("geometry.drawing", QUERY_FIELD_BOOL, drawing),
+  FIELD("geometry.position", QUERY_FIELD_POSITION, position),
+  FIELD("geometry.associated_space_mask", QUERY_FIELD_UINT, associated_space),
+  FIELD("geometry.associated_display_mask", QUERY_FIELD_UINT,
+                                            associated_display),
+  FIELD("geometry.ignore_association", QUERY_FIELD_BOOL, ignore_association),
+  FIELD("geometry.y_offset", QUERY_FIELD_INT, y_offset),
+  STYLE_FIELD("geometry.padding_left", QUERY_FIELD_STYLE_INT, background,
+                                                              padding_left),
+  STYLE_FIELD("geometry.padding_right", QUERY_FIELD_STYLE_INT, background,
+                                                               padding_right),
+  FIELD("geometry.scroll_texts", QUERY_FIELD_BOOL, scroll_texts),
+  FIELD("geometry.width", QUERY_FIELD_WIDTH, custom_width),
+  DETAILED_BACKGROUND_FIELDS("geometry.background.", background),
+  TEXT_FIELDS("icon.", icon),
+  TEXT_FIELDS("label.", label),
+  FIELD("scripting.script", QUERY_FIELD_STRING, script),
+  FIELD("scripting.click_script", QUERY_FIELD_STRING, click_script),
+  FIELD("scripting.update_freq", QUERY_FIELD_UINT, update_frequency),
+  FIELD("scripting.update_mask", QUERY_FIELD_UINT64, update_mask),
+  FIELD("scripting.updates", QUERY_FIELD_UPDATES, updates),
+  FIELD("bounding_rects", QUERY_FIELD_BOUNDING_RECTS, windows),
+  FIELD("popup.drawing", QUERY_FIELD_BOOL, popup.drawing),
+  FIELD("popup.horizontal", QUERY_FIELD_BOOL, popup.horizontal),
+  FIELD("popup.height", QUERY_FIELD_POPUP_HEIGHT, popup),
+  FIELD("popup.blur_radius", QUERY_FIELD_UINT, popup.blur_radius),
+  FIELD("popup.y_offset", QUERY_FIELD_INT, popup.y_offset),
+  FIELD("popup.align", QUERY_FIELD_POPUP_ALIGN, popup),
+  DETAILED_BACKGROUND_FIELDS("popup.background.", popup.background),
+  FIELD("popup.items", QUERY_FIELD_POPUP_ITEMS, popup),
+  FIELD("bracket", QUERY_FIELD_BRACKET, group),
+  FIELD("graph.color", QUERY_FIELD_HEX, graph.line_color.hex),
+  FIELD("graph.fill_color", QUERY_FIELD_HEX, graph.fill_color.hex),
+  FIELD("graph.line_width", QUERY_FIELD_QUOTED_FLOAT, graph.line_width),
+  FIELD("graph.width", QUERY_FIELD_GRAPH_WIDTH, graph),
+  FIELD("graph.incremental", QUERY_FIELD_BOOL, graph.incremental),
+  FIELD("graph.series", QUERY_FIELD_UINT, graph.series),
+  FIELD("graph.storage", QUERY_FIELD_GRAPH_STORAGE, graph),
+  FIELD("graph.colors", QUERY_FIELD_GRAPH_COLORS, graph),
+  FIELD("graph.data", QUERY_FIELD_GRAPH_DATA, graph),
+  FIELD("slider.highlight_color", QUERY_FIELD_HEX, slider.foreground_color),
+  FIELD("slider.percentage", QUERY_FIELD_QUOTED_INT, slider.percentage),
+  FIELD("slider.width", QUERY_FIELD_SLIDER_WIDTH, slider),
+  BACKGROUND_FIELDS("slider.background.", slider.background),
+  TEXT_FIELDS("slider.knob.", slider.knob),
+  FIELD("alias.owner", QUERY_FIELD_STRING, alias.owner),
+  FIELD("alias.name", QUERY_FIELD_STRING, alias.name),
+  FIELD("alias.update_freq", QUERY_FIELD_UINT, alias.update_frequency),
+  FIELD("alias.color", QUERY_FIELD_HEX, alias.color.hex),
+  FIELD("alias.scale", QUERY_FIELD_FLOAT, alias.image.scale),
+  SHADOW_FIELDS("alias.shadow.", alias.image.shadow),
+};
+
+extern struct bar_manager g_bar_manager;
+
+#define QUERY_FIELD_COUNT (sizeof(g_query_fields) / sizeof(struct query_field))
+
+static struct json_writer g_query_writer = { 0 };
+
+static void json_reserve(struct json_writer* writer, size_t length) {
+  if (writer->size + length + 1 <= writer->capacity) return;
+  size_t capacity = writer->capacity ? writer->capacity : 4096;
+  while (capacity < writer->size + length + 1) capacity *= 2;
+  writer->buffer = realloc(writer->buffer, capacity);
+  writer->capacity = capacity;
+}
+
+static void json_append(struct json_writer* writer, const char* data, size_t length) {
+  json_reserve(writer, length);
+  memcpy(writer->buffer + writer->size, data, length);
+  writer->size += length;
+}
+
+static void json_indent(struct json_writer* writer) {
+  if (writer->compact) return;
+  json_reserve(writer, writer->depth + 1);
+  writer->buffer[writer->size++] = '\n';
+  for (uint32_t i = 0; i < writer->depth; i++)
+    writer->buffer[writer->size++] = '\t';
+}
+
+void json_writer_reset(struct json_writer* writer) {
+  writer->size = 0;
+  writer->depth = 0;
+  writer->has_members[0] = false;
+}
+
+void json_writer_flush(struct json_writer* writer, FILE* rsp) {
+  if (writer->size > 0) fwrite(writer->buffer, 1, writer->size, rsp);
+  json_writer_reset(writer);
+}
+
+void json_begin_object(struct json_writer* writer) {
+  json_append(writer, "{", 1);
+  if (writer->depth < QUERY_MAX_DEPTH - 1) writer->depth++;
+  writer->has_members[writer->depth] = false;
+}
+
+void json_end_object(struct json_writer* writer) {
+  bool has_members = writer->has_members[writer->depth];
+  if (writer->depth > 0) writer->depth--;
+  if (has_members) json_indent(writer);
+  json_append(writer, "}", 1);
+}
+
+static void json_escaped(struct json_writer* writer, const char* string, size_t length) {
+  json_reserve(writer, 6 * length + 2);
+  char* cursor = writer->buffer + writer->size;
+  *cursor++ = '"';
+  for (size_t i = 0; i < length; i++) {
+    unsigned char c = string[i];
+    if (c == '"' || c == '\\') {
+      *cursor++ = '\\';
+      *cursor++ = c;
+    } else if (c == '\n') {
+      *cursor++ = '\\';
+      *cursor++ = 'n';
+    } else if (c < 0x20) {
+      cursor += snprintf(cursor, 7, "\\u%04x", c);
+    } else *cursor++ = c;
+  }
+  *cursor++ = '"';
+  writer->size = cursor - writer->buffer;
+}
+
+void json_key(struct json_writer* writer, const char* key, size_t length) {
+  if (writer->has_members[writer->depth]) json_append(writer, ",", 1);
+  writer->has_members[writer->depth] = true;
+  json_indent(writer);
+  json_escaped(writer, key, length);
+  if (writer->compact) json_append(writer, ":", 1);
+  else json_append(writer, ": ", 2);
+}
+
+void json_string(struct json_writer* writer, const char* string) {
+  if (!string) json_append(writer, "null", 4);
+  else json_escaped(writer, string, strlen(string));
+}
+
+void json_printf(struct json_writer* writer, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(writer->buffer ? writer->buffer + writer->size : NULL,
+                         writer->capacity - writer->size,
+                         format,
+                         args                                                 );
+  va_end(args);
+  if (length < 0 || writer->size + length < writer->capacity) {
+    if (length > 0) writer->size += length;
+    return;
+  }
+
+  json_reserve(writer, length);
+  va_start(args, format);
+  vsnprintf(writer->buffer + writer->size,
+            writer->capacity - writer->size,
+            format,
+            args                            );
+  va_end(args);
+  writer->size += length;
+}
+
+static void query_write_bounding_rects(struct json_writer* writer, struct bar_item* bar_item) {
+  json_begin_object(writer);
+  for (int i = 0; i < bar_item->num_windows; i++) {
+    struct window* window = bar_item->windows[i];
+    if (!window) continue;
+
+    char key[32];
+    json_key(writer, key, snprintf(key, sizeof(key), "display-%d", i + 1));
+    json_begin_object(writer);
+    json_key(writer, "origin", 6);
+    json_printf(writer, "[ %f, %f ]", window->origin.x, window->origin.y);
+    json_key(writer, "size", 4);
+    json_printf(writer, "[ %f, %f ]", window->frame.size.width,
+                                      window->frame.size.height);
+    json_end_object(writer);
+  }
+  json_end_object(writer);
+}
+
+// Lists are written on a single line
+static void query_write_popup_items(struct json_writer* writer, struct popup* popup) {
+  json_append(writer, "[ ", 2);
+  uint32_t counter = 0;
+  for (uint32_t i = 0; i < popup->num_items; i++) {
+    struct bar_item* bar_item = bar_manager_get_item(&g_bar_manager,
+                                                     popup->items[i]);
+    if (!bar_item) continue;
+    if (counter++ > 0) json_append(writer, ", ", 2);
+    json_string(writer, bar_item->name);
+  }
+  json_append(writer, " ]", 2);
+}
+
+static void query_write_bracket(struct json_writer* writer, struct group* group) {
+  json_append(writer, "[ ", 2);
+  uint32_t counter = 0;
+  for (uint32_t i = 1; group && i < group->num_members; i++) {
+    struct bar_item* member = group_get_member(group, i);
+    if (!member) continue;
+    if (counter++ > 0) json_append(writer, ", ", 2);
+    json_string(writer, member->name);
+  }
+  json_append(writer, " ]", 2);
+}
+
+// Without colors per series, all series use the line color
+static void query_write_graph_colors(struct json_writer* writer, struct graph* graph) {
+  json_append(writer, "[ ", 2);
+  for (uint32_t i = 0; i < graph->series; i++) {
+    json_printf(writer, "%s\"0x%x\"", i > 0 ? ", " : "",
+                                      graph->series_colors
+                                      ? graph->series_colors[i].hex
+                                      : graph->line_color.hex      );
+  }
+  json_append(writer, " ]", 2);
+}
+
+static void query_write_graph_data(struct json_writer* writer, struct graph* graph) {
+  json_append(writer, "[ ", 2);
+  for (uint32_t i = 0; i < graph->width && graph->samples; i++) {
+    if (i > 0) json_append(writer, ", ", 2);
+    if (graph->series == 1) {
+      json_printf(writer, "\"%f\"", graph_get_sample(graph, i));
+      continue;
+    }
+
+    json_append(writer, "[ ", 2);
+    for (uint32_t j = 0; j < graph->series; j++) {
+      json_printf(writer, "%s\"%f\"",
+                          j > 0 ? ", " : "",
+                          graph_get_sample(graph, i * graph->series + j));
+    }
+    json_append(writer, " ]", 2);
+  }
+  json_append(writer, " ]", 2);
+}
+
+static void query_write_field(struct json_writer* writer, struct bar_item* bar_item, const struct query_field* field) {
+  char* base = (char*)bar_item + field->offset;
+  char* style = NULL;
+  if (field->type == QUERY_FIELD_STYLE_BOOL
+      || field->type == QUERY_FIELD_STYLE_INT
+      || field->type == QUERY_FIELD_STYLE_UINT
+      || field->type == QUERY_FIELD_STYLE_HEX) {
+    style = (char*)((struct background*)base)->style + field->style_offset;
+  }
+
+  switch (field->type) {
+    case QUERY_FIELD_STRING:
+      json_string(writer, *(char**)base);
+      break;
+    case QUERY_FIELD_BOOL:
+      json_string(writer, format_bool(*(bool*)base));
+      break;
+    case QUERY_FIELD_INT:
+      json_printf(writer, "%d", *(int*)base);
+      break;
+    case QUERY_FIELD_UINT:
+      json_printf(writer, "%u", *(uint32_t*)base);
+      break;
+    case QUERY_FIELD_UINT64:
+      json_printf(writer, "%llu", *(uint64_t*)base);
+      break;
+    case QUERY_FIELD_FLOAT:
+      json_printf(writer, "%f", *(float*)base);
+      break;
+    case QUERY_FIELD_QUOTED_INT:
+      json_printf(writer, "\"%d\"", *(int*)base);
+      break;
+    case QUERY_FIELD_QUOTED_FLOAT:
+      json_printf(writer, "\"%f\"", *(float*)base);
+      break;
+    case QUERY_FIELD_HEX:
+      json_printf(writer, "\"0x%x\"", *(uint32_t*)base);
+      break;
+    case QUERY_FIELD_STYLE_BOOL:
+      json_string(writer, format_bool(*(bool*)style));
+      break;
+    case QUERY_FIELD_STYLE_INT:
+      json_printf(writer, "%d", *(int*)style);
+      break;
+    case QUERY_FIELD_STYLE_UINT:
+      json_printf(writer, "%u", *(uint32_t*)style);
+      break;
+    case QUERY_FIELD_STYLE_HEX:
+      json_printf(writer, "\"0x%x\"", *(uint32_t*)style);
+      break;
+    case QUERY_FIELD_BACKGROUND_HEIGHT: {
+      struct background* background = (struct background*)base;
+      json_printf(writer, "%d", background->overrides_height
+                                ? (int)background->bounds.size.height
+                                : 0                                   );
+      break;
+    }
+    case QUERY_FIELD_FONT: {
+      struct font* font = (struct font*)base;
+      json_printf(writer, "\"%s:%s:%.2f\"", font->family,
+                                            font->style,
+                                            font->size   );
+      break;
+    }
+    case QUERY_FIELD_ALIGN:
+      json_string(writer, text_align_name((struct text*)base));
+      break;
+    case QUERY_FIELD_TYPE:
+      json_string(writer, bar_item_type_name(bar_item));
+      break;
+    case QUERY_FIELD_POSITION:
+      json_string(writer, bar_item_position_name(bar_item));
+      break;
+    case QUERY_FIELD_WIDTH:
+      json_printf(writer, "%d", bar_item->has_const_width
+                                ? bar_item->custom_width
+                                : -1                    );
+      break;
+    case QUERY_FIELD_UPDATES:
+      json_string(writer, bar_item->updates_only_when_shown
+                          ? "when_shown"
+                          : format_bool(bar_item->updates) );
+      break;
+    case QUERY_FIELD_BOUNDING_RECTS:
+      query_write_bounding_rects(writer, bar_item);
+      break;
+    case QUERY_FIELD_POPUP_HEIGHT:
+      json_printf(writer, "%d", bar_item->popup.overrides_cell_size
+                                ? (int)bar_item->popup.cell_size
+                                : -1                            );
+      break;
+    case QUERY_FIELD_POPUP_ALIGN:
+      json_string(writer, popup_align_name(&bar_item->popup));
+      break;
+    case QUERY_FIELD_POPUP_ITEMS:
+      query_write_popup_items(writer, &bar_item->popup);
+      break;
+    case QUERY_FIELD_BRACKET:
+      query_write_bracket(writer, bar_item->group);
+      break;
+    case QUERY_FIELD_GRAPH_WIDTH:
+      json_printf(writer, "%u", graph_get_length(&bar_item->graph));
+      break;
+    case QUERY_FIELD_GRAPH_STORAGE:
+      json_string(writer, graph_storage_name(bar_item->graph.storage));
+      break;
+    case QUERY_FIELD_GRAPH_COLORS:
+      query_write_graph_colors(writer, &bar_item->graph);
+      break;
+    case QUERY_FIELD_GRAPH_DATA:
+      query_write_graph_data(writer, &bar_item->graph);
+      break;
+    case QUERY_FIELD_SLIDER_WIDTH:
+      json_printf(writer, "\"%d\"",
+                  (int)bar_item->slider.background.bounds.size.width);
+      break;
+  }
+}
+
+static uint32_t query_split_path(const char* path, const char** segments, size_t* lengths) {
+  uint32_t count = 0;
+  while (count < QUERY_MAX_DEPTH) {
+    const char* dot = strchr(path, '.');
+    segments[count] = path;
+    lengths[count] = dot ? dot - path : strlen(path);
+    count++;
+    if (!dot) break;
+    path = dot + 1;
+  }
+  return count;
+}
+
+// The popup, bracket, graph, slider and alias objects are only part of the
+// items which have them, as in bar_item_serialize.
+static bool query_field_present(struct bar_item* bar_item, const char* path) {
+  switch (path[0]) {
+    case 'p':
+      return strncmp(path, "popup.", 6) != 0 || bar_item->popup.num_items > 0;
+    case 'b':
+      return strcmp(path, "bracket") != 0
+             || (bar_item->type == BAR_COMPONENT_GROUP && bar_item->group);
+    case 'g':
+      return strncmp(path, "graph.", 6) != 0
+             || bar_item->type == BAR_COMPONENT_GRAPH;
+    case 's':
+      return strncmp(path, "slider.", 7) != 0
+             || bar_item->type == BAR_COMPONENT_SLIDER;
+    case 'a':
+      return strncmp(path, "alias.", 6) != 0
+             || bar_item->type == BAR_COMPONENT_ALIAS;
+    default:
+      return true;
+  }
+}
+
+// Only the selected fields are visited, the sub objects on their paths are
+// opened and closed as the walk over the field table enters and leaves them.
+void query_write_fields(struct json_writer* writer, struct bar_item* bar_item, struct query_projection* projection) {
+  const char* open[QUERY_MAX_DEPTH];
+  size_t open_lengths[QUERY_MAX_DEPTH];
+  uint32_t open_count = 0;
+
+  for (uint32_t i = 0; i < projection->count; i++) {
+    if (!projection->selected[i]
+        || !query_field_present(bar_item, g_query_fields[i].path)) {
+      continue;
+    }
+
+    const char* segments[QUERY_MAX_DEPTH];
+    size_t lengths[QUERY_MAX_DEPTH];
+    uint32_t count = query_split_path(g_query_fields[i].path, segments, lengths);
+
+    uint32_t common = 0;
+    while (common < open_count && common < count - 1
+           && open_lengths[common] == lengths[common]
+           && strncmp(open[common], segments[common], lengths[common]) == 0) {
+      common++;
+    }
+
+    for (; open_count > common; open_count--) json_end_object(writer);
+    for (; open_count < count - 1; open_count++) {
+      json_key(writer, segments[open_count], lengths[open_count]);
+      json_begin_object(writer);
+      open[open_count] = segments[open_count];
+      open_lengths[open_count] = lengths[open_count];
+    }
+
+    json_key(writer, segments[count - 1], lengths[count - 1]);
+    query_write_field(writer, bar_item, &g_query_fields[i]);
+  }
+
+  for (; open_count > 0; open_count--) json_end_object(writer);
+}
+
+void query_projection_init(struct query_projection* projection) {
+  projection->count = QUERY_FIELD_COUNT;
+  projection->selected = calloc(QUERY_FIELD_COUNT, sizeof(bool));
+}
+
+bool query_projection_select(struct query_projection* projection, const char* path, size_t length) {
+  bool found = false;
+  for (uint32_t i = 0; i < projection->count && length > 0; i++) {
+    const char* field_path = g_query_fields[i].path;
+    if (strncmp(field_path, path, length) == 0
+        && (field_path[length] == '\0' || field_path[length] == '.')) {
+      projection->selected[i] = true;
+      found = true;
+    }
+  }
+  return found;
+}
+
+bool query_projection_parse(struct query_projection* projection, char* fields, FILE* rsp) {
+  query_projection_init(projection);
+
+  bool any = false;
+  char* cursor = fields;
+  while (cursor && *cursor) {
+    char* comma = strchr(cursor, ',');
+    size_t length = comma ? comma - cursor : strlen(cursor);
+
+    bool found = query_projection_select(projection, cursor, length);
+    if (length > 0 && !found) {
+      respond(rsp, "[!] Query: Unknown field '%.*s'\n", (int)length, cursor);
+      query_projection_destroy(projection);
+      return false;
+    }
+
+    any |= found;
+    cursor = comma ? comma + 1 : NULL;
+  }
+
+  if (!any) {
+    respond(rsp, "[!] Query: No fields given\n");
+    query_projection_destroy(projection);
+    return false;
+  }
+  return true;
+}
+
+void query_projection_destroy(struct query_projection* projection) {
+  if (projection->selected) free(projection->selected);
+  projection->selected = NULL;
+  projection->count = 0;
+}
+
+// Multiple items are returned as one object keyed by the item names. Without
+// a projection the full item serialization is used.
+void query_items(struct bar_item** bar_items, uint32_t count, bool keyed, struct query_projection* projection, FILE* rsp) {
+  if (count == 0) return;
+
+  struct json_writer* writer = &g_query_writer;
+  if (!projection) {
+    if (!keyed) {
+      bar_item_serialize(bar_items[0], rsp);
+      return;
+    }
+
+    // Names are escaped through the writer, the items keep their
+    // legacy serialization
+    fprintf(rsp, "{\n");
+    for (uint32_t i = 0; i < count; i++) {
+      json_writer_reset(writer);
+      if (i > 0) json_append(writer, ",\n", 2);
+      json_string(writer, bar_items[i]->name);
+      json_append(writer, ": ", 2);
+      json_writer_flush(writer, rsp);
+      bar_item_serialize(bar_items[i], rsp);
+    }
+    fprintf(rsp, "}\n");
+    return;
+  }
+
+  json_writer_reset(writer);
+  if (keyed) json_begin_object(writer);
+  for (uint32_t i = 0; i < count; i++) {
+    if (keyed) {
+      json_key(writer, bar_items[i]->name, strlen(bar_items[i]->name));
+    }
+    json_begin_object(writer);
+    query_write_fields(writer, bar_items[i], projection);
+    json_end_object(writer);
+  }
+  if (keyed) json_end_object(writer);
+  json_append(writer, "\n", 1);
+  json_writer_flush(writer, rsp);
+}
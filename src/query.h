@@ -0,0 +1,43 @@
+#pragma once
+#include "misc/helpers.h"
+
+#define QUERY_FIELDS_PREFIX "fields="
+#define QUERY_MAX_DEPTH     8
+
+struct bar_item;
+
+// Appends JSON to a buffer which is kept across queries, strings are escaped
+// while they are copied into the buffer.
+struct json_writer {
+  char* buffer;
+  size_t size;
+  size_t capacity;
+
+  uint32_t depth;
+  bool has_members[QUERY_MAX_DEPTH];
+  bool compact;
+};
+
+void json_writer_reset(struct json_writer* writer);
+void json_writer_flush(struct json_writer* writer, FILE* rsp);
+void json_begin_object(struct json_writer* writer);
+void json_end_object(struct json_writer* writer);
+void json_key(struct json_writer* writer, const char* key, size_t length);
+void json_string(struct json_writer* writer, const char* string);
+void json_printf(struct json_writer* writer, const char* format, ...);
+
+// A projection is the set of item properties selected by a comma separated
+// list of field paths, e.g. label.value,geometry.drawing. A path selects all
+// properties below it.
+struct query_projection {
+  bool* selected;
+  uint32_t count;
+};
+
+void query_projection_init(struct query_projection* projection);
+bool query_projection_select(struct query_projection* projection, const char* path, size_t length);
+bool query_projection_parse(struct query_projection* projection, char* fields, FILE* rsp);
+void query_projection_destroy(struct query_projection* projection);
+
+void query_write_fields(struct json_writer* writer, struct bar_item* bar_item, struct query_projection* projection);
+void query_items(struct bar_item** bar_items, uint32_t count, bool keyed, struct query_projection* projection, FILE* rsp);
@@ -0,0 +1,167 @@
+#include "render_pool.h"
+#include <unistd.h>
+
+static bool render_queue_push(struct render_queue* queue, struct render_job* job) {
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->count >= RENDER_QUEUE_SIZE) {
+    pthread_mutex_unlock(&queue->mutex);
+    return false;
+  }
+
+  uint32_t slot = (queue->head + queue->count++) % RENDER_QUEUE_SIZE;
+  queue->jobs[slot] = *job;
+  pthread_mutex_unlock(&queue->mutex);
+  return true;
+}
+
+static bool render_queue_pop_back(struct render_queue* queue, struct render_job* job) {
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->count == 0) {
+    pthread_mutex_unlock(&queue->mutex);
+    return false;
+  }
+
+  uint32_t slot = (queue->head + --queue->count) % RENDER_QUEUE_SIZE;
+  *job = queue->jobs[slot];
+  pthread_mutex_unlock(&queue->mutex);
+  return true;
+}
+
+static bool render_queue_pop_front(struct render_queue* queue, struct render_job* job) {
+  pthread_mutex_lock(&queue->mutex);
+  if (queue->count == 0) {
+    pthread_mutex_unlock(&queue->mutex);
+    return false;
+  }
+
+  *job = queue->jobs[queue->head];
+  queue->head = (queue->head + 1) % RENDER_QUEUE_SIZE;
+  queue->count--;
+  pthread_mutex_unlock(&queue->mutex);
+  return true;
+}
+
+static bool render_worker_take_job(struct render_worker* worker, struct render_job* job) {
+  struct render_pool* pool = worker->pool;
+  if (render_queue_pop_back(&worker->queue, job)) return true;
+
+  for (uint32_t i = 1; i < pool->worker_count; i++) {
+    struct render_worker* victim
+                          = &pool->workers[(worker->id + i) % pool->worker_count];
+    if (render_queue_pop_front(&victim->queue, job)) return true;
+  }
+  return false;
+}
+
+static void* render_worker_proc(void* context) {
+  struct render_worker* worker = context;
+  struct render_pool* pool = worker->pool;
+
+  while (true) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->running && pool->queued == 0)
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+
+    if (!pool->running) {
+      pthread_mutex_unlock(&pool->mutex);
+      break;
+    }
+
+    // The job is taken and uncounted under the pool lock, which is also held
+    // for the push in submit, hence a non-zero count always has a job left.
+    struct render_job job;
+    bool taken = render_worker_take_job(worker, &job);
+    if (taken) pool->queued--;
+    pthread_mutex_unlock(&pool->mutex);
+    if (!taken) continue;
+
+    pool->function(job.window, job.bar_item);
+
+    pthread_mutex_lock(&pool->mutex);
+    if (--pool->pending == 0) pthread_cond_broadcast(&pool->done_cond);
+    pthread_mutex_unlock(&pool->mutex);
+  }
+
+  return NULL;
+}
+
+void render_pool_init(struct render_pool* pool, render_function* function) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  pool->worker_count = cores < 1 ? 1 : (cores > MAX_RENDER_THREADS
+                                        ? MAX_RENDER_THREADS
+                                        : cores                  );
+
+  pool->function = function;
+  pool->next_worker = 0;
+  pool->queued = 0;
+  pool->pending = 0;
+  pool->running = true;
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->work_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  for (uint32_t i = 0; i < pool->worker_count; i++) {
+    struct render_worker* worker = &pool->workers[i];
+    worker->id = i;
+    worker->pool = pool;
+    worker->queue.head = 0;
+    worker->queue.count = 0;
+    pthread_mutex_init(&worker->queue.mutex, NULL);
+  }
+
+  for (uint32_t i = 0; i < pool->worker_count; i++) {
+    pthread_create(&pool->workers[i].thread,
+                   NULL,
+                   render_worker_proc,
+                   &pool->workers[i]       );
+  }
+}
+
+bool render_pool_submit(struct render_pool* pool, struct window* window, struct bar_item* bar_item) {
+  if (!pool->running) return false;
+
+  struct render_job job = { window, bar_item };
+  uint32_t worker_id = pool->next_worker;
+  pool->next_worker = (pool->next_worker + 1) % pool->worker_count;
+
+  // The counters must be raised together with the push, otherwise a worker
+  // could steal and account for the job before it is counted.
+  pthread_mutex_lock(&pool->mutex);
+  if (!render_queue_push(&pool->workers[worker_id].queue, &job)) {
+    pthread_mutex_unlock(&pool->mutex);
+    return false;
+  }
+  pool->queued++;
+  pool->pending++;
+  pthread_cond_signal(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+  return true;
+}
+
+void render_pool_wait(struct render_pool* pool) {
+  if (!pool->running) return;
+
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->pending > 0)
+    pthread_cond_wait(&pool->done_cond, &pool->mutex);
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+void render_pool_destroy(struct render_pool* pool) {
+  if (!pool->running) return;
+  render_pool_wait(pool);
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->running = false;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (uint32_t i = 0; i < pool->worker_count; i++) {
+    pthread_join(pool->workers[i].thread, NULL);
+    pthread_mutex_destroy(&pool->workers[i].queue.mutex);
+  }
+
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_mutex_destroy(&pool->mutex);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAX_RENDER_THREADS 10
+#define RENDER_QUEUE_SIZE  64
+
+struct window;
+struct bar_item;
+
+#define RENDER_FUNCTION(name) void name(struct window* window, struct bar_item* bar_item)
+typedef RENDER_FUNCTION(render_function);
+
+struct render_job {
+  struct window* window;
+  struct bar_item* bar_item;
+};
+
+// Each worker owns a fixed job ring which is used as its payload arena.
+// The owner pops from the back, idle workers steal from the front.
+struct render_queue {
+  pthread_mutex_t mutex;
+  uint32_t head;
+  uint32_t count;
+  struct render_job jobs[RENDER_QUEUE_SIZE];
+};
+
+struct render_worker {
+  pthread_t thread;
+  uint32_t id;
+  struct render_pool* pool;
+  struct render_queue queue;
+};
+
+struct render_pool {
+  bool running;
+  uint32_t worker_count;
+  uint32_t next_worker;
+
+  uint32_t queued;
+  uint32_t pending;
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+
+  render_function* function;
+  struct render_worker workers[MAX_RENDER_THREADS];
+};
+
+void render_pool_init(struct render_pool* pool, render_function* function);
+bool render_pool_submit(struct render_pool* pool, struct window* window, struct bar_item* bar_item);
+void render_pool_wait(struct render_pool* pool);
+void render_pool_destroy(struct render_pool* pool);
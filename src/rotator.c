@@ -1,5 +1,6 @@
 #include "rotator.h"
 #include "event.h"
+#include <math.h>
 
 void rotator_manager_init(struct rotator_manager* rotator_manager) {
   rotator_manager->rotators = NULL;
@@ -108,9 +109,76 @@ struct rotator* rotator_create(void* target, CGFloat init_rotation, CGFloat rota
   rotator->enabled = false;
   rotator->target = target;
   pthread_mutex_init(&rotator->mutex, NULL);
+  pthread_mutex_init(&rotator->frames.mutex, NULL);
   return rotator;
 }
 
+static void rotator_frames_flush(struct rotator_frames* frames) {
+  if (frames->frames) {
+    for (int i = 0; i < frames->count; i++) {
+      if (frames->frames[i]) CGImageRelease(frames->frames[i]);
+    }
+    free(frames->frames);
+  }
+  if (frames->source) CGImageRelease(frames->source);
+
+  frames->frames = NULL;
+  frames->source = NULL;
+  frames->count = 0;
+}
+
+uint32_t rotator_frame_index(CGFloat rotation, uint32_t frame_count) {
+  if (frame_count == 0) return 0;
+  CGFloat normalized = fmod(rotation, 360.0);
+  if (normalized < 0) normalized += 360.0;
+
+  uint32_t index = (uint32_t)(normalized * frame_count / 360.0 + 0.5);
+  return index % frame_count;
+}
+
+CGFloat rotator_frame_rotation(uint32_t index, uint32_t frame_count) {
+  if (frame_count == 0) return 0;
+  return 360.0 * index / frame_count;
+}
+
+CGImageRef rotator_get_frame(struct rotator* rotator, CGImageRef source, uint64_t frame_bytes, rotator_render_function* render) {
+  struct rotator_frames* frames = &rotator->frames;
+  CGFloat rotation = rotator->current_rotation;
+
+  pthread_mutex_lock(&frames->mutex);
+  if (frames->source != source) {
+    rotator_frames_flush(frames);
+    frames->source = CGImageRetain(source);
+
+    uint64_t count = frame_bytes > 0 ? ROTATOR_FRAME_BUDGET / frame_bytes
+                                     : ROTATOR_FRAME_COUNT;
+    if (count > ROTATOR_FRAME_COUNT) count = ROTATOR_FRAME_COUNT;
+    if (count >= ROTATOR_MIN_FRAMES) {
+      frames->count = count;
+      frames->frames = calloc(count, sizeof(CGImageRef));
+    }
+  }
+
+  // Frames too large for the budget are rendered for every draw
+  if (!frames->frames) {
+    pthread_mutex_unlock(&frames->mutex);
+    return render(source, rotation);
+  }
+
+  uint32_t index = rotator_frame_index(rotation, frames->count);
+  if (!frames->frames[index]) {
+    frames->frames[index] = render(source,
+                                   rotator_frame_rotation(index,
+                                                          frames->count));
+  }
+
+  CGImageRef frame = frames->frames[index]
+                     ? CGImageRetain(frames->frames[index])
+                     : NULL;
+  pthread_mutex_unlock(&frames->mutex);
+  return frame;
+}
+
 void update_enabled_rotator_count(struct rotator_manager* rotator_manager) {
   int count = 0;
   for (int i = 0; i < rotator_manager->rotator_count; i++) {
@@ -145,6 +213,8 @@ void rotator_destroy(struct rotator_manager* rotator_manager, struct rotator* ro
     return;
   }
   rotator_stop(rotator_manager, rotator);
+  rotator_frames_flush(&rotator->frames);
+  pthread_mutex_destroy(&rotator->frames.mutex);
   pthread_mutex_destroy(&rotator->mutex);
   free(rotator);
 }
@@ -6,6 +6,13 @@ extern struct bar_manager g_bar_manager;
 #define ROTATOR_FUNCTION(name) bool name(void* target, CVTimeStamp* output_time);
 typedef ROTATOR_FUNCTION(rotator_function);
 
+#define ROTATOR_RENDER_FUNCTION(name) CGImageRef name(CGImageRef image_ref, CGFloat rotation)
+typedef ROTATOR_RENDER_FUNCTION(rotator_render_function);
+
+#define ROTATOR_FRAME_COUNT  120
+#define ROTATOR_MIN_FRAMES   24
+#define ROTATOR_FRAME_BUDGET (24 * 1024 * 1024)
+
 #define ROTATION_START(r) \
 {\
   rotator_start(&g_bar_manager.rotator_manager, r);\
@@ -22,6 +29,15 @@ typedef ROTATOR_FUNCTION(rotator_function);
 }
 
 
+// Pre-rendered frames of the rotated source image at quantized angles. The
+// frames are rendered on first use and dropped when the source changes.
+struct rotator_frames {
+    pthread_mutex_t mutex;
+    CGImageRef source;
+    CGImageRef* frames;
+    uint32_t count;
+};
+
 // Structure to encapsulate the state of the image rotator
 struct rotator {
     CGFloat current_rotation;      // Current rotation (degrees)
@@ -31,6 +47,7 @@ struct rotator {
     bool enabled;
     bool inited;
     void* target;
+    struct rotator_frames frames; // Rotation frame cache
 };
 
 struct rotator_manager {
@@ -55,3 +72,7 @@ void rotator_destroy(struct rotator_manager* rotator_manager, struct rotator* ro
 void update_enabled_rotator_count(struct rotator_manager* rotator_manager);
 bool rotator_update(struct rotator* rotator, CVTimeStamp* output_time);
 
+uint32_t rotator_frame_index(CGFloat rotation, uint32_t frame_count);
+CGFloat rotator_frame_rotation(uint32_t index, uint32_t frame_count);
+CGImageRef rotator_get_frame(struct rotator* rotator, CGImageRef source, uint64_t frame_bytes, rotator_render_function* render);
+
@@ -13,13 +13,13 @@ void shadow_init(struct shadow* shadow) {
   color_init(&shadow->color, 0xff000000);
 }
 
-static bool shadow_set_enabled(struct shadow* shadow, bool enabled) {
+bool shadow_set_enabled(struct shadow* shadow, bool enabled) {
   if (shadow->enabled == enabled) return false;
   shadow->enabled = enabled;
   return true;
 }
 
-static bool shadow_set_angle(struct shadow* shadow, uint32_t angle) {
+bool shadow_set_angle(struct shadow* shadow, uint32_t angle) {
   if (shadow->angle == angle) return false;
   shadow->angle = angle;
   shadow->offset.x = ((float)shadow->distance)*cos(((double)shadow->angle)*deg_to_rad);
@@ -27,7 +27,7 @@ static bool shadow_set_angle(struct shadow* shadow, uint32_t angle) {
   return true;
 }
 
-static bool shadow_set_distance(struct shadow* shadow, uint32_t distance) {
+bool shadow_set_distance(struct shadow* shadow, uint32_t distance) {
   if (shadow->distance == distance) return false;
   shadow->distance = distance;
   shadow->offset.x = ((float)shadow->distance)
@@ -37,7 +37,7 @@ static bool shadow_set_distance(struct shadow* shadow, uint32_t distance) {
   return true;
 }
 
-static bool shadow_set_color(struct shadow* shadow, uint32_t color) {
+bool shadow_set_color(struct shadow* shadow, uint32_t color) {
   bool changed = shadow_set_enabled(shadow, true);
   return color_set_hex(&shadow->color, color) || changed;
 }
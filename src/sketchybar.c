@@ -9,6 +9,7 @@
 #include "misc/help.h"
 #include "media.h"
 #include "hotload.h"
+#include "startup.h"
 #include <libgen.h>
 
 #define LCFILE_PATH_FMT  "/tmp/%s_%s.lock"
@@ -188,6 +189,7 @@ static void system_events(uint32_t event, void* data, size_t data_length, void*
 }
 
 int main(int argc, char **argv) {
+  startup_mark(STARTUP_MAIN);
   snprintf(g_name, sizeof(g_name), "%s", basename(argv[0]));
 
   if (is_root())
@@ -200,6 +202,7 @@ int main(int argc, char **argv) {
   pid_for_task(mach_task_self(), &g_pid);
   init_misc_settings();
   acquire_lockfile();
+  startup_mark(STARTUP_SETTINGS);
 
   SLSRegisterNotifyProc((void*)system_events, 904, NULL);
   SLSRegisterNotifyProc((void*)system_events, 905, NULL);
@@ -221,19 +224,22 @@ int main(int argc, char **argv) {
   mouse_begin();
   display_begin();
   workspace_event_handler_begin(&g_workspace_context);
+  startup_mark(STARTUP_DISPLAY_BEGIN);
 
   windows_freeze();
   bar_manager_begin(&g_bar_manager);
   windows_unfreeze();
+  startup_mark(STARTUP_BAR_MANAGER_BEGIN);
 
   if (!mach_server_begin(&g_mach_server, mach_message_handler))
     error("%s: could not initialize daemon! abort..\n", g_name);
+  startup_mark(STARTUP_MACH_SERVER);
 
   begin_receiving_power_events();
   begin_receiving_network_events();
   initialize_media_events();
 
-  exec_config_file();
+  load_config();
   begin_receiving_config_change_events();
 
   #if __MAC_OS_X_VERSION_MAX_ALLOWED >= 140000
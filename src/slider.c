@@ -14,7 +14,7 @@ static bool slider_set_foreground_color(struct slider* slider, uint32_t color) {
   return background_set_color(&slider->foreground, color);
 }
 
-static bool slider_set_percentage(struct slider* slider, uint32_t percentage) {
+bool slider_set_percentage(struct slider* slider, uint32_t percentage) {
   if (percentage == slider->percentage) return false;
   slider->percentage = max(min(percentage, 100), 0);
   return true;
@@ -0,0 +1,270 @@
+#include "snapshot.h"
+#include "message.h"
+#include "misc/hash.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <libgen.h>
+
+extern char g_config_file[4096];
+extern char g_name[256];
+
+static struct snapshot g_snapshot_recording = { 0 };
+static struct snapshot g_snapshot = { 0 };
+static bool g_snapshot_recording_active = false;
+static bool g_snapshot_automatic = false;
+
+// Messages which only read state or have side effects outside of it
+static char* g_snapshot_skipped_domains[] = { DOMAIN_QUERY,
+                                              DOMAIN_TRIGGER,
+                                              DOMAIN_RELOAD,
+                                              DOMAIN_EXIT,
+                                              DOMAIN_SNAPSHOT,
+                                              DOMAIN_TRACE,
+                                              DOMAIN_WATCH     };
+
+static void snapshot_clear(struct snapshot* snapshot) {
+  if (snapshot->data) free(snapshot->data);
+  memset(snapshot, 0, sizeof(struct snapshot));
+}
+
+static size_t snapshot_message_length(char* message) {
+  char* cursor = message;
+  while (cursor[0] != '\0' || cursor[1] != '\0') cursor++;
+  return cursor - message + 2;
+}
+
+static void snapshot_append(struct snapshot* snapshot, char* message, uint32_t length) {
+  snapshot->data = realloc(snapshot->data,
+                           snapshot->size + sizeof(uint32_t) + length);
+  memcpy(snapshot->data + snapshot->size, &length, sizeof(uint32_t));
+  memcpy(snapshot->data + snapshot->size + sizeof(uint32_t), message, length);
+  snapshot->size += sizeof(uint32_t) + length;
+  snapshot->count++;
+}
+
+static uint64_t snapshot_config_hash() {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s", g_config_file);
+  char* directory = dirname(path);
+  return hash_xxh64(directory, strlen(directory), 0);
+}
+
+// Replaying a snapshot runs the scripts it sets, hence the automatic
+// snapshot lives in the per user temporary directory, where no other user
+// can plant one.
+static bool snapshot_automatic_path(char* buffer, size_t size) {
+  char directory[MAXLEN];
+  if (!*g_config_file || !get_user_temp_dir(directory, sizeof(directory)))
+    return false;
+
+  snprintf(buffer, size, SNAPSHOT_PATH_FMT, directory,
+                                           g_name,
+                                           snapshot_config_hash());
+  return true;
+}
+
+static bool snapshot_write(char* path, uint32_t flags, FILE* rsp) {
+  struct snapshot* snapshot = g_snapshot.count > 0
+                              ? &g_snapshot
+                              : &g_snapshot_recording;
+
+  if (snapshot->count == 0) {
+    respond(rsp, "[!] Snapshot: Nothing has been recorded yet\n");
+    return false;
+  }
+
+  // Written to a temporary file first, such that a concurrent load never
+  // observes a partial snapshot
+  char tmp_path[MAXLEN + 8];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  int fd = create_private_file(tmp_path, O_WRONLY);
+  FILE* file = fd >= 0 ? fdopen(fd, "w") : NULL;
+  if (!file) {
+    if (fd >= 0) close(fd);
+    respond(rsp, "[!] Snapshot: Could not open '%s'\n", path);
+    return false;
+  }
+
+  struct snapshot_header header = { .magic = SNAPSHOT_MAGIC,
+                                    .version = SNAPSHOT_VERSION,
+                                    .config_hash = snapshot_config_hash(),
+                                    .count = snapshot->count,
+                                    .flags = flags,
+                                    .size = snapshot->size               };
+
+  bool success = fwrite(&header, sizeof(header), 1, file) == 1
+                 && fwrite(snapshot->data, snapshot->size, 1, file) == 1;
+  success &= fclose(file) == 0;
+
+  if (!success || rename(tmp_path, path) != 0) {
+    unlink(tmp_path);
+    respond(rsp, "[!] Snapshot: Could not write '%s'\n", path);
+    return false;
+  }
+  return true;
+}
+
+bool snapshot_save(char* path, FILE* rsp) {
+  return snapshot_write(path, 0, rsp);
+}
+
+void snapshot_begin_recording() {
+  snapshot_clear(&g_snapshot_recording);
+  g_snapshot_recording_active = true;
+}
+
+void snapshot_record(char* message) {
+  if (!g_snapshot_recording_active || !message || !*message) return;
+
+  for (int i = 0; i < array_count(g_snapshot_skipped_domains); i++) {
+    if (string_equals(message, g_snapshot_skipped_domains[i])) return;
+  }
+
+  snapshot_append(&g_snapshot_recording,
+                  message,
+                  snapshot_message_length(message));
+}
+
+void snapshot_end_recording() {
+  if (!g_snapshot_recording_active) return;
+  g_snapshot_recording_active = false;
+  if (g_snapshot_recording.count == 0) return;
+
+  snapshot_clear(&g_snapshot);
+  g_snapshot = g_snapshot_recording;
+  memset(&g_snapshot_recording, 0, sizeof(struct snapshot));
+
+  char path[MAXLEN];
+  if (g_snapshot_automatic && snapshot_automatic_path(path, MAXLEN))
+    snapshot_write(path, SNAPSHOT_FLAG_AUTOMATIC, NULL);
+}
+
+// All messages are replayed as one batch, the bar is frozen once and
+// refreshed once after the last of them.
+static bool snapshot_replay(char* data, uint64_t size, uint32_t count, FILE* rsp) {
+  uint64_t offset = 0;
+  bool success = true;
+  handle_message_batch_begin();
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t length;
+    if (offset + sizeof(uint32_t) > size) {
+      success = false;
+      break;
+    }
+    memcpy(&length, data + offset, sizeof(uint32_t));
+    offset += sizeof(uint32_t);
+    if (length > size - offset) {
+      success = false;
+      break;
+    }
+
+    // The mapping is read only and the blob is not trusted to be terminated
+    char* message = malloc(length + 2);
+    memcpy(message, data + offset, length);
+    message[length] = '\0';
+    message[length + 1] = '\0';
+    offset += length;
+
+    snapshot_record(message);
+    handle_message_in_batch(message, rsp);
+    free(message);
+  }
+  handle_message_batch_end();
+  return success;
+}
+
+static bool snapshot_load_internal(char* path, FILE* rsp, bool automatic) {
+  int fd = open(path, O_RDONLY | O_NOFOLLOW);
+  if (fd < 0) {
+    respond(rsp, "[!] Snapshot: Could not open '%s'\n", path);
+    return false;
+  }
+
+  // Only a snapshot no other user could have written is replayed
+  struct stat info;
+  if (fstat(fd, &info) != 0
+      || !S_ISREG(info.st_mode)
+      || info.st_uid != getuid()
+      || info.st_mode & (S_IWGRP | S_IWOTH)) {
+    close(fd);
+    respond(rsp, "[!] Snapshot: Refusing to load '%s', it is not a private "
+                 "file of this user\n", path                               );
+    return false;
+  }
+
+  if (info.st_size < sizeof(struct snapshot_header)) {
+    close(fd);
+    respond(rsp, "[!] Snapshot: Invalid snapshot '%s'\n", path);
+    return false;
+  }
+
+  void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    respond(rsp, "[!] Snapshot: Could not map '%s'\n", path);
+    return false;
+  }
+
+  struct snapshot_header* header = mapping;
+  bool valid = header->magic == SNAPSHOT_MAGIC
+               && header->version == SNAPSHOT_VERSION
+               && header->size <= info.st_size - sizeof(struct snapshot_header)
+               && (!automatic
+                   || (header->flags & SNAPSHOT_FLAG_AUTOMATIC
+                       && header->config_hash == snapshot_config_hash()));
+
+  if (!valid) {
+    munmap(mapping, info.st_size);
+    respond(rsp, "[!] Snapshot: Invalid snapshot '%s'\n", path);
+    return false;
+  }
+
+  bool success = snapshot_replay((char*)mapping + sizeof(struct snapshot_header),
+                                 header->size,
+                                 header->count,
+                                 rsp                                            );
+  munmap(mapping, info.st_size);
+
+  if (!success) respond(rsp, "[!] Snapshot: Truncated snapshot '%s'\n", path);
+  return success;
+}
+
+bool snapshot_load(char* path, FILE* rsp) {
+  return snapshot_load_internal(path, rsp, false);
+}
+
+// Restores the state of the previous session for this config directory, the
+// config is expected to run afterwards to reconcile any changes. Automatic
+// mode stays enabled as it was persisted in the snapshot.
+bool snapshot_load_automatic() {
+  char path[MAXLEN];
+  if (!snapshot_automatic_path(path, MAXLEN) || !file_exists(path))
+    return false;
+
+  char* response = NULL;
+  size_t length = 0;
+  FILE* rsp = open_memstream(&response, &length);
+  bool success = snapshot_load_internal(path, rsp, true);
+  fclose(rsp);
+  if (response) free(response);
+
+  if (!success) unlink(path);
+  else g_snapshot_automatic = true;
+  return success;
+}
+
+void snapshot_set_automatic(bool automatic) {
+  g_snapshot_automatic = automatic;
+
+  char path[MAXLEN];
+  if (!snapshot_automatic_path(path, MAXLEN)) return;
+
+  if (!automatic) unlink(path);
+  else if (g_snapshot.count > 0)
+    snapshot_write(path, SNAPSHOT_FLAG_AUTOMATIC, NULL);
+}
+
+bool snapshot_get_automatic() {
+  return g_snapshot_automatic;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "misc/helpers.h"
+
+#define SNAPSHOT_MAGIC    0x4e534253
+#define SNAPSHOT_VERSION  2
+#define SNAPSHOT_PATH_FMT "%s%s.%016llx.snapshot"
+
+// Set on the snapshots written while --snapshot auto is enabled, only those
+// are restored on startup
+#define SNAPSHOT_FLAG_AUTOMATIC 1
+
+// A snapshot is the journal of all state changing messages the config sent,
+// stored as length prefixed message blobs behind this header. Loading it
+// replays the messages in process, which skips the process launch and mach
+// round trip of every single config call.
+struct snapshot_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t config_hash;
+  uint32_t count;
+  uint32_t flags;
+  uint64_t size;
+};
+
+struct snapshot {
+  char* data;
+  size_t size;
+  uint32_t count;
+};
+
+void snapshot_begin_recording();
+void snapshot_record(char* message);
+void snapshot_end_recording();
+
+bool snapshot_save(char* path, FILE* rsp);
+bool snapshot_load(char* path, FILE* rsp);
+bool snapshot_load_automatic();
+void snapshot_set_automatic(bool automatic);
+bool snapshot_get_automatic();
@@ -0,0 +1,82 @@
+#include "startup.h"
+#include <sys/sysctl.h>
+
+static struct startup g_startup = { 0 };
+
+static char* g_startup_phase_names[] = {
+  [STARTUP_MAIN]              = "main",
+  [STARTUP_SETTINGS]          = "settings",
+  [STARTUP_DISPLAY_BEGIN]     = "display_begin",
+  [STARTUP_BAR_MANAGER_BEGIN] = "bar_manager_begin",
+  [STARTUP_MACH_SERVER]       = "mach_server",
+  [STARTUP_SNAPSHOT_LOADED]   = "snapshot_loaded",
+  [STARTUP_CONFIG_FORKED]     = "config_forked",
+  [STARTUP_FIRST_MESSAGE]     = "first_message",
+  [STARTUP_FIRST_FRAME]       = "first_frame",
+  [STARTUP_CONFIG_EXITED]     = "config_exited",
+};
+
+static char* g_startup_counter_names[] = {
+  [STARTUP_WINDOWS] = "windows",
+  [STARTUP_FONTS]   = "fonts",
+  [STARTUP_IMAGES]  = "images",
+};
+
+static inline uint64_t startup_now() {
+  return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+void startup_mark(enum startup_phase phase) {
+  if (g_startup.phases[phase]) return;
+  g_startup.phases[phase] = startup_now();
+}
+
+void startup_count(enum startup_counter counter) {
+  if (g_startup.phases[STARTUP_FIRST_FRAME]) return;
+  __atomic_fetch_add(&g_startup.counters[counter], 1, __ATOMIC_RELAXED);
+}
+
+// Time between the launch of the process and main, which includes dyld and
+// framework initialization. The kernel only records the launch in wall time.
+static double startup_launch_ms() {
+  int mib[4] = { CTL_KERN, KERN_PROC, KERN_PROC_PID, getpid() };
+  struct kinfo_proc info;
+  size_t size = sizeof(info);
+  if (sysctl(mib, 4, &info, &size, NULL, 0) != 0) return 0.0;
+
+  struct timeval launch = info.kp_proc.p_starttime;
+  uint64_t launch_ns = (uint64_t)launch.tv_sec * 1000000000ULL
+                       + (uint64_t)launch.tv_usec * 1000ULL;
+  uint64_t wall_ns = clock_gettime_nsec_np(CLOCK_REALTIME);
+  uint64_t main_age = startup_now() - g_startup.phases[STARTUP_MAIN];
+  if (wall_ns < launch_ns + main_age) return 0.0;
+
+  return (wall_ns - main_age - launch_ns) / 1e6;
+}
+
+void startup_serialize(FILE* rsp) {
+  uint64_t origin = g_startup.phases[STARTUP_MAIN];
+  fprintf(rsp, "{\n"
+               "\t\"launch_to_main_ms\": %.3f,\n"
+               "\t\"phases_ms\": {\n",
+               startup_launch_ms()           );
+
+  bool first = true;
+  for (int i = 0; i < STARTUP_PHASE_COUNT; i++) {
+    if (!g_startup.phases[i]) continue;
+    fprintf(rsp, "%s\t\t\"%s\": %.3f",
+                 first ? "" : ",\n",
+                 g_startup_phase_names[i],
+                 (g_startup.phases[i] - origin) / 1e6);
+    first = false;
+  }
+
+  fprintf(rsp, "\n\t},\n\t\"before_first_frame\": {\n");
+  for (int i = 0; i < STARTUP_COUNTER_COUNT; i++) {
+    fprintf(rsp, "\t\t\"%s\": %u%s\n",
+                 g_startup_counter_names[i],
+                 g_startup.counters[i],
+                 i < STARTUP_COUNTER_COUNT - 1 ? "," : "");
+  }
+  fprintf(rsp, "\t}\n}\n");
+}
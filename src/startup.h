@@ -0,0 +1,34 @@
+#pragma once
+#include "misc/helpers.h"
+
+enum startup_phase {
+  STARTUP_MAIN,
+  STARTUP_SETTINGS,
+  STARTUP_DISPLAY_BEGIN,
+  STARTUP_BAR_MANAGER_BEGIN,
+  STARTUP_MACH_SERVER,
+  STARTUP_SNAPSHOT_LOADED,
+  STARTUP_CONFIG_FORKED,
+  STARTUP_FIRST_MESSAGE,
+  STARTUP_FIRST_FRAME,
+  STARTUP_CONFIG_EXITED,
+  STARTUP_PHASE_COUNT
+};
+
+enum startup_counter {
+  STARTUP_WINDOWS,
+  STARTUP_FONTS,
+  STARTUP_IMAGES,
+  STARTUP_COUNTER_COUNT
+};
+
+// Monotonic timestamps of the startup phases, each one is only taken the
+// first time the phase is reached. The counters stop at the first frame.
+struct startup {
+  uint64_t phases[STARTUP_PHASE_COUNT];
+  uint32_t counters[STARTUP_COUNTER_COUNT];
+};
+
+void startup_mark(enum startup_phase phase);
+void startup_count(enum startup_counter counter);
+void startup_serialize(FILE* rsp);
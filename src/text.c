@@ -39,21 +39,30 @@ static void text_calculate_truncated_width(struct text* text, CFDictionaryRef at
   }
 }
 
-static void text_prepare_line(struct text* text) {
-  const void *keys[] = { kCTFontAttributeName,
-                         kCTForegroundColorFromContextAttributeName };
+static void text_apply_metrics(struct text* text, struct text_metrics* metrics) {
+  text->line.line = metrics->line;
+  text->line.ascent = metrics->ascent;
+  text->line.descent = metrics->descent;
+  text->bounds = metrics->bounds;
+  text->width = metrics->width;
+}
 
-  if (text->font.font_changed) {
+static void text_prepare_line(struct text* text) {
+  if (text->font.font_changed || !text->font.handle) {
     font_create_ctfont(&text->font);
     text->font.font_changed = false;
   }
-  const void *values[] = { text->font.ct_font, kCFBooleanTrue };
-  CFDictionaryRef attributes = CFDictionaryCreate(NULL,
-                                                  keys,
-                                                  values,
-                                                  array_count(keys),
-                                                  &kCFTypeDictionaryKeyCallBacks,
-                                                  &kCFTypeDictionaryValueCallBacks);
+
+  struct text_metrics metrics;
+  if (text_cache_lookup(text->font.handle,
+                        text->string,
+                        text->max_chars,
+                        &metrics        )) {
+    text_apply_metrics(text, &metrics);
+    return;
+  }
+
+  CFDictionaryRef attributes = text->font.handle->attributes;
 
   CFStringRef string = CFStringCreateWithCString(NULL,
                                                  text->string,
@@ -88,7 +97,17 @@ static void text_prepare_line(struct text* text) {
   CFRelease(attr_string);
 
   text_calculate_truncated_width(text, attributes);
-  CFRelease(attributes);
+
+  metrics = (struct text_metrics){ text->line.line,
+                                   text->line.ascent,
+                                   text->line.descent,
+                                   text->bounds,
+                                   text->width         };
+
+  text_cache_insert(text->font.handle,
+                    text->string,
+                    text->max_chars,
+                    &metrics        );
 }
 
 static void text_destroy_line(struct text* text) {
@@ -342,7 +361,7 @@ void text_draw(struct text* text, CGContextRef context) {
     CGContextSetTextPosition(context,
                              bounds.origin.x + text->padding_left,
                              bounds.origin.y + text->y_offset     );
-    CTLineDraw(text->line.line, context);
+    text_cache_draw_line(text->line.line, context);
   }
 
   struct color color = text->highlight ? text->highlight_color : text->color;
@@ -352,33 +371,22 @@ void text_draw(struct text* text, CGContextRef context) {
                            text->bounds.origin.x + text->padding_left
                            - text->scroll,
                            text->bounds.origin.y + text->y_offset    );
-  CTLineDraw(text->line.line, context);
+  text_cache_draw_line(text->line.line, context);
   CGContextRestoreGState(context);
 }
 
-void text_serialize(struct text* text, char* indent, FILE* rsp) {
-  char align[32] = { 0 };
+const char* text_align_name(struct text* text) {
   switch (text->align) {
-    case POSITION_LEFT:
-      snprintf(align, 32, "left");
-      break;
-    case POSITION_RIGHT:
-      snprintf(align, 32, "right");
-      break;
-    case POSITION_CENTER:
-      snprintf(align, 32, "center");
-      break;
-    case POSITION_BOTTOM:
-      snprintf(align, 32, "bottom");
-      break;
-    case POSITION_TOP:
-      snprintf(align, 32, "top");
-      break;
-    default:
-      snprintf(align, 32, "invalid");
-      break;
+    case POSITION_LEFT: return "left";
+    case POSITION_RIGHT: return "right";
+    case POSITION_CENTER: return "center";
+    case POSITION_BOTTOM: return "bottom";
+    case POSITION_TOP: return "top";
+    default: return "invalid";
   }
+}
 
+void text_serialize(struct text* text, char* indent, FILE* rsp) {
   fprintf(rsp, "%s\"value\": \"%s\",\n"
                "%s\"drawing\": \"%s\",\n"
                "%s\"highlight\": \"%s\",\n"
@@ -403,7 +411,7 @@ void text_serialize(struct text* text, char* indent, FILE* rsp) {
                indent, text->font.family, text->font.style, text->font.size,
                indent, text->custom_width,
                indent, text->scroll_duration,
-               indent, align, indent                                        );
+               indent, text_align_name(text), indent                        );
 
   char deeper_indent[strlen(indent) + 2];
   snprintf(deeper_indent, strlen(indent) + 2, "%s\t", indent);
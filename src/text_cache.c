@@ -0,0 +1,151 @@
+#include "text_cache.h"
+
+static struct text_cache g_text_cache = { 0 };
+static pthread_mutex_t g_text_line_locks[TEXT_LINE_LOCKS];
+static pthread_once_t g_text_line_locks_once = PTHREAD_ONCE_INIT;
+
+static uint64_t text_cache_hash_bytes(uint64_t hash, const void* data, size_t size) {
+  const unsigned char* bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static uint64_t text_cache_hash(struct font_handle* font, char* string, uint32_t max_chars) {
+  uint64_t hash = font->hash;
+  hash = text_cache_hash_bytes(hash, string, strlen(string) + 1);
+  hash = text_cache_hash_bytes(hash, &max_chars, sizeof(uint32_t));
+  return hash;
+}
+
+static bool text_cache_entry_matches(struct text_cache_entry* entry, uint64_t hash, struct font_handle* font, char* string, uint32_t max_chars) {
+  return entry->hash == hash
+         && entry->font == font
+         && entry->max_chars == max_chars
+         && string_equals(entry->string, string);
+}
+
+static void text_cache_unlink(struct text_cache_entry* entry) {
+  if (entry->prev) entry->prev->next = entry->next;
+  else g_text_cache.head = entry->next;
+
+  if (entry->next) entry->next->prev = entry->prev;
+  else g_text_cache.tail = entry->prev;
+
+  entry->prev = NULL;
+  entry->next = NULL;
+}
+
+static void text_cache_push_front(struct text_cache_entry* entry) {
+  entry->prev = NULL;
+  entry->next = g_text_cache.head;
+  if (g_text_cache.head) g_text_cache.head->prev = entry;
+  g_text_cache.head = entry;
+  if (!g_text_cache.tail) g_text_cache.tail = entry;
+}
+
+static void text_cache_entry_destroy(struct text_cache_entry* entry) {
+  struct text_cache_entry** link
+                          = &g_text_cache.buckets[entry->hash
+                                                  % TEXT_CACHE_BUCKETS];
+  while (*link && *link != entry) link = &(*link)->chain;
+  if (*link) *link = entry->chain;
+
+  text_cache_unlink(entry);
+  if (entry->metrics.line) CFRelease(entry->metrics.line);
+  font_handle_release(entry->font);
+  free(entry->string);
+  free(entry);
+  g_text_cache.count--;
+}
+
+bool text_cache_lookup(struct font_handle* font, char* string, uint32_t max_chars, struct text_metrics* metrics) {
+  if (!font || !string) return false;
+
+  uint64_t hash = text_cache_hash(font, string, max_chars);
+  struct text_cache_entry* entry = g_text_cache.buckets[hash
+                                                        % TEXT_CACHE_BUCKETS];
+  while (entry) {
+    if (text_cache_entry_matches(entry, hash, font, string, max_chars)) {
+      if (entry != g_text_cache.head) {
+        text_cache_unlink(entry);
+        text_cache_push_front(entry);
+      }
+
+      *metrics = entry->metrics;
+      CFRetain(metrics->line);
+      g_text_cache.hits++;
+      return true;
+    }
+    entry = entry->chain;
+  }
+
+  g_text_cache.misses++;
+  return false;
+}
+
+void text_cache_insert(struct font_handle* font, char* string, uint32_t max_chars, struct text_metrics* metrics) {
+  if (!font || !string || !metrics->line) return;
+
+  if (g_text_cache.count >= TEXT_CACHE_CAPACITY && g_text_cache.tail) {
+    text_cache_entry_destroy(g_text_cache.tail);
+    g_text_cache.evictions++;
+  }
+
+  struct text_cache_entry* entry = malloc(sizeof(struct text_cache_entry));
+  memset(entry, 0, sizeof(struct text_cache_entry));
+  entry->hash = text_cache_hash(font, string, max_chars);
+  entry->font = font_handle_retain(font);
+  entry->string = string_copy(string);
+  entry->max_chars = max_chars;
+  entry->metrics = *metrics;
+  CFRetain(entry->metrics.line);
+
+  uint32_t bucket = entry->hash % TEXT_CACHE_BUCKETS;
+  entry->chain = g_text_cache.buckets[bucket];
+  g_text_cache.buckets[bucket] = entry;
+  text_cache_push_front(entry);
+  g_text_cache.count++;
+}
+
+void text_cache_flush() {
+  while (g_text_cache.tail) text_cache_entry_destroy(g_text_cache.tail);
+}
+
+static void text_line_locks_init() {
+  for (uint32_t i = 0; i < TEXT_LINE_LOCKS; i++)
+    pthread_mutex_init(&g_text_line_locks[i], NULL);
+}
+
+// A cached line is shared by all items showing the same text, while Core Text
+// does not promise that a line can be drawn from several threads at once.
+// Draws of the same line are thus serialized on the render workers by a lock
+// striped over the line address, draws of different lines rarely contend.
+void text_cache_draw_line(CTLineRef line, CGContextRef context) {
+  pthread_once(&g_text_line_locks_once, text_line_locks_init);
+  pthread_mutex_t* lock = &g_text_line_locks[((uintptr_t)line >> 4)
+                                             % TEXT_LINE_LOCKS     ];
+  pthread_mutex_lock(lock);
+  CTLineDraw(line, context);
+  pthread_mutex_unlock(lock);
+}
+
+void text_cache_serialize(char* indent, FILE* rsp) {
+  uint64_t lookups = g_text_cache.hits + g_text_cache.misses;
+  fprintf(rsp, "%s\"entries\": %u,\n"
+               "%s\"capacity\": %u,\n"
+               "%s\"hits\": %llu,\n"
+               "%s\"misses\": %llu,\n"
+               "%s\"evictions\": %llu,\n"
+               "%s\"hit_rate\": %.4f",
+               indent, g_text_cache.count,
+               indent, TEXT_CACHE_CAPACITY,
+               indent, g_text_cache.hits,
+               indent, g_text_cache.misses,
+               indent, g_text_cache.evictions,
+               indent, lookups > 0
+                       ? (double)g_text_cache.hits / (double)lookups
+                       : 0.0                                        );
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <CoreText/CoreText.h>
+#include <pthread.h>
+#include "font.h"
+
+#define TEXT_CACHE_CAPACITY 512
+#define TEXT_CACHE_BUCKETS  1024
+#define TEXT_LINE_LOCKS     64
+
+struct text_metrics {
+  CTLineRef line;
+  CGFloat ascent;
+  CGFloat descent;
+  CGRect bounds;
+  float width;
+};
+
+// Shaped lines are shared between all items with the same font, string and
+// max_chars. The entries are kept in a hash table and a recency list, the
+// least recently used entry is evicted once the capacity is reached. Each
+// entry retains its interned font handle, which keeps the key unique.
+struct text_cache_entry {
+  uint64_t hash;
+  struct font_handle* font;
+  char* string;
+  uint32_t max_chars;
+
+  struct text_metrics metrics;
+
+  struct text_cache_entry* chain;
+  struct text_cache_entry* prev;
+  struct text_cache_entry* next;
+};
+
+struct text_cache {
+  struct text_cache_entry* buckets[TEXT_CACHE_BUCKETS];
+  struct text_cache_entry* head;
+  struct text_cache_entry* tail;
+  uint32_t count;
+
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+};
+
+bool text_cache_lookup(struct font_handle* font, char* string, uint32_t max_chars, struct text_metrics* metrics);
+void text_cache_insert(struct font_handle* font, char* string, uint32_t max_chars, struct text_metrics* metrics);
+void text_cache_flush();
+void text_cache_draw_line(CTLineRef line, CGContextRef context);
+
+void text_cache_serialize(char* indent, FILE* rsp);
@@ -0,0 +1,159 @@
+#include "trace.h"
+#include "misc/helpers.h"
+#include <pthread.h>
+
+extern char g_name[256];
+
+// Read by the render workers, hence only accessed atomically
+bool g_trace_enabled = false;
+
+static pthread_mutex_t g_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_buffer* g_trace_buffers = NULL;
+static char* g_trace_path = NULL;
+static uint64_t g_trace_origin = 0;
+static __thread struct trace_buffer* t_trace_buffer = NULL;
+
+static inline uint64_t trace_now() {
+  return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+static struct trace_buffer* trace_buffer_create() {
+  struct trace_buffer* buffer = malloc(sizeof(struct trace_buffer));
+  memset(buffer, 0, sizeof(struct trace_buffer));
+  pthread_threadid_np(NULL, &buffer->tid);
+  pthread_getname_np(pthread_self(), buffer->thread_name,
+                                     sizeof(buffer->thread_name));
+
+  if (!*buffer->thread_name) {
+    snprintf(buffer->thread_name, sizeof(buffer->thread_name),
+                                  pthread_main_np() ? "main" : "thread %llu",
+                                  buffer->tid                                );
+  }
+
+  pthread_mutex_lock(&g_trace_mutex);
+  buffer->next = g_trace_buffers;
+  g_trace_buffers = buffer;
+  pthread_mutex_unlock(&g_trace_mutex);
+  return buffer;
+}
+
+static inline bool trace_enabled() {
+  return __atomic_load_n(&g_trace_enabled, __ATOMIC_ACQUIRE);
+}
+
+uint64_t trace_begin() {
+  if (!trace_enabled()) return 0;
+  return trace_now();
+}
+
+void trace_end(const char* name, uint64_t start, int64_t arg) {
+  if (!start || !trace_enabled()) return;
+  if (!t_trace_buffer) t_trace_buffer = trace_buffer_create();
+
+  struct trace_event* event = &t_trace_buffer->events[t_trace_buffer->count
+                                                      % TRACE_BUFFER_EVENTS];
+  event->name = name;
+  event->start = start;
+  event->duration = trace_now() - start;
+  event->arg = arg;
+  t_trace_buffer->count++;
+}
+
+void trace_start(char* path) {
+  pthread_mutex_lock(&g_trace_mutex);
+  for (struct trace_buffer* buffer = g_trace_buffers; buffer;
+                                                      buffer = buffer->next) {
+    buffer->count = 0;
+  }
+  pthread_mutex_unlock(&g_trace_mutex);
+
+  if (path) {
+    if (g_trace_path) free(g_trace_path);
+    g_trace_path = path;
+  }
+  g_trace_origin = trace_now();
+  __atomic_store_n(&g_trace_enabled, true, __ATOMIC_RELEASE);
+}
+
+// Thread and process names are chosen by whoever created them and may hold
+// any character, they are written as escaped JSON strings.
+static void trace_write_string(FILE* file, const char* string) {
+  fputc('"', file);
+  for (const unsigned char* c = (const unsigned char*)string; *c; c++) {
+    if (*c == '"' || *c == '\\') fprintf(file, "\\%c", *c);
+    else if (*c < 0x20) fprintf(file, "\\u%04x", *c);
+    else fputc(*c, file);
+  }
+  fputc('"', file);
+}
+
+static void trace_write_buffer(struct trace_buffer* buffer, FILE* file, int pid) {
+  fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"tid\":%llu,\"args\":{\"name\":",
+                pid,
+                buffer->tid                                    );
+  trace_write_string(file, buffer->thread_name);
+  fprintf(file, "}}");
+
+  uint64_t first = buffer->count > TRACE_BUFFER_EVENTS
+                   ? buffer->count - TRACE_BUFFER_EVENTS
+                   : 0;
+
+  for (uint64_t i = first; i < buffer->count; i++) {
+    struct trace_event* event = &buffer->events[i % TRACE_BUFFER_EVENTS];
+    if (event->start < g_trace_origin) continue;
+
+    fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%llu,"
+                  "\"ts\":%.3f,\"dur\":%.3f",
+                  event->name,
+                  pid,
+                  buffer->tid,
+                  (event->start - g_trace_origin) / 1000.0,
+                  event->duration / 1000.0                  );
+
+    if (event->arg != TRACE_NO_ARG)
+      fprintf(file, ",\"args\":{\"value\":%lld}", event->arg);
+    fprintf(file, "}");
+  }
+}
+
+// Writes the recorded spans as Chrome trace event JSON, which can be opened
+// in Perfetto or chrome://tracing.
+bool trace_stop(char* path, FILE* rsp) {
+  __atomic_store_n(&g_trace_enabled, false, __ATOMIC_RELEASE);
+
+  if (path) {
+    if (g_trace_path) free(g_trace_path);
+    g_trace_path = path;
+  }
+
+  if (!g_trace_path) {
+    respond(rsp, "[!] Trace: No output file given\n");
+    return false;
+  }
+
+  FILE* file = fopen(g_trace_path, "w");
+  if (!file) {
+    respond(rsp, "[!] Trace: Could not open '%s'\n", g_trace_path);
+    return false;
+  }
+
+  int pid = getpid();
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"args\":{\"name\":",
+                pid                                        );
+  trace_write_string(file, g_name);
+  fprintf(file, "}}");
+
+  pthread_mutex_lock(&g_trace_mutex);
+  for (struct trace_buffer* buffer = g_trace_buffers; buffer;
+                                                      buffer = buffer->next) {
+    trace_write_buffer(buffer, file, pid);
+  }
+  pthread_mutex_unlock(&g_trace_mutex);
+
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  return true;
+}
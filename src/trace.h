@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define TRACE_BUFFER_EVENTS 16384
+#define TRACE_NO_ARG        INT64_MIN
+
+#define TRACE_BEGIN(name) uint64_t trace_start_##name = trace_begin()
+#define TRACE_END(name) trace_end(#name, trace_start_##name, TRACE_NO_ARG)
+#define TRACE_END_ARG(name, arg) trace_end(#name, trace_start_##name, arg)
+
+struct trace_event {
+  const char* name;
+  uint64_t start;
+  uint64_t duration;
+  int64_t arg;
+};
+
+// Each thread records into its own ring, only the most recent events are
+// kept once it wraps. The rings are read when the trace is stopped.
+struct trace_buffer {
+  uint64_t tid;
+  char thread_name[64];
+  uint64_t count;
+  struct trace_event events[TRACE_BUFFER_EVENTS];
+  struct trace_buffer* next;
+};
+
+extern bool g_trace_enabled;
+
+uint64_t trace_begin();
+void trace_end(const char* name, uint64_t start, int64_t arg);
+
+void trace_start(char* path);
+bool trace_stop(char* path, FILE* rsp);
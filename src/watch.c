@@ -0,0 +1,239 @@
+#include "watch.h"
+#include "change_log.h"
+
+void watch_registry_init(struct watch_registry* registry) {
+  registry->subscribers = NULL;
+  registry->subscriber_count = 0;
+}
+
+static bool watch_selectors_match(const char* name, void* context) {
+  struct watch_subscriber* subscriber = context;
+  for (uint32_t i = 0; i < subscriber->selector_count; i++) {
+    struct watch_selector* selector = &subscriber->selectors[i];
+    if (selector->is_regex) {
+      if (regexec(&selector->regex, name, 0, NULL, 0) == 0) return true;
+    } else if (string_equals(selector->name, name)) return true;
+  }
+  return false;
+}
+
+static void watch_subscriber_destroy(struct watch_subscriber* subscriber) {
+  for (uint32_t i = 0; i < subscriber->selector_count; i++) {
+    if (subscriber->selectors[i].is_regex)
+      regfree(&subscriber->selectors[i].regex);
+    free(subscriber->selectors[i].name);
+  }
+  if (subscriber->selectors) free(subscriber->selectors);
+  if (subscriber->buffer.buffer) free(subscriber->buffer.buffer);
+  if (subscriber->port)
+    mach_port_deallocate(mach_task_self(), subscriber->port);
+
+  query_projection_destroy(&subscriber->projection);
+  free(subscriber->name);
+  free(subscriber);
+}
+
+static bool watch_subscriber_add_selector(struct watch_subscriber* subscriber, struct token token, FILE* rsp) {
+  struct watch_selector selector = { 0 };
+  if (token.length > 1 && token.text[0] == REGEX_DELIMITER
+      && token.text[token.length - 1] == REGEX_DELIMITER  ) {
+    char* pattern = malloc(token.length - 1);
+    memcpy(pattern, &token.text[1], token.length - 2);
+    pattern[token.length - 2] = '\0';
+    bool compiled = regcomp(&selector.regex, pattern, 0) == 0;
+    free(pattern);
+
+    if (!compiled) {
+      respond(rsp, "[!] Watch: Could not compile regex '%s'\n", token.text);
+      return false;
+    }
+    selector.is_regex = true;
+  }
+
+  selector.name = token_to_string(token);
+  subscriber->selectors = realloc(subscriber->selectors,
+                                  sizeof(struct watch_selector)
+                                  * (subscriber->selector_count + 1));
+  subscriber->selectors[subscriber->selector_count++] = selector;
+  return true;
+}
+
+static void watch_registry_remove(struct watch_registry* registry, char* name) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < registry->subscriber_count; i++) {
+    struct watch_subscriber* subscriber = registry->subscribers[i];
+    if (string_equals(subscriber->name, name)) {
+      watch_subscriber_destroy(subscriber);
+      continue;
+    }
+    registry->subscribers[count++] = subscriber;
+  }
+  registry->subscriber_count = count;
+}
+
+// --watch <bootstrap name> <name|/regex/>... [fields=<path>,...] registers a
+// subscriber, a watch without selectors removes it again.
+void watch_registry_parse_message(struct watch_registry* registry, char* message, FILE* rsp) {
+  struct token name = get_token(&message);
+  if (!name.text || name.length == 0) {
+    respond(rsp, "[!] Watch: Expected a bootstrap name\n");
+    return;
+  }
+
+  char* bs_name = token_to_string(name);
+  watch_registry_remove(registry, bs_name);
+
+  struct watch_subscriber* subscriber = malloc(sizeof(struct watch_subscriber));
+  memset(subscriber, 0, sizeof(struct watch_subscriber));
+  subscriber->name = bs_name;
+  subscriber->needs_resync = true;
+  subscriber->buffer.compact = true;
+
+  struct token token = get_token(&message);
+  while (token.text && token.length > 0) {
+    if (strncmp(token.text, QUERY_FIELDS_PREFIX,
+                            strlen(QUERY_FIELDS_PREFIX)) == 0) {
+      query_projection_destroy(&subscriber->projection);
+      subscriber->projected = query_projection_parse(&subscriber->projection,
+                                                     token.text
+                                                     + strlen(QUERY_FIELDS_PREFIX),
+                                                     rsp                           );
+      if (!subscriber->projected) {
+        watch_subscriber_destroy(subscriber);
+        return;
+      }
+    } else if (!watch_subscriber_add_selector(subscriber, token, rsp)) {
+      watch_subscriber_destroy(subscriber);
+      return;
+    }
+    token = get_token(&message);
+  }
+
+  if (subscriber->selector_count == 0) {
+    watch_subscriber_destroy(subscriber);
+    return;
+  }
+
+  subscriber->port = mach_get_bs_port(bs_name);
+  if (!subscriber->port) {
+    respond(rsp, "[!] Watch: Could not find bootstrap port '%s'\n", bs_name);
+    watch_subscriber_destroy(subscriber);
+    return;
+  }
+
+  registry->subscribers = realloc(registry->subscribers,
+                                  sizeof(struct watch_subscriber*)
+                                  * (registry->subscriber_count + 1));
+  registry->subscribers[registry->subscriber_count++] = subscriber;
+}
+
+// Writes one newline terminated record with the changes the subscriber has
+// not seen yet, nothing is written when none of them concern its items.
+static void watch_subscriber_write(struct watch_subscriber* subscriber, struct change_log* change_log) {
+  struct json_writer* buffer = &subscriber->buffer;
+  struct change_filter filter = { watch_selectors_match,
+                                  subscriber,
+                                  subscriber->projected
+                                  ? &subscriber->projection
+                                  : NULL                    };
+
+  size_t size = buffer->size;
+  uint32_t written = change_log_write(change_log,
+                                      subscriber->seq,
+                                      subscriber->needs_resync,
+                                      &filter,
+                                      buffer                   );
+
+  if (written == 0 && !subscriber->needs_resync) buffer->size = size;
+  else json_printf(buffer, "\n");
+}
+
+// The buffer never grows beyond its capacity. When a record does not fit,
+// the pending records are dropped in favor of a full resync, and if not even
+// that fits, of a marker which asks the client to query the items itself.
+static void watch_subscriber_append(struct watch_subscriber* subscriber, struct change_log* change_log) {
+  if (!subscriber->needs_resync && subscriber->seq == change_log->head) return;
+
+  struct json_writer* buffer = &subscriber->buffer;
+  bool retry = buffer->size > 0 || !subscriber->needs_resync;
+  watch_subscriber_write(subscriber, change_log);
+
+  if (buffer->size > WATCH_BUFFER_CAPACITY) {
+    subscriber->dropped++;
+    if (retry) {
+      json_writer_reset(buffer);
+      subscriber->needs_resync = true;
+      watch_subscriber_write(subscriber, change_log);
+    }
+  }
+
+  if (buffer->size > WATCH_BUFFER_CAPACITY) {
+    json_writer_reset(buffer);
+    json_begin_object(buffer);
+    json_key(buffer, "head", 4);
+    json_printf(buffer, "%llu", change_log->head);
+    json_key(buffer, "resync", 6);
+    json_string(buffer, format_bool(true));
+    json_end_object(buffer);
+    json_printf(buffer, "\n");
+  }
+
+  subscriber->seq = change_log->head;
+  subscriber->needs_resync = false;
+}
+
+// Called after every handled event, the records of all changes since the last
+// flush are pushed to the subscribers without ever blocking on a slow
+// receiver. Records which were not accepted are retried on the next flush.
+void watch_registry_flush(struct watch_registry* registry, struct change_log* change_log) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < registry->subscriber_count; i++) {
+    struct watch_subscriber* subscriber = registry->subscribers[i];
+    watch_subscriber_append(subscriber, change_log);
+
+    struct json_writer* buffer = &subscriber->buffer;
+    if (buffer->size > 0) {
+      // The writer always keeps room for the terminator
+      buffer->buffer[buffer->size] = '\0';
+      mach_msg_return_t result = mach_try_send_message(subscriber->port,
+                                                       buffer->buffer,
+                                                       buffer->size + 1);
+      if (result == MACH_MSG_SUCCESS) {
+        subscriber->sent++;
+        json_writer_reset(buffer);
+      } else if (result != MACH_SEND_TIMED_OUT) {
+        watch_subscriber_destroy(subscriber);
+        continue;
+      }
+    }
+    registry->subscribers[count++] = subscriber;
+  }
+  registry->subscriber_count = count;
+}
+
+void watch_registry_serialize(struct watch_registry* registry, FILE* rsp) {
+  fprintf(rsp, "{\n");
+  for (uint32_t i = 0; i < registry->subscriber_count; i++) {
+    struct watch_subscriber* subscriber = registry->subscribers[i];
+    fprintf(rsp, "\t\"%s\": {\n"
+                 "\t\t\"seq\": %llu,\n"
+                 "\t\t\"sent\": %llu,\n"
+                 "\t\t\"dropped\": %llu,\n"
+                 "\t\t\"pending_bytes\": %zu\n",
+                 subscriber->name,
+                 subscriber->seq,
+                 subscriber->sent,
+                 subscriber->dropped,
+                 subscriber->buffer.size );
+    fprintf(rsp, i < registry->subscriber_count - 1 ? "\t},\n" : "\t}\n");
+  }
+  fprintf(rsp, "}\n");
+}
+
+void watch_registry_destroy(struct watch_registry* registry) {
+  for (uint32_t i = 0; i < registry->subscriber_count; i++) {
+    watch_subscriber_destroy(registry->subscribers[i]);
+  }
+  if (registry->subscribers) free(registry->subscribers);
+  watch_registry_init(registry);
+}
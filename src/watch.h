@@ -0,0 +1,46 @@
+#pragma once
+#include <regex.h>
+#include "misc/helpers.h"
+#include "mach.h"
+#include "query.h"
+
+#define WATCH_BUFFER_CAPACITY (64 * 1024)
+
+struct change_log;
+
+struct watch_selector {
+  char* name;
+  bool is_regex;
+  regex_t regex;
+};
+
+// A client registered under a bootstrap name. Records which it does not
+// receive in time pile up in its buffer. A record which would exceed the
+// capacity of the buffer replaces the pending records by a full resync of the
+// watched items, or by a resync marker if the resync does not fit either.
+struct watch_subscriber {
+  char* name;
+  mach_port_t port;
+
+  struct watch_selector* selectors;
+  uint32_t selector_count;
+  struct query_projection projection;
+  bool projected;
+
+  uint64_t seq;
+  bool needs_resync;
+  uint64_t sent;
+  uint64_t dropped;
+  struct json_writer buffer;
+};
+
+struct watch_registry {
+  struct watch_subscriber** subscribers;
+  uint32_t subscriber_count;
+};
+
+void watch_registry_init(struct watch_registry* registry);
+void watch_registry_parse_message(struct watch_registry* registry, char* message, FILE* rsp);
+void watch_registry_flush(struct watch_registry* registry, struct change_log* change_log);
+void watch_registry_serialize(struct watch_registry* registry, FILE* rsp);
+void watch_registry_destroy(struct watch_registry* registry);
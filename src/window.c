@@ -1,10 +1,19 @@
 #include "window.h"
 #include "bar_manager.h"
+#include "trace.h"
+#include "startup.h"
 
 extern struct bar_manager g_bar_manager;
 extern int64_t g_disable_capture;
 int g_space = 0;
 
+// Raised whenever a window is created or closed, such that cached lookups
+// into the window layout can detect staleness. A window that only moves or
+// resizes raises g_window_moves instead, the lookups then refresh the frames
+// of the windows they already hold.
+uint64_t g_window_generation = 0;
+uint64_t g_window_moves = 0;
+
 void window_init(struct window* window) {
   window->context = NULL;
   window->parent = NULL;
@@ -24,9 +33,11 @@ static CFTypeRef window_create_region(struct window* window, CGRect frame) {
 }
 
 void window_create(struct window* window, CGRect frame) {
+  startup_count(STARTUP_WINDOWS);
   uint64_t set_tags = kCGSExposeFadeTagBit | kCGSPreventsActivationTagBit;
   uint64_t clear_tags = 0;
 
+  g_window_generation++;
   window->origin = frame.origin;
   window->frame.origin = CGPointZero;
   window->frame.size = frame.size;
@@ -91,6 +102,7 @@ void window_create(struct window* window, CGRect frame) {
 }
 
 void window_clear(struct window* window) {
+  g_window_generation++;
   window->context = NULL;
   window->parent = NULL;
   window->id = 0;
@@ -104,19 +116,29 @@ void window_flush(struct window* window) {
   SLSFlushWindowContentRegion(g_connection, window->id, NULL);
 }
 
+// Start of the current transaction when tracing, such that the time the
+// window server updates stay disabled shows up as its own span.
+static uint64_t g_transaction_start = 0;
+
 void windows_freeze() {
   if (g_transaction) return;
 
+  TRACE_BEGIN(windows_freeze);
+  g_transaction_start = trace_begin();
   SLSDisableUpdate(g_connection);
   g_transaction = SLSTransactionCreate(g_connection);
+  TRACE_END(windows_freeze);
 }
 
 void windows_unfreeze() {
   if (g_transaction) {
+    TRACE_BEGIN(windows_unfreeze);
     SLSTransactionCommit(g_transaction, 0);
     CFRelease(g_transaction);
     g_transaction = NULL;
     SLSReenableUpdate(g_connection);
+    TRACE_END(windows_unfreeze);
+    trace_end("transaction", g_transaction_start, TRACE_NO_ARG);
   }
 }
 
@@ -125,17 +147,20 @@ void window_set_frame(struct window* window, CGRect frame) {
       || !CGPointEqualToPoint(window->origin, frame.origin)) {
     window->needs_move = true;
     window->origin = frame.origin;
+    g_window_moves++;
   }
 
   if (window->needs_resize
       || !CGSizeEqualToSize(window->frame.size, frame.size)) {
     window->needs_resize = true;
+    g_window_moves++;
     window->frame.size = frame.size;
   }
 }
 
 void window_move(struct window* window, CGPoint point) {
   window->origin = point;
+  g_window_moves++;
 
   if (__builtin_available(macOS 12.0, *)) {
     // Monterey and later
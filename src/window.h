@@ -9,6 +9,8 @@
 #define W_BELOW  -1
 
 extern CFTypeRef g_transaction;
+extern uint64_t g_window_generation;
+extern uint64_t g_window_moves;
 
 struct window {
   struct window* parent;
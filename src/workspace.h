@@ -8,5 +8,6 @@ void workspace_event_handler_end(void *context);
 int workspace_display_notch_height(uint32_t did);
 float workspace_get_scale();
 
-CGImageRef workspace_icon_for_app(char* app);
+char* workspace_copy_app_path(char* app);
+CGImageRef workspace_icon_for_path(char* path);
 char* workspace_copy_app_name_for_pid(pid_t pid);
@@ -84,7 +84,9 @@ char* workspace_copy_app_name_for_pid(pid_t pid) {
   }
 }
 
-CGImageRef workspace_icon_for_app(char* app) {
+// Resolves a bundle identifier, or the name of a running application, to the
+// path of its bundle.
+char* workspace_copy_app_path(char* app) {
   @autoreleasepool {
     NSString* ns_app = [NSString stringWithUTF8String:app];
     NSURL* path = [[NSWorkspace sharedWorkspace] URLForApplicationWithBundleIdentifier:ns_app];
@@ -101,10 +103,18 @@ CGImageRef workspace_icon_for_app(char* app) {
           break;
         }
       }
-      if (!recovered) return NULL;
+      if (!recovered || !path) return NULL;
     }
 
-    NSImage* image = [[NSWorkspace sharedWorkspace] iconForFile:path.path];
+    const char* result = [path.path UTF8String];
+    return result ? string_copy((char*)result) : NULL;
+  }
+}
+
+CGImageRef workspace_icon_for_path(char* path) {
+  @autoreleasepool {
+    NSString* ns_path = [NSString stringWithUTF8String:path];
+    NSImage* image = [[NSWorkspace sharedWorkspace] iconForFile:ns_path];
     if (!image) return NULL;
 
     float scale = workspace_get_scale();